@@ -3,7 +3,9 @@
 
 #include <hal/gpio_types.h>
 #include <driver/i2s_types.h>
+#include <esp_pm.h>
 #include <soc/soc_caps.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -21,11 +23,18 @@ typedef struct {
 typedef struct {
     i2s_chan_handle_t rxHandle;
 
+    // I2S DMA doesn't run in light sleep, so it's blocked while capture is enabled.
+    // Driver holds its own APB frequency lock while the channel is enabled
+    esp_pm_lock_handle_t noSleepLock;
+    atomic_bool isEnabled; // Read by the A2DP data callback while the event dispatcher starts and stops capture
+
     InputAudioStreamConfig config;
 } InputAudioStream;
 
 void initInputAudioStream(InputAudioStream *stream, InputAudioStreamConfig *config);
 // TODO dtor
-void readAudioData(InputAudioStream *stream, uint8_t *buffer, size_t bufferSize, size_t *readBytes);
+void startInputAudioStream(InputAudioStream *stream);
+void stopInputAudioStream(InputAudioStream *stream);
+bool readAudioData(InputAudioStream *stream, uint8_t *buffer, size_t bufferSize, size_t *readBytes);
 
 #endif
@@ -4,6 +4,7 @@
 #include <driver/i2s_common.h>
 #include <driver/i2s_std.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "audio_stream.h"
 #include "hal/i2s_types.h"
@@ -45,15 +46,62 @@ void initInputAudioStream(InputAudioStream *stream, InputAudioStreamConfig *conf
 
     rxStdConfig.clk_cfg.mclk_multiple = I2S_MCLK_MULTIPLE_256;
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(stream->rxHandle, &rxStdConfig));
-    
-    ESP_ERROR_CHECK(i2s_channel_enable(stream->rxHandle));
+
+    // Channel is enabled only while audio is streaming, so the chip can scale down the rest of the time
+    atomic_store(&stream->isEnabled, false);
+
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "audio_stream", &stream->noSleepLock) != ESP_OK) {
+        stream->noSleepLock = NULL;
+    }
 
     stream->config = *config;
 }
 
-void readAudioData(InputAudioStream *stream, uint8_t *buffer, size_t bufferSize, size_t *readBytes) {
+void startInputAudioStream(InputAudioStream *stream) {
+    assert(stream);
+
+    if (atomic_load(&stream->isEnabled)) {
+        return;
+    }
+
+    if (stream->noSleepLock) {
+        esp_pm_lock_acquire(stream->noSleepLock);
+    }
+
+    ESP_ERROR_CHECK(i2s_channel_enable(stream->rxHandle));
+    atomic_store(&stream->isEnabled, true);
+}
+
+void stopInputAudioStream(InputAudioStream *stream) {
+    assert(stream);
+
+    // Reader stops before the channel is disabled
+    if (!atomic_exchange(&stream->isEnabled, false)) {
+        return;
+    }
+
+    ESP_ERROR_CHECK(i2s_channel_disable(stream->rxHandle));
+
+    if (stream->noSleepLock) {
+        esp_pm_lock_release(stream->noSleepLock);
+    }
+}
+
+// Buffer is filled with silence if the stream is stopped or the read has failed. Returns false in such case
+bool readAudioData(InputAudioStream *stream, uint8_t *buffer, size_t bufferSize, size_t *readBytes) {
     assert(stream);
     assert(buffer);
-    
-    ESP_ERROR_CHECK(i2s_channel_read(stream->rxHandle, buffer, bufferSize, readBytes, stream->config.readTimeout));
+
+    if (!atomic_load(&stream->isEnabled) ||
+        i2s_channel_read(stream->rxHandle, buffer, bufferSize, readBytes, stream->config.readTimeout) != ESP_OK) {
+
+        memset(buffer, 0, bufferSize);
+
+        if (readBytes) {
+            *readBytes = 0;
+        }
+        return false;
+    }
+
+    return true;
 }
@@ -0,0 +1,50 @@
+#ifndef BT_LIB_AFH_MAP_H_
+#define BT_LIB_AFH_MAP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// AFH map controller doesn't depend on ESP-IDF, so it can be built on host like the link quality controller
+
+#define kAfhChannelsCount (79)
+#define kAfhChannelMapLen (10)
+#define kAfhMinUsedChannels (20) // Core specification doesn't allow hopping over fewer channels
+#define kAfhBlocksCount (3)      // Non-overlapping Wi-Fi channels 1, 6 and 11
+
+// Bit N is BT channel N (2402 + N MHz), LSB of the first byte is channel 0
+typedef uint8_t AfhChannelMap[kAfhChannelMapLen];
+
+typedef struct {
+    uint16_t burstStarvations;     // Sample is bad if data callback starved at least this many times
+    uint8_t badSamplesToExclude;   // Next Wi-Fi block is excluded after this many bad samples in a row
+    uint8_t goodSamplesToKeep;     // Excluded block is kept if this many good samples in a row follow the exclusion
+    uint16_t reprobePeriodSamples; // One of the excluded blocks is returned to the map after this many samples
+} AfhAutoConfig;
+
+typedef struct {
+    AfhAutoConfig config;
+    AfhChannelMap excludedChannels; // Set by user, never changed by the auto mode
+
+    bool isAutoMode;
+    uint8_t autoExcludedBlocks; // Bit mask of Wi-Fi blocks excluded by the auto mode
+    int8_t trialBlock;          // Block excluded on the last burst and not confirmed yet, -1 if none
+    uint8_t nextBlock;          // Block to try (or to reprobe) next
+    uint8_t badSamples;
+    uint8_t goodSamples;
+    uint16_t samplesSinceChange;
+} AfhController;
+
+#define AFH_AUTO_DEFAULT_CONFIG() { \
+    .burstStarvations = 3,          \
+    .badSamplesToExclude = 2,       \
+    .goodSamplesToKeep = 10,        \
+    .reprobePeriodSamples = 120,    \
+}
+
+void initAfhController(AfhController *controller, const AfhAutoConfig *config);
+bool setExcludedAfhChannels(AfhController *controller, const AfhChannelMap excludedChannels);
+bool enableAutoAfh(AfhController *controller, bool isEnabled);
+bool updateAfh(AfhController *controller, uint16_t starvations);
+void getUsedAfhChannels(const AfhController *controller, AfhChannelMap usedChannels);
+
+#endif
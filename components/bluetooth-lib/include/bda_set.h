@@ -0,0 +1,30 @@
+#ifndef BT_LIB_BDA_SET_H_
+#define BT_LIB_BDA_SET_H_
+
+#include <esp_bt_defs.h>
+#include <stdint.h>
+
+#define kBdaSetCapacityBits (6)
+#define kBdaSetCapacity (1 << kBdaSetCapacityBits)
+#define kBdaSetMaxSize (kBdaSetCapacity / 2) // Keeps probe sequences short
+
+typedef struct {
+    esp_bd_addr_t address;
+    bool isUsed;
+
+    bool isReported;   // Device has been sent to the event dispatcher
+    bool isNameQueued; // Device waits for the remote name request
+    int8_t rssi;       // Last received RSSI
+    int8_t reportedRssi;
+} BdaSetEntry;
+
+// Open addressing hash set with linear probing. Entries are never removed, the whole set is cleared instead
+typedef struct {
+    BdaSetEntry entries[kBdaSetCapacity];
+    uint8_t size;
+} BdaSet;
+
+void clearBdaSet(BdaSet *set);
+BdaSetEntry *findOrInsertBda(BdaSet *set, const esp_bd_addr_t address, bool *isInserted);
+
+#endif
@@ -6,9 +6,14 @@
 #include <stdint.h>
 #include <esp_a2dp_api.h>
 #include <esp_avrc_api.h>
+#include <esp_bt.h>
 #include <freertos/idf_additions.h>
 
+#include "afh_map.h"
+#include "bda_set.h"
+#include "connection_profiler.h"
 #include "dispatcher.h"
+#include "link_quality.h"
 
 typedef enum : uint16_t {
     DEVICE_STATE_IDLE,
@@ -26,6 +31,14 @@ typedef enum {
     AUDIO_STATE_STOPPING,
 } AudioState;
 
+// Profiles set only the QoS poll interval. Sniff mode is governed by the Bluedroid power management in all of them,
+// it's reported in the snapshot
+typedef enum {
+    LINK_PROFILE_AUTO,        // Low latency while audio is active, power saving while it's idle
+    LINK_PROFILE_LOW_LATENCY, // Short poll interval
+    LINK_PROFILE_POWER,       // Default poll interval
+} LinkProfileMode;
+
 typedef struct __attribute__((packed)) {
     uint16_t channel1;
     uint16_t channel2;
@@ -36,8 +49,18 @@ typedef struct {
     uint8_t nameLen;
 
     esp_bd_addr_t address;
+
+    uint32_t deviceClass;
+    int8_t rssi;
+    uint16_t score; // Peer rank in the device selection menu. Bigger is better
 } PeerDeviceData;
 
+typedef struct {
+    uint8_t inquiryDuration;     // In 1.28 s units
+    uint8_t maxRenderingDevices; // Inquiry is stopped after this many rendering devices are found. 0 means no limit
+    bool stopOnKnownPeer;        // Inquiry is stopped as soon as a cached peer responds
+} DiscoveryConfig;
+
 typedef int32_t (*AudioDataCallback)(AudioFrame *, int32_t);
 typedef void (*DeviceStateChangeCallback)(DeviceState);
 typedef void (*AudioStateChangedCallback)(AudioState);
@@ -51,6 +74,9 @@ typedef enum {
     VOLUME_CHANGED,
 } BluetoothDeviceEventType;
 
+#define kRssiReportThreshold (6) // Repeated inquiry response is reported only if RSSI changed at least by this value
+#define kMaxPendingNameRequests (4)
+
 typedef struct {
     AudioDataCallback audioDataCallback;
     DeviceStateChangeCallback deviceStateChangedCallback;
@@ -59,15 +85,72 @@ typedef struct {
     VolumeChangedCallback volumeChangedCallback;
 } BluetoothDeviceCallbacks;
 
+// Consistent copy of the device state which can be read from any task without waiting for the event dispatcher.
+// Reads are lock-free, not wait-free: the copy is retried while a write is in progress
 typedef struct {
     DeviceState deviceState;
     AudioState audioState;
 
     PeerDeviceData selectedPeer;
 
+    uint8_t volume;
+    esp_a2d_mcc_t codecConfig;
+    uint16_t latency; // Delay reported by sink in 1/10 ms
+
+    int8_t rssiDelta;       // Last RSSI relative to the golden receive power range
+    uint8_t advisedBitpool; // Telemetry of the link quality controller. Encoder isn't reconfigured
+    esp_power_level_t txPowerLevel;
+
+    bool isLowLatencyLink; // Low-latency link profile is applied
+    bool isLinkInSniff;    // Reported by the stack, not controlled by the link profile
+} BluetoothDeviceSnapshot;
+
+typedef struct {
+    // States are changed with compare-and-set, because they are updated from the GAP callback, btDispatcher and user calls
+    _Atomic DeviceState deviceState;
+    _Atomic AudioState audioState;
+
+    PeerDeviceData selectedPeer;
+    bool isAutoReconnecting; // Connection to the stored last peer is in progress
+
+    DiscoveryConfig discoveryConfig;
+    bool isStoppingDiscovery;
+
+    // Devices which responded during current inquiry. Repeated responses are filtered out here
+    BdaSet discoveredDevices;
+    uint8_t reportedDevicesCount; // Shown with a name. Only these count towards maxRenderingDevices
+
+    // Rendering devices without name in the inquiry response. Names are requested one by one after the inquiry
+    PeerDeviceData pendingNameRequests[kMaxPendingNameRequests];
+    uint8_t pendingNameRequestsCount;
+    bool isNameRequestActive;
+
     Dispatcher btDispatcher;
     TimerHandle_t heartBeatTimer;
 
+    // Outgoing absolute volume commands. At most one is in flight, newer value replaces the pending one
+    TimerHandle_t volumeTimer;
+    uint8_t pendingVolume;
+    bool hasPendingVolume;
+    bool isVolumeInFlight;
+    TickType_t lastVolumeSentTick;
+    uint8_t lastSentAvrcVolume;           // kAvrcNoVolume until the first command is sent
+    _Atomic uint8_t queuedVolumeRequests; // setVolume calls which haven't reached the scheduler yet
+
+    // Link quality is sampled periodically while audio is streaming
+    TimerHandle_t linkQualityTimer;
+    LinkQualityController linkQuality;
+
+    // TX power is adjusted to the link margin while connected and restored to the default range otherwise
+    TxPowerController txPower;
+    esp_power_level_t defaultMinTxPower;
+    esp_power_level_t defaultMaxTxPower;
+
+    AfhController afh;
+
+    LinkProfileMode linkProfileMode;
+    bool isLowLatencyLink;
+
     esp_avrc_rn_evt_cap_mask_t avrcNotificationEventCapabilities;
 
     Dispatcher eventDispatcher;
@@ -77,14 +160,34 @@ typedef struct {
 } BluetoothDevice;
 
 #define kHeartBeatTimerPeriodMs (10000) // Heart beat timer period
+#define kVolumePacingMs (100) // Min interval between absolute volume commands
+#define kVolumeResponseTimeoutMs (1000) // Absolute volume command is considered lost after this time
+#define kLinkQualitySamplePeriodMs (1000) // Link quality sampling period while streaming
+#define kDataStarvationGapUs (60000) // Data callback is considered starved if it wasn't called for this time
+#define kLowLatencyPollSlots (12) // QoS poll interval of the low-latency link profile in 625 us slots
+#define kMetadataSlabSlots (2) // AVRC metadata texts waiting for the handler
+#define kMetadataTextMaxLen (64) // Longer metadata texts are truncated
 #define kDeviceName "bluetooth-transmitter" // Bluetooth device public name
+#define kAutoReconnectDiscoveryDuration (5) // Inquiry duration used when the last peer is unreachable
 
 void initBtDevice(BluetoothDeviceCallbacks *callbacks);
+void startBtDevice();
+void shutdownBtDevice();
 bool startAudio();
 bool stopAudio();
 bool connectToDevice(PeerDeviceData *peer);
+bool connectToLastPeer();
 bool disconnectFromDevice();
-bool startDiscovery(uint8_t inquiryDuration);
+bool startDiscovery(const DiscoveryConfig *config);
 
 bool setVolume(uint8_t volumeLevel);
+bool configureTxPowerControl(const TxPowerConfig *config);
+bool setAfhChannelExclusion(const AfhChannelMap excludedChannels);
+bool setAfhAutoMode(bool isEnabled);
+bool setLinkProfileMode(LinkProfileMode mode);
+
+uint8_t getConnectionTimings(ConnectionAttempt *attempts, uint8_t maxAttempts);
+
+// Never blocks, but spins while a writer on the other core is inside its short critical section
+void getBtDeviceSnapshot(BluetoothDeviceSnapshot *snapshotCopy);
 #endif
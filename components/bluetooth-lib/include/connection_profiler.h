@@ -0,0 +1,42 @@
+#ifndef BT_LIB_CONNECTION_PROFILER_H_
+#define BT_LIB_CONNECTION_PROFILER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Profiler doesn't depend on ESP-IDF: timestamps are passed by the caller
+
+typedef enum {
+    CONNECTION_MILESTONE_DISCOVERY_STARTED,
+    CONNECTION_MILESTONE_FIRST_DEVICE_FOUND,
+    CONNECTION_MILESTONE_CONNECT_ISSUED,
+    CONNECTION_MILESTONE_AVRC_CONNECTED,
+    CONNECTION_MILESTONE_A2DP_CONNECTED,
+    CONNECTION_MILESTONE_SOURCE_READY, // CHECK_SRC_RDY acknowledged
+    CONNECTION_MILESTONE_STREAM_STARTED, // START acknowledged
+    CONNECTION_MILESTONE_FIRST_DATA,
+    CONNECTION_MILESTONES_COUNT,
+} ConnectionMilestone;
+
+typedef struct {
+    int64_t timestamps[CONNECTION_MILESTONES_COUNT]; // In microseconds, 0 if milestone hasn't been reached
+} ConnectionAttempt;
+
+#define kConnectionHistoryLen (4)
+
+// Ring of the last connection attempts. Attempt starts with a discovery or with a connection to a known peer
+typedef struct {
+    ConnectionAttempt attempts[kConnectionHistoryLen];
+    uint8_t head; // Index of the current attempt
+    uint8_t count;
+} ConnectionProfiler;
+
+void resetConnectionProfiler(ConnectionProfiler *profiler);
+void recordConnectionMilestone(ConnectionProfiler *profiler, ConnectionMilestone milestone, int64_t timeUs);
+uint8_t copyConnectionAttempts(const ConnectionProfiler *profiler, ConnectionAttempt *attempts, uint8_t maxAttempts);
+
+int64_t getConnectionPhaseUs(const ConnectionAttempt *attempt, ConnectionMilestone milestone);
+int64_t getConnectionTotalUs(const ConnectionAttempt *attempt);
+const char *getConnectionMilestoneName(ConnectionMilestone milestone);
+
+#endif
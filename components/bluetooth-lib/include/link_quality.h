@@ -0,0 +1,83 @@
+#ifndef BT_LIB_LINK_QUALITY_H_
+#define BT_LIB_LINK_QUALITY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Link quality controller doesn't depend on ESP-IDF, so it's built on host and fed with recorded traces (host_test).
+// Bitpool controller is telemetry: it tracks the SBC bitpool the link could sustain, which is reported in the device
+// snapshot and the log. Bluedroid SBC encoder can't be reconfigured at runtime, so nothing applies it.
+// TX power controller is applied
+
+typedef struct {
+    uint8_t minBitpool;
+    uint8_t maxBitpool;
+    uint8_t bitpoolStep;
+
+    int8_t degradeRssiDelta;     // Sample is bad if RSSI delta (relative to the golden range) is below this value
+    int8_t recoverRssiDelta;     // Sample is good if RSSI delta is above this value
+    uint16_t degradeStarvations; // Sample is bad if data callback starved at least this many times
+
+    uint8_t badSamplesToDegrade;  // Bitpool is lowered after this many bad samples in a row
+    uint8_t goodSamplesToRecover; // Bitpool is raised after this many good samples in a row
+} LinkQualityConfig;
+
+typedef struct {
+    LinkQualityConfig config;
+
+    uint8_t bitpool;
+    uint8_t badSamples;
+    uint8_t goodSamples;
+} LinkQualityController;
+
+#define LINK_QUALITY_DEFAULT_CONFIG() { \
+    .minBitpool = 18,                   \
+    .maxBitpool = 53,                   \
+    .bitpoolStep = 6,                   \
+    .degradeRssiDelta = -10,            \
+    .recoverRssiDelta = -4,             \
+    .degradeStarvations = 2,            \
+    .badSamplesToDegrade = 2,           \
+    .goodSamplesToRecover = 5,          \
+}
+
+// Power levels are indices of the controller power table (esp_power_level_t values)
+typedef struct {
+    uint8_t minLevel;
+    uint8_t maxLevel;
+    uint8_t levelStep;
+
+    int8_t lowerRssiDelta; // Sample has a large margin if RSSI delta is above this value
+    int8_t raiseRssiDelta; // Sample has a small margin if RSSI delta is below this value
+
+    uint8_t samplesToLower; // Power is lowered after this many large margin samples in a row
+    uint8_t samplesToRaise; // Power is raised after this many small margin samples in a row
+} TxPowerConfig;
+
+typedef struct {
+    TxPowerConfig config;
+
+    uint8_t level;
+    uint8_t largeMarginSamples;
+    uint8_t smallMarginSamples;
+} TxPowerController;
+
+#define TX_POWER_DEFAULT_CONFIG() { \
+    .minLevel = 0,                  \
+    .maxLevel = 7,                  \
+    .levelStep = 1,                 \
+    .lowerRssiDelta = 6,            \
+    .raiseRssiDelta = 0,            \
+    .samplesToLower = 3,            \
+    .samplesToRaise = 1,            \
+}
+
+void initLinkQualityController(LinkQualityController *controller, const LinkQualityConfig *config);
+void resetLinkQualityController(LinkQualityController *controller);
+bool updateLinkQuality(LinkQualityController *controller, int8_t rssiDelta, uint16_t starvations);
+
+void initTxPowerController(TxPowerController *controller, const TxPowerConfig *config);
+void resetTxPowerController(TxPowerController *controller);
+bool updateTxPower(TxPowerController *controller, int8_t rssiDelta);
+
+#endif
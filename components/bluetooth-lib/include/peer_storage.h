@@ -0,0 +1,49 @@
+#ifndef BT_LIB_PEER_STORAGE_H_
+#define BT_LIB_PEER_STORAGE_H_
+
+#include "bt_lib.h"
+
+#define kPeerStorageNamespace "bt_lib"
+#define kLastPeerKey "last_peer"
+#define kPeerCacheKey "peer_cache"
+
+#define kPeerCacheSize (8)
+
+// Score weights used to rank known peers in the device selection menu
+#define kPeerScoreCachedBonus (200)   // Any known peer is ranked above never seen ones
+#define kPeerScoreConnectWeight (40)
+#define kPeerScoreSeenWeight (4)
+#define kPeerScoreAgePenalty (8)      // Per discovery in which the peer hasn't been seen
+#define kPeerScoreMaxCounted (16)     // Connects, sightings and age are saturated at this value
+#define kPeerScoreMinRssi (-100)
+
+// Cache is written to NVS only when a peer is added, connected or renamed.
+// Sightings and generation are stored along with the next such change
+typedef struct {
+    PeerDeviceData peer;
+
+    uint32_t lastSeenGeneration;
+    uint16_t seenCount;
+    uint16_t connectCount;
+} PeerCacheEntry;
+
+typedef struct {
+    uint32_t generation; // Incremented on every discovery. Used as a clock for the last seen ranking
+    uint8_t entriesCount;
+
+    PeerCacheEntry entries[kPeerCacheSize];
+} PeerCache;
+
+// NVS should be initialized before using these functions
+bool loadLastPeer(PeerDeviceData *peer);
+bool saveLastPeer(const PeerDeviceData *peer);
+
+void initPeerCache();
+bool flushPeerCache();
+
+void peerCacheNewGeneration();
+bool peerCacheSeen(PeerDeviceData *peer);
+void peerCacheConnected(const PeerDeviceData *peer);
+bool peerCacheGetRanked(size_t rank, PeerDeviceData *peer);
+
+#endif
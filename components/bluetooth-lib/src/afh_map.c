@@ -0,0 +1,181 @@
+#include <assert.h>
+#include <string.h>
+
+#include "afh_map.h"
+
+typedef struct {
+    uint8_t firstChannel;
+    uint8_t lastChannel;
+} AfhBlock;
+
+// 22 MHz wide Wi-Fi channels 1 (2412 MHz), 6 (2437 MHz) and 11 (2462 MHz) in BT channels
+static const AfhBlock kAfhBlocks[kAfhBlocksCount] = {
+    { .firstChannel = 0, .lastChannel = 21 },
+    { .firstChannel = 24, .lastChannel = 46 },
+    { .firstChannel = 49, .lastChannel = 71 },
+};
+
+static void buildUsedChannels(const AfhChannelMap excludedChannels, uint8_t autoExcludedBlocks, AfhChannelMap usedChannels);
+static uint8_t countUsedChannels(const AfhChannelMap usedChannels);
+static bool isAllowedExclusion(const AfhController *controller, uint8_t autoExcludedBlocks);
+
+void initAfhController(AfhController *controller, const AfhAutoConfig *config) {
+    assert(controller);
+    assert(config);
+
+    memset(controller, 0, sizeof(*controller));
+    controller->config = *config;
+    controller->trialBlock = -1;
+}
+
+// Returns false if the map leaves too few channels for hopping
+bool setExcludedAfhChannels(AfhController *controller, const AfhChannelMap excludedChannels) {
+    assert(controller);
+    assert(excludedChannels);
+
+    AfhChannelMap usedChannels;
+    buildUsedChannels(excludedChannels, 0, usedChannels);
+
+    if (countUsedChannels(usedChannels) < kAfhMinUsedChannels) {
+        return false;
+    }
+
+    memcpy(controller->excludedChannels, excludedChannels, sizeof(AfhChannelMap));
+
+    // User map has priority, so the auto mode starts over on top of it
+    controller->autoExcludedBlocks = 0;
+    controller->trialBlock = -1;
+    return true;
+}
+
+// Returns true if the map has been changed
+bool enableAutoAfh(AfhController *controller, bool isEnabled) {
+    assert(controller);
+
+    bool isChanged = controller->autoExcludedBlocks != 0;
+
+    controller->isAutoMode = isEnabled;
+    controller->autoExcludedBlocks = 0;
+    controller->trialBlock = -1;
+    controller->badSamples = 0;
+    controller->goodSamples = 0;
+    controller->samplesSinceChange = 0;
+
+    return isChanged;
+}
+
+// Called once per sample while streaming. Returns true if the map has been changed
+bool updateAfh(AfhController *controller, uint16_t starvations) {
+    assert(controller);
+
+    if (!controller->isAutoMode) {
+        return false;
+    }
+
+    const AfhAutoConfig *config = &controller->config;
+
+    // Channel quality can't be measured per channel, so the whole Wi-Fi blocks are excluded one by one
+    // and kept only if starvation bursts stop after the exclusion
+    bool isBadSample = starvations >= config->burstStarvations;
+    controller->badSamples = isBadSample ? controller->badSamples + 1 : 0;
+    controller->goodSamples = isBadSample ? 0 : controller->goodSamples + 1;
+    controller->samplesSinceChange++;
+
+    if (controller->trialBlock >= 0) {
+        if (controller->badSamples >= config->badSamplesToExclude) {
+            // Exclusion didn't help, so the block goes back and the next one is tried on the next burst
+            controller->autoExcludedBlocks &= ~(1 << controller->trialBlock);
+            controller->trialBlock = -1;
+            controller->badSamples = 0;
+            controller->samplesSinceChange = 0;
+            return true;
+        }
+
+        if (controller->goodSamples >= config->goodSamplesToKeep) {
+            controller->trialBlock = -1;
+        }
+        return false;
+    }
+
+    if (controller->badSamples >= config->badSamplesToExclude) {
+        controller->badSamples = 0;
+
+        for (uint8_t i = 0; i < kAfhBlocksCount; i++) {
+            uint8_t block = (controller->nextBlock + i) % kAfhBlocksCount;
+            uint8_t autoExcludedBlocks = controller->autoExcludedBlocks | (1 << block);
+
+            if (autoExcludedBlocks == controller->autoExcludedBlocks || !isAllowedExclusion(controller, autoExcludedBlocks)) {
+                continue;
+            }
+
+            controller->autoExcludedBlocks = autoExcludedBlocks;
+            controller->trialBlock = block;
+            controller->nextBlock = (block + 1) % kAfhBlocksCount;
+            controller->samplesSinceChange = 0;
+            return true;
+        }
+        return false;
+    }
+
+    // Wi-Fi networks come and go, so excluded blocks are periodically reprobed
+    if (controller->autoExcludedBlocks != 0 && controller->samplesSinceChange >= config->reprobePeriodSamples) {
+        for (uint8_t i = 0; i < kAfhBlocksCount; i++) {
+            uint8_t block = (controller->nextBlock + i) % kAfhBlocksCount;
+
+            if (controller->autoExcludedBlocks & (1 << block)) {
+                controller->autoExcludedBlocks &= ~(1 << block);
+                controller->nextBlock = (block + 1) % kAfhBlocksCount;
+                break;
+            }
+        }
+
+        controller->samplesSinceChange = 0;
+        return true;
+    }
+
+    return false;
+}
+
+// Builds the map in the controller format: bit is set if the channel can be used
+void getUsedAfhChannels(const AfhController *controller, AfhChannelMap usedChannels) {
+    assert(controller);
+    assert(usedChannels);
+
+    buildUsedChannels(controller->excludedChannels, controller->autoExcludedBlocks, usedChannels);
+}
+
+static void buildUsedChannels(const AfhChannelMap excludedChannels, uint8_t autoExcludedBlocks, AfhChannelMap usedChannels) {
+    for (uint8_t i = 0; i < kAfhChannelMapLen; i++) {
+        usedChannels[i] = ~excludedChannels[i];
+    }
+
+    // Channel 79 doesn't exist, the last bit is reserved
+    usedChannels[kAfhChannelMapLen - 1] &= 0x7f;
+
+    for (uint8_t block = 0; block < kAfhBlocksCount; block++) {
+        if (!(autoExcludedBlocks & (1 << block))) {
+            continue;
+        }
+
+        for (uint8_t channel = kAfhBlocks[block].firstChannel; channel <= kAfhBlocks[block].lastChannel; channel++) {
+            usedChannels[channel / 8] &= ~(1 << (channel % 8));
+        }
+    }
+}
+
+static uint8_t countUsedChannels(const AfhChannelMap usedChannels) {
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < kAfhChannelMapLen; i++) {
+        count += __builtin_popcount(usedChannels[i]);
+    }
+
+    return count;
+}
+
+static bool isAllowedExclusion(const AfhController *controller, uint8_t autoExcludedBlocks) {
+    AfhChannelMap usedChannels;
+    buildUsedChannels(controller->excludedChannels, autoExcludedBlocks, usedChannels);
+
+    return countUsedChannels(usedChannels) >= kAfhMinUsedChannels;
+}
@@ -0,0 +1,49 @@
+#include <assert.h>
+#include <string.h>
+
+#include "bda_set.h"
+
+static uint32_t hashBda(const esp_bd_addr_t address) {
+    // Lower address part (LAP) is the most random one
+    uint32_t lap = address[3] << 16 | address[4] << 8 | address[5];
+
+    // Fibonacci hashing
+    return (lap * 2654435761u) >> (32 - kBdaSetCapacityBits);
+}
+
+void clearBdaSet(BdaSet *set) {
+    assert(set);
+
+    memset(set, 0, sizeof(*set));
+}
+
+// Returns NULL if address is not in the set and the set is full
+BdaSetEntry *findOrInsertBda(BdaSet *set, const esp_bd_addr_t address, bool *isInserted) {
+    assert(set);
+    assert(isInserted);
+
+    *isInserted = false;
+
+    for (uint32_t probe = 0, idx = hashBda(address); probe < kBdaSetCapacity; probe++, idx = (idx + 1) & (kBdaSetCapacity - 1)) {
+        BdaSetEntry *entry = &set->entries[idx];
+
+        if (!entry->isUsed) {
+            if (set->size >= kBdaSetMaxSize) {
+                return NULL;
+            }
+
+            memcpy(entry->address, address, sizeof(esp_bd_addr_t));
+            entry->isUsed = true;
+            set->size++;
+
+            *isInserted = true;
+            return entry;
+        }
+
+        if (memcmp(entry->address, address, sizeof(esp_bd_addr_t)) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
@@ -8,9 +8,13 @@
 #include <esp_a2dp_api.h>
 #include <esp_avrc_api.h>
 #include <esp_log.h>
+#include <esp_pm.h>
+#include <esp_timer.h>
 #include <nvs.h>
 #include <nvs_flash.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <esp_bt_defs.h>
 
@@ -18,6 +22,7 @@
 #include "dispatcher.h"
 #include "freertos/idf_additions.h"
 #include "freertos/projdefs.h"
+#include "peer_storage.h"
 #include "portmacro.h"
 #include "utils.h"
 
@@ -25,6 +30,10 @@
 // AVRCP used transaction label
 #define APP_RC_CT_TL_GET_CAPS            (0)
 #define APP_RC_CT_TL_RN_VOLUME_CHANGE    (1)
+#define APP_RC_CT_TL_SET_ABSOLUTE_VOLUME (2)
+
+#define kAvrcMaxVolume (0x7f) // AVRCP absolute volume range is [0; 127]
+#define kAvrcNoVolume (0xff)
 
 #ifndef NDEBUG
 #define CHECK_CONSTRUCTION_TOKEN()                                                          \
@@ -42,11 +51,123 @@ enum {
     HEART_BEAT_EVENT = 0xff00, // Shows state handler that it was called from the heart beat timer
 };
 
+enum {
+    LINK_QUALITY_SAMPLE_EVENT,   // Sampling period passed
+    LINK_QUALITY_RSSI_EVENT,     // RSSI delta has been read
+    LINK_QUALITY_TX_POWER_CONFIG, // TX power control has been reconfigured
+};
+
+// Compact copies of the A2DP callback params. Only the fields used by the state handlers are kept,
+// so the record travels inside the dispatcher queue item
+typedef union {
+    uint8_t connectionState; // ESP_A2D_CONNECTION_STATE_EVT
+    esp_a2d_mcc_t codecConfig; // ESP_A2D_AUDIO_CFG_EVT
+
+    struct {
+        uint8_t command;
+        uint8_t status;
+    } mediaCtrlAck; // ESP_A2D_MEDIA_CTRL_ACK_EVT
+
+    uint16_t sinkDelay; // ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT, in 1/10 ms
+} A2dpEventRecord;
+
+typedef union {
+    struct {
+        bool isConnected;
+        esp_bd_addr_t address;
+    } connection; // ESP_AVRC_CT_CONNECTION_STATE_EVT
+
+    struct {
+        uint8_t keyCode;
+        uint8_t keyState;
+        uint8_t responseCode;
+    } passthrough; // ESP_AVRC_CT_PASSTHROUGH_RSP_EVT
+
+    struct {
+        uint8_t attributeId;
+        int8_t slot; // Slab slot with the text, -1 if the slab was full
+        uint8_t textLen;
+    } metadata; // ESP_AVRC_CT_METADATA_RSP_EVT
+
+    struct {
+        uint8_t eventId;
+        esp_avrc_rn_param_t parameter;
+    } notification; // ESP_AVRC_CT_CHANGE_NOTIFY_EVT
+
+    struct {
+        uint32_t featureMask;
+        uint16_t targetFeatures;
+    } features; // ESP_AVRC_CT_REMOTE_FEATURES_EVT
+
+    struct {
+        uint8_t count;
+        uint16_t eventBits;
+    } capabilities; // ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT
+
+    uint8_t volume; // ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT
+} AvrcEventRecord;
+
+_Static_assert(sizeof(A2dpEventRecord) <= kDispatcherInlineParamSize, "A2DP record doesn't fit into the dispatcher queue item");
+_Static_assert(sizeof(AvrcEventRecord) <= kDispatcherInlineParamSize, "AVRC record doesn't fit into the dispatcher queue item");
+
+enum {
+    AFH_EXCLUSION_EVENT, // User has set the channel exclusion map
+    AFH_AUTO_MODE_EVENT, // User has switched the auto mode
+};
+
+enum {
+    LINK_PROFILE_MODE_EVENT,  // User has changed the link profile mode
+    LINK_PROFILE_AUDIO_EVENT, // Audio state has been changed
+    LINK_PROFILE_SNIFF_EVENT, // Link has entered or left sniff mode
+};
+
+enum {
+    VOLUME_REQUESTED_EVENT, // User has changed the volume
+    VOLUME_TIMER_EVENT,     // Pacing interval passed or response hasn't been received in time
+};
+
+// Seqlock protected copy of the device state. Odd sequence means that write is in progress
+static BluetoothDeviceSnapshot snapshot = {
+    .deviceState = DEVICE_STATE_IDLE,
+    .audioState = AUDIO_STATE_IDLE,
+};
+static _Atomic uint32_t snapshotSequence = 0;
+
+// Updated from the A2DP data callback, collected by the link quality sampler
+static _Atomic uint32_t dataStarvations = 0;
+static int64_t lastDataCallbackTimeUs = 0;
+static portMUX_TYPE snapshotWriteLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Milestones come from user tasks, GAP callback, btDispatcher and the A2DP data callback
+static ConnectionProfiler connectionProfiler;
+static portMUX_TYPE connectionProfilerLock = portMUX_INITIALIZER_UNLOCKED;
+static _Atomic bool isFirstDataPending = false;
+
+// SBC encoding runs on the CPU, so the max frequency is held while audio isn't idle
+static esp_pm_lock_handle_t streamingPmLock = NULL;
+static _Atomic bool isStreamingPmLockHeld = false;
+
+// Metadata texts are owned by the stack only during the callback, so they are copied here.
+// Slot is taken by the AVRC callback and released by the handler on btDispatcher
+static char metadataSlab[kMetadataSlabSlots][kMetadataTextMaxLen + 1];
+static _Atomic bool isMetadataSlotBusy[kMetadataSlabSlots];
+
 static BluetoothDevice device = {
     .deviceState = DEVICE_STATE_IDLE,
     .audioState = AUDIO_STATE_IDLE,
+    .isAutoReconnecting = false,
+    .isStoppingDiscovery = false,
+    .reportedDevicesCount = 0,
+    .pendingNameRequestsCount = 0,
+    .isNameRequestActive = false,
     .btDispatcher = { NULL, NULL },
     .heartBeatTimer = NULL,
+    .volumeTimer = NULL,
+    .linkQualityTimer = NULL,
+    .hasPendingVolume = false,
+    .isVolumeInFlight = false,
+    .lastSentAvrcVolume = kAvrcNoVolume,
+    .queuedVolumeRequests = 0,
     .constructionToken = 0,
 };
 
@@ -56,6 +177,11 @@ static void launchDevice(uint16_t unused1, void *unused2);
 static void gapCallback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param);
 
 static void filterScanResult(esp_bt_gap_cb_param_t *param);
+static void reportDiscoveredPeer(PeerDeviceData *peer, bool isKnownPeer);
+static bool queueNameRequest(const PeerDeviceData *peer);
+static void dropNameRequest(const esp_bd_addr_t address);
+static void requestNextRemoteName();
+static void handleRemoteName(esp_bt_gap_cb_param_t *param);
 
 static void handleDiscoveryStateChanged(esp_bt_gap_cb_param_t *param);
 static void handleLegacyPinPairing(esp_bt_gap_cb_param_t *param);
@@ -64,6 +190,7 @@ static void a2dpCallback(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param);
 static int32_t a2dpDataCallbackWrapper(uint8_t *data, int32_t length);
 
 static void heartBeatTimer(TimerHandle_t timer);
+static void flushPeerCacheTask(uint16_t unused1, void *unused2);
 
 static void deviceStateHandler(uint16_t event, void *param);
 
@@ -72,26 +199,56 @@ static void connectedStateHandler(uint16_t event, void *param);
 static void disconnectingStateHandler(uint16_t event, void *param);
 static void disconnectedStateHandler(uint16_t event, void *param);
 
-static void processAudioState(uint16_t event, esp_a2d_cb_param_t *param);
+static void processAudioState(uint16_t event, A2dpEventRecord *record);
+static void handleA2dpDisconnected();
 
 static void avrcCallback(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t *param);
 static void handleAVRCEvent(uint16_t event, void *param);
 static void avrcVolumeChanged();
 static void avrcNotificationEvent(uint8_t event_id, esp_avrc_rn_param_t *event_parameter);
+static int8_t copyMetadataText(const uint8_t *text, int textLen);
+
+static void linkQualityTimer(TimerHandle_t timer);
+static void linkQualityHandler(uint16_t event, void *param);
+static void recordAdvisedBitpool(uint8_t bitpool);
+static void applyTxPower(esp_power_level_t minLevel, esp_power_level_t maxLevel);
+
+static void afhHandler(uint16_t event, void *param);
 
+static void linkProfileHandler(uint16_t event, void *param);
+static void updateLinkProfile();
+static void applyAfhChannels();
+
+static void volumeTimer(TimerHandle_t timer);
+static void volumeSchedulerHandler(uint16_t event, void *param);
+static void sendPendingVolume();
+static bool isVolumeSchedulerBusy();
+static void resetVolumeScheduler();
+static void updateVolume(uint8_t volumeLevel);
+
+static void beginSnapshotWrite();
+static void endSnapshotWrite();
+static void publishStates();
+static void updateSinkLatency(uint16_t latency);
+
+static void notifyDeviceStateChanged(DeviceState newState);
+static void notifyAudioStateChanged(AudioState newState);
 static void changeDeviceState(DeviceState newState);
 static void changeAudioState(AudioState newState);
+static bool transitionDeviceState(DeviceState expectedState, DeviceState newState);
+static bool transitionAudioState(AudioState expectedState, AudioState newState);
 static void eventWrapper(uint16_t eventType, void *param);
+static void updateStreamingPmLock(AudioState audioState);
+static void recordMilestone(ConnectionMilestone milestone);
 
 bool startAudio() {
     CHECK_CONSTRUCTION_TOKEN();
 
-    if (device.deviceState != DEVICE_STATE_CONNECTED || device.audioState != AUDIO_STATE_IDLE) {
+    if (device.deviceState != DEVICE_STATE_CONNECTED || !transitionAudioState(AUDIO_STATE_IDLE, AUDIO_STATE_STARTING)) {
         return false;
     }
 
     ESP_LOGI(BT_DEVICE_TAG, "Checking A2DP");
-    changeAudioState(AUDIO_STATE_STARTING);
     ESP_ERROR_CHECK(esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_CHECK_SRC_RDY));
 
     return true;
@@ -100,12 +257,11 @@ bool startAudio() {
 bool stopAudio() {
     CHECK_CONSTRUCTION_TOKEN();
 
-    if (device.deviceState != DEVICE_STATE_CONNECTED || device.audioState != AUDIO_STATE_STARTED) {
+    if (device.deviceState != DEVICE_STATE_CONNECTED || !transitionAudioState(AUDIO_STATE_STARTED, AUDIO_STATE_STOPPING)) {
         return false;
     }
 
     ESP_LOGI(BT_DEVICE_TAG,  "A2DP suspending...");
-    changeAudioState(AUDIO_STATE_STOPPING);
     ESP_ERROR_CHECK(esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_SUSPEND));
 
     return true;
@@ -115,57 +271,145 @@ bool connectToDevice(PeerDeviceData *peer) {
     assert(peer);
     CHECK_CONSTRUCTION_TOKEN();
 
-    if (device.deviceState != DEVICE_STATE_DISCOVERING && device.deviceState != DEVICE_STATE_IDLE
-        && device.deviceState != DEVICE_STATE_DISCONNECTED) {
-        return false;
-    }
+    DeviceState previousState = device.deviceState;
 
-    char bdaStr[18];
+    do {
+        if (previousState != DEVICE_STATE_DISCOVERING && previousState != DEVICE_STATE_IDLE
+            && previousState != DEVICE_STATE_DISCONNECTED) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&device.deviceState, &previousState, DEVICE_STATE_CONNECTING));
+
+    // publishStates copies the peer from other tasks, so it's written under the snapshot lock and published at once
+    beginSnapshotWrite();
     device.selectedPeer = *peer;
+    snapshot.selectedPeer = *peer;
+    endSnapshotWrite();
+
+    char bdaStr[18];
 
     ESP_LOGI(BT_DEVICE_TAG, "Target device found. Address: %s. Name: %s", 
              bdaToStr(device.selectedPeer.address, bdaStr, sizeof(bdaStr)), device.selectedPeer.name);
     
-    changeDeviceState(DEVICE_STATE_CONNECTING);
+    notifyDeviceStateChanged(DEVICE_STATE_CONNECTING);
 
-    if (device.deviceState == DEVICE_STATE_DISCOVERING) {
+    if (previousState == DEVICE_STATE_DISCOVERING) {
         ESP_LOGI(BT_DEVICE_TAG, "Stopping device discovery...");
         esp_bt_gap_cancel_discovery();
     }
 
     ESP_LOGI(BT_DEVICE_TAG, "Connecting to peer %s", device.selectedPeer.name);
+    recordMilestone(CONNECTION_MILESTONE_CONNECT_ISSUED);
     esp_a2d_source_connect(device.selectedPeer.address);
     return true;
 }
 
+bool connectToLastPeer() {
+    CHECK_CONSTRUCTION_TOKEN();
+
+    PeerDeviceData lastPeer;
+
+    if (!loadLastPeer(&lastPeer)) {
+        return false;
+    }
+
+    // Page the peer directly: inquiry takes several seconds while paging a known device takes about one
+    ESP_LOGI(BT_DEVICE_TAG, "Reconnecting to the last peer %s", lastPeer.name);
+    device.isAutoReconnecting = true;
+
+    if (!connectToDevice(&lastPeer)) {
+        device.isAutoReconnecting = false;
+        return false;
+    }
+
+    return true;
+}
+
 bool disconnectFromDevice() {
     CHECK_CONSTRUCTION_TOKEN();
 
-    if (device.deviceState != DEVICE_STATE_CONNECTED) {
+    if (!transitionDeviceState(DEVICE_STATE_CONNECTED, DEVICE_STATE_DISCONNECTING)) {
         return false;
     }
 
     changeAudioState(AUDIO_STATE_IDLE);
     esp_a2d_source_disconnect(device.selectedPeer.address);
-    changeDeviceState(DEVICE_STATE_DISCONNECTING);
 
     return true;
 }
 
-bool startDiscovery(uint8_t inquiryDuration) {
+bool startDiscovery(const DiscoveryConfig *config) {
+    assert(config);
     CHECK_CONSTRUCTION_TOKEN();
 
-    if (device.deviceState != DEVICE_STATE_IDLE && device.deviceState != DEVICE_STATE_DISCONNECTED) {
+    if (!transitionDeviceState(DEVICE_STATE_IDLE, DEVICE_STATE_DISCOVERING) &&
+        !transitionDeviceState(DEVICE_STATE_DISCONNECTED, DEVICE_STATE_DISCOVERING)) {
         return false;
     }
 
+    device.discoveryConfig = *config;
+    device.isStoppingDiscovery = false;
+    clearBdaSet(&device.discoveredDevices);
+    device.reportedDevicesCount = 0;
+
     ESP_LOGI(BT_DEVICE_TAG, "Starting device discovery...");
-    changeDeviceState(DEVICE_STATE_DISCOVERING);
-    ESP_ERROR_CHECK(esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, inquiryDuration, 0));
+    recordMilestone(CONNECTION_MILESTONE_DISCOVERY_STARTED);
+    peerCacheNewGeneration();
+    ESP_ERROR_CHECK(esp_bt_gap_start_discovery(ESP_BT_INQ_MODE_GENERAL_INQUIRY, config->inquiryDuration, 0));
+
+    // Known peers are shown right away, so user doesn't have to wait for the inquiry to find them.
+    // They are copied one at a time, the whole cache doesn't fit the stacks of the calling tasks
+    PeerDeviceData cachedPeer;
+
+    for (size_t rank = 0; peerCacheGetRanked(rank, &cachedPeer); rank++) {
+        dispatchTask(&device.eventDispatcher, eventWrapper, DEVICE_DISCOVERED, &cachedPeer, sizeof(PeerDeviceData));
+    }
 
     return true;
 }
 
+bool configureTxPowerControl(const TxPowerConfig *config) {
+    assert(config);
+    CHECK_CONSTRUCTION_TOKEN();
+
+    if (config->minLevel > config->maxLevel || config->maxLevel > ESP_PWR_LVL_P9) {
+        return false;
+    }
+
+    return dispatchTask(&device.btDispatcher, linkQualityHandler, LINK_QUALITY_TX_POWER_CONFIG, (void *)config, sizeof(*config));
+}
+
+bool setAfhChannelExclusion(const AfhChannelMap excludedChannels) {
+    assert(excludedChannels);
+    CHECK_CONSTRUCTION_TOKEN();
+
+    return dispatchTask(&device.btDispatcher, afhHandler, AFH_EXCLUSION_EVENT, (void *)excludedChannels, sizeof(AfhChannelMap));
+}
+
+bool setAfhAutoMode(bool isEnabled) {
+    CHECK_CONSTRUCTION_TOKEN();
+
+    return dispatchTask(&device.btDispatcher, afhHandler, AFH_AUTO_MODE_EVENT, &isEnabled, sizeof(isEnabled));
+}
+
+bool setLinkProfileMode(LinkProfileMode mode) {
+    CHECK_CONSTRUCTION_TOKEN();
+
+    return dispatchTask(&device.btDispatcher, linkProfileHandler, LINK_PROFILE_MODE_EVENT, &mode, sizeof(mode));
+}
+
+// Copies timings of the last connection attempts starting with the newest one
+uint8_t getConnectionTimings(ConnectionAttempt *attempts, uint8_t maxAttempts) {
+    assert(attempts);
+    CHECK_CONSTRUCTION_TOKEN();
+
+    portENTER_CRITICAL(&connectionProfilerLock);
+    uint8_t count = copyConnectionAttempts(&connectionProfiler, attempts, maxAttempts);
+    portEXIT_CRITICAL(&connectionProfilerLock);
+
+    return count;
+}
+
 bool setVolume(uint8_t volumeLevel) {
     CHECK_CONSTRUCTION_TOKEN();
 
@@ -174,10 +418,16 @@ bool setVolume(uint8_t volumeLevel) {
     }
 
     ESP_LOGI(BT_DEVICE_TAG, "Set absolute volume: volume %d", volumeLevel);
-    esp_avrc_ct_send_set_absolute_volume_cmd(APP_RC_CT_TL_RN_VOLUME_CHANGE, volumeLevel);
-    avrcVolumeChanged();
+    updateVolume(volumeLevel);
 
-    dispatchTask(&device.eventDispatcher, eventWrapper, VOLUME_CHANGED, &volumeLevel, sizeof(volumeLevel));
+    // Command is sent by the scheduler, so fast encoder rotation doesn't flood the link.
+    // Sink notifications are ignored until the scheduler has seen this request
+    atomic_fetch_add(&device.queuedVolumeRequests, 1);
+
+    if (!dispatchTask(&device.btDispatcher, volumeSchedulerHandler, VOLUME_REQUESTED_EVENT, &volumeLevel, sizeof(volumeLevel))) {
+        atomic_fetch_sub(&device.queuedVolumeRequests, 1);
+        return false;
+    }
 
     return true;
 }
@@ -193,13 +443,28 @@ void initBtDevice(BluetoothDeviceCallbacks *callbacks) {
     // Initialize BluetoothDevice fields
     device.deviceState = DEVICE_STATE_IDLE;
     device.audioState = AUDIO_STATE_IDLE;
+    device.isAutoReconnecting = false;
+    device.isStoppingDiscovery = false;
+    clearBdaSet(&device.discoveredDevices);
+    device.reportedDevicesCount = 0;
+    device.pendingNameRequestsCount = 0;
+    device.isNameRequestActive = false;
     device.heartBeatTimer = NULL;
+    device.volumeTimer = NULL;
+    device.linkQualityTimer = NULL;
+    device.hasPendingVolume = false;
+    device.isVolumeInFlight = false;
+    device.lastSentAvrcVolume = kAvrcNoVolume;
+    device.queuedVolumeRequests = 0;
     device.constructionToken = 0;
 
     PeerDeviceData nullPeer = {
         .name = {},
         .nameLen = 0,
         .address = {},
+        .deviceClass = 0,
+        .rssi = 0,
+        .score = 0,
     };
 
     device.selectedPeer = nullPeer;
@@ -212,6 +477,8 @@ void initBtDevice(BluetoothDeviceCallbacks *callbacks) {
     }
     ESP_ERROR_CHECK(nvsErr);
 
+    initPeerCache();
+
     // Release BLE memory
     ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_BLE));
 
@@ -262,17 +529,56 @@ void initBtDevice(BluetoothDeviceCallbacks *callbacks) {
     bdaToStr(esp_bt_dev_get_address(), deviceBda, sizeof(deviceBda));
     ESP_LOGI(BT_DEVICE_TAG, "Device address: [%s]", deviceBda);
 
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "bt_streaming", &streamingPmLock) != ESP_OK) {
+        streamingPmLock = NULL;
+    }
+
     // Init dispatchers
     initDispatcher(&device.btDispatcher);
     initDispatcher(&device.eventDispatcher);
 
     device.constructionToken = 1;
+}
+
+// Callbacks are called only after this call, so the stack init can run before the UI is ready
+void startBtDevice() {
+    CHECK_CONSTRUCTION_TOKEN();
 
     // dispatch connection routine
     // dispatchTask(&device.btDispatcher, launchDevice, 0, NULL, 0);
     launchDevice(0, NULL);
 }
 
+// Used before deep sleep. Device can't be used after this call
+void shutdownBtDevice() {
+    CHECK_CONSTRUCTION_TOKEN();
+
+    device.constructionToken = 0;
+
+    // Timers are created by startBtDevice, which may not have been called yet
+    if (device.heartBeatTimer) {
+        xTimerStop(device.heartBeatTimer, portMAX_DELAY);
+    }
+
+    if (device.linkQualityTimer) {
+        xTimerStop(device.linkQualityTimer, portMAX_DELAY);
+    }
+
+    if (device.volumeTimer) {
+        xTimerStop(device.volumeTimer, portMAX_DELAY);
+    }
+
+    flushPeerCache();
+
+    if (esp_bluedroid_disable() != ESP_OK) {
+        ESP_LOGE(BT_DEVICE_TAG, "Disable bluedroid failed");
+    }
+
+    if (esp_bt_controller_disable() != ESP_OK) {
+        ESP_LOGE(BT_DEVICE_TAG, "Disable bluetooth controller failed");
+    }
+}
+
 static void launchDevice(uint16_t unused1, void *unused2) {
     // Init generic access profile
     ESP_ERROR_CHECK(esp_bt_gap_set_device_name(kDeviceName));
@@ -300,6 +606,28 @@ static void launchDevice(uint16_t unused1, void *unused2) {
     device.heartBeatTimer = xTimerCreate("ConnectionTimer", kHeartBeatTimerPeriodMs / portTICK_PERIOD_MS,
                                          pdTRUE, &timerId, heartBeatTimer);
     xTimerStart(device.heartBeatTimer, portMAX_DELAY);
+
+    // One-shot timer for the volume commands pacing. Started by the scheduler
+    device.volumeTimer = xTimerCreate("VolumeTimer", kVolumePacingMs / portTICK_PERIOD_MS, pdFALSE, NULL, volumeTimer);
+
+    LinkQualityConfig linkQualityConfig = LINK_QUALITY_DEFAULT_CONFIG();
+    initLinkQualityController(&device.linkQuality, &linkQualityConfig);
+
+    device.linkQualityTimer = xTimerCreate("LinkQualityTimer", kLinkQualitySamplePeriodMs / portTICK_PERIOD_MS,
+                                           pdTRUE, NULL, linkQualityTimer);
+    xTimerStart(device.linkQualityTimer, portMAX_DELAY);
+
+    // Default range is used for inquiry and paging, so the remembered range is restored after disconnection
+    ESP_ERROR_CHECK(esp_bredr_tx_power_get(&device.defaultMinTxPower, &device.defaultMaxTxPower));
+
+    TxPowerConfig txPowerConfig = TX_POWER_DEFAULT_CONFIG();
+    txPowerConfig.maxLevel = device.defaultMaxTxPower;
+    initTxPowerController(&device.txPower, &txPowerConfig);
+
+    AfhAutoConfig afhConfig = AFH_AUTO_DEFAULT_CONFIG();
+    initAfhController(&device.afh, &afhConfig);
+
+    connectToLastPeer();
 }
 
 static void gapCallback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param) {
@@ -310,6 +638,7 @@ static void gapCallback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *para
     // Discovered result
     case ESP_BT_GAP_DISC_RES_EVT:
         if (device.deviceState == DEVICE_STATE_DISCOVERING) {
+            recordMilestone(CONNECTION_MILESTONE_FIRST_DEVICE_FOUND);
             filterScanResult(param);
         }
         break;
@@ -319,6 +648,11 @@ static void gapCallback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *para
         handleDiscoveryStateChanged(param);
         break;
 
+    // Remote name requested for the device without name in the inquiry response
+    case ESP_BT_GAP_READ_REMOTE_NAME_EVT:
+        handleRemoteName(param);
+        break;
+
     // Authentication complete
     case ESP_BT_GAP_AUTH_CMPL_EVT:
         if (param->auth_cmpl.stat == ESP_BT_STATUS_SUCCESS) {
@@ -355,9 +689,36 @@ static void gapCallback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *para
         break;
 #endif
 
+    // Link quality sample
+    case ESP_BT_GAP_READ_RSSI_DELTA_EVT:
+        if (param->read_rssi_delta.stat == ESP_BT_STATUS_SUCCESS) {
+            dispatchTask(&device.btDispatcher, linkQualityHandler, LINK_QUALITY_RSSI_EVENT,
+                         &param->read_rssi_delta.rssi_delta, sizeof(param->read_rssi_delta.rssi_delta));
+        }
+        break;
+
+    case ESP_BT_GAP_SET_AFH_CHANNELS_EVT:
+        if (param->set_afh_channels.stat != ESP_BT_STATUS_SUCCESS) {
+            ESP_LOGE(BT_DEVICE_TAG, "AFH channels have not been set. Status: %d", param->set_afh_channels.stat);
+        }
+        break;
+
     // GAP mode changed
-    case ESP_BT_GAP_MODE_CHG_EVT:
+    case ESP_BT_GAP_MODE_CHG_EVT: {
         ESP_LOGI(BT_DEVICE_TAG, "GAP mode changed: %d", param->mode_chg.mode);
+
+        bool isSniff = param->mode_chg.mode == ESP_BT_PM_MD_SNIFF;
+        dispatchTask(&device.btDispatcher, linkProfileHandler, LINK_PROFILE_SNIFF_EVENT, &isSniff, sizeof(isSniff));
+        break;
+    }
+
+    case ESP_BT_GAP_QOS_CMPL_EVT:
+        if (param->qos_cmpl.stat != ESP_BT_STATUS_SUCCESS) {
+            ESP_LOGE(BT_DEVICE_TAG, "QoS setup failed. Status: %d", param->qos_cmpl.stat);
+            break;
+        }
+
+        ESP_LOGI(BT_DEVICE_TAG, "QoS poll interval: %" PRIu32 " slots", param->qos_cmpl.t_poll);
         break;
 
     // Get deice name
@@ -380,14 +741,22 @@ static void gapCallback(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *para
 static void handleDiscoveryStateChanged(esp_bt_gap_cb_param_t *param) {
     switch (param->disc_st_chg.state) {
     case ESP_BT_GAP_DISCOVERY_STOPPED:
-        if (device.deviceState != DEVICE_STATE_CONNECTING) {
+        // Discovery is also stopped when user picks a device. Device is already connecting in this case
+        if (transitionDeviceState(DEVICE_STATE_DISCOVERING, DEVICE_STATE_IDLE)) {
             ESP_LOGI(BT_DEVICE_TAG, "Discovery ended. Going idle");
-            changeDeviceState(DEVICE_STATE_IDLE);
         } 
+
+        // Store sightings once per inquiry instead of on every result
+        dispatchTask(&device.btDispatcher, flushPeerCacheTask, 0, NULL, 0);
+
+        // Paging for names is not done during inquiry, so nameless devices are resolved now
+        requestNextRemoteName();
         break;
 
     case ESP_BT_GAP_DISCOVERY_STARTED:
-        // TODO update status?
+        // Name queue is only touched from the GAP callback. Names of the previous discovery are not needed anymore
+        device.pendingNameRequestsCount = 0;
+
         ESP_LOGI(BT_DEVICE_TAG, "Discovery started");
       break;
     }
@@ -415,9 +784,6 @@ static void handleLegacyPinPairing(esp_bt_gap_cb_param_t *param) {
 static void filterScanResult(esp_bt_gap_cb_param_t *param) {
     assert(param);
 
-    char bdaStr[18];
-    ESP_LOGI(BT_DEVICE_TAG, "Scanned device: %s", bdaToStr(param->disc_res.bda, bdaStr, sizeof(bdaStr)));
-
     uint32_t deviceClass = 0;
     int32_t rssi = -129;
     uint8_t *extInquiryResponse = NULL;
@@ -429,13 +795,11 @@ static void filterScanResult(esp_bt_gap_cb_param_t *param) {
         // Class of device
         case ESP_BT_GAP_DEV_PROP_COD:
             deviceClass = *(uint32_t *)(property->val);
-            ESP_LOGI(BT_DEVICE_TAG, "\tClass of device: 0x%" PRId32, deviceClass);
             break;
 
         // Received signal strength indication
         case ESP_BT_GAP_DEV_PROP_RSSI:
             rssi = *(int8_t *)(property->val);
-            ESP_LOGI(BT_DEVICE_TAG, "\tRSSI: %" PRId32, rssi);
             break;
 
         case ESP_BT_GAP_DEV_PROP_EIR:
@@ -453,25 +817,218 @@ static void filterScanResult(esp_bt_gap_cb_param_t *param) {
         return;
     }
 
+    bool isNewDevice = false;
+    BdaSetEntry *seenDevice = findOrInsertBda(&device.discoveredDevices, param->disc_res.bda, &isNewDevice);
+
+    if (!seenDevice) {
+        return;
+    }
+
+    seenDevice->rssi = rssi;
+
+    // Crowded places produce lots of repeated responses. Only significant RSSI changes of shown devices are worth reporting.
+    // Device which isn't shown yet is waiting for its name, which may come with a later response
+    if (!isNewDevice && seenDevice->isReported && abs(rssi - seenDevice->reportedRssi) < kRssiReportThreshold) {
+        return;
+    }
+
+    if (!isNewDevice && !seenDevice->isReported && !extInquiryResponse) {
+        return;
+    }
+
+    if (isNewDevice) {
+        char bdaStr[18];
+        ESP_LOGI(BT_DEVICE_TAG, "Scanned device: %s, class of device: 0x%" PRIx32 ", RSSI: %" PRId32,
+                 bdaToStr(param->disc_res.bda, bdaStr, sizeof(bdaStr)), deviceClass, rssi);
+    }
+
+    PeerDeviceData peer = {
+        .name = {},
+        .nameLen = 0,
+        .address = {},
+        .deviceClass = deviceClass,
+        .rssi = rssi,
+        .score = 0,
+    };
+
+    memcpy(peer.address, param->disc_res.bda, ESP_BD_ADDR_LEN);
+
     if (extInquiryResponse) {
-        PeerDeviceData peer = {
-            .name = {},
-            .nameLen = 0,
-            .address = {},
-        };
-
-        if (!getNameFromEir(extInquiryResponse, (uint8_t *)peer.name, &peer.nameLen)) {
-            ESP_LOGE(BT_DEVICE_TAG, "Unable to get device name from extended inquiry response");
-            return;
+        getNameFromEir(extInquiryResponse, (uint8_t *)peer.name, &peer.nameLen);
+    }
+
+    // Cache fills the name of known peers if it's missing in the response
+    bool isKnownPeer = peerCacheSeen(&peer);
+
+    if (peer.nameLen == 0) {
+        if (!seenDevice->isNameQueued) {
+            ESP_LOGI(BT_DEVICE_TAG, "Unable to get device name from extended inquiry response. Requesting remote name");
+            seenDevice->isNameQueued = queueNameRequest(&peer);
         }
+        return;
+    }
+
+    if (seenDevice->isNameQueued) {
+        dropNameRequest(peer.address);
+        seenDevice->isNameQueued = false;
+    }
 
-        memcpy(peer.address, param->disc_res.bda, ESP_BD_ADDR_LEN);
-        dispatchTask(&device.eventDispatcher, eventWrapper, DEVICE_DISCOVERED, &peer, sizeof(peer));
+    if (!seenDevice->isReported) {
+        seenDevice->isReported = true;
+        device.reportedDevicesCount++;
+    }
+
+    seenDevice->reportedRssi = rssi;
+
+    reportDiscoveredPeer(&peer, isKnownPeer);
+}
+
+static void reportDiscoveredPeer(PeerDeviceData *peer, bool isKnownPeer) {
+    dispatchTask(&device.eventDispatcher, eventWrapper, DEVICE_DISCOVERED, peer, sizeof(PeerDeviceData));
+
+    if (device.deviceState != DEVICE_STATE_DISCOVERING || device.isStoppingDiscovery) {
+        return;
+    }
+
+    // Nameless devices wait for the name requests after the inquiry, so they don't stop it
+    bool isLimitReached = device.discoveryConfig.maxRenderingDevices != 0 &&
+                          device.reportedDevicesCount >= device.discoveryConfig.maxRenderingDevices;
+
+    if (isLimitReached || (isKnownPeer && device.discoveryConfig.stopOnKnownPeer)) {
+        ESP_LOGI(BT_DEVICE_TAG, "Enough devices found. Stopping discovery early");
+        device.isStoppingDiscovery = true;
+        esp_bt_gap_cancel_discovery();
     }
 }
 
+static bool queueNameRequest(const PeerDeviceData *peer) {
+    if (device.pendingNameRequestsCount >= kMaxPendingNameRequests) {
+        ESP_LOGW(BT_DEVICE_TAG, "Too many nameless devices. Skipping");
+        return false;
+    }
+
+    device.pendingNameRequests[device.pendingNameRequestsCount] = *peer;
+    device.pendingNameRequestsCount++;
+
+    return true;
+}
+
+// Device answered with its name before the remote name was requested. Requests are sent only after the inquiry,
+// so the queued one hasn't reached the controller yet and removing it cancels it
+static void dropNameRequest(const esp_bd_addr_t address) {
+    for (uint8_t requestIdx = 0; requestIdx < device.pendingNameRequestsCount; requestIdx++) {
+        if (memcmp(device.pendingNameRequests[requestIdx].address, address, ESP_BD_ADDR_LEN) != 0) {
+            continue;
+        }
+
+        device.pendingNameRequestsCount--;
+        memmove(&device.pendingNameRequests[requestIdx], &device.pendingNameRequests[requestIdx + 1],
+                (device.pendingNameRequestsCount - requestIdx) * sizeof(PeerDeviceData));
+        return;
+    }
+}
+
+static void requestNextRemoteName() {
+    if (device.isNameRequestActive || device.pendingNameRequestsCount == 0) {
+        return;
+    }
+
+    // Names are requested after the inquiry
+    if (device.deviceState == DEVICE_STATE_DISCOVERING) {
+        return;
+    }
+
+    // User has already picked a device, so names are not needed anymore
+    if (device.deviceState != DEVICE_STATE_IDLE) {
+        device.pendingNameRequestsCount = 0;
+        return;
+    }
+
+    PeerDeviceData *peer = &device.pendingNameRequests[device.pendingNameRequestsCount - 1];
+
+    if (esp_bt_gap_read_remote_name(peer->address) != ESP_OK) {
+        ESP_LOGE(BT_DEVICE_TAG, "Unable to request remote name");
+        device.pendingNameRequestsCount = 0;
+        return;
+    }
+
+    device.isNameRequestActive = true;
+}
+
+static void handleRemoteName(esp_bt_gap_cb_param_t *param) {
+    if (!device.isNameRequestActive) {
+        return;
+    }
+
+    device.isNameRequestActive = false;
+
+    // Queue is cleared when a new discovery starts, so the name may belong to the previous one
+    if (device.pendingNameRequestsCount == 0 ||
+        memcmp(device.pendingNameRequests[device.pendingNameRequestsCount - 1].address, param->read_rmt_name.bda,
+               ESP_BD_ADDR_LEN) != 0) {
+        requestNextRemoteName();
+        return;
+    }
+
+    device.pendingNameRequestsCount--;
+
+    PeerDeviceData peer = device.pendingNameRequests[device.pendingNameRequestsCount];
+
+    // Names are requested only while idle. Otherwise a new discovery has started or a device has been picked since
+    // the request, so the name is stale. Device which responds to the new inquiry is queued again
+    if (device.deviceState != DEVICE_STATE_IDLE) {
+        device.pendingNameRequestsCount = 0;
+        return;
+    }
+
+    if (param->read_rmt_name.stat == ESP_BT_STATUS_SUCCESS) {
+        size_t nameLen = strnlen((const char *)param->read_rmt_name.rmt_name, ESP_BT_GAP_MAX_BDNAME_LEN);
+
+        memcpy(peer.name, param->read_rmt_name.rmt_name, nameLen);
+        peer.name[nameLen] = '\0';
+        peer.nameLen = nameLen;
+
+        ESP_LOGI(BT_DEVICE_TAG, "Got remote name: %s", peer.name);
+    } else {
+        ESP_LOGW(BT_DEVICE_TAG, "Remote name request failed. Status: %d", param->read_rmt_name.stat);
+    }
+
+    // Device is still shown to user, so it can be picked by its address
+    if (peer.nameLen == 0) {
+        bdaToStr(peer.address, peer.name, sizeof(peer.name));
+        peer.nameLen = strlen(peer.name);
+    }
+
+    reportDiscoveredPeer(&peer, false);
+    requestNextRemoteName();
+}
+
 static void a2dpCallback(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param) {
-    dispatchTask(&device.btDispatcher, deviceStateHandler, event, param, sizeof(esp_a2d_cb_param_t));
+    A2dpEventRecord record = {};
+
+    switch (event) {
+    case ESP_A2D_CONNECTION_STATE_EVT:
+        record.connectionState = param->conn_stat.state;
+        break;
+
+    case ESP_A2D_AUDIO_CFG_EVT:
+        record.codecConfig = param->audio_cfg.mcc;
+        break;
+
+    case ESP_A2D_MEDIA_CTRL_ACK_EVT:
+        record.mediaCtrlAck.command = param->media_ctrl_stat.cmd;
+        record.mediaCtrlAck.status = param->media_ctrl_stat.status;
+        break;
+
+    case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT:
+        record.sinkDelay = param->a2d_report_delay_value_stat.delay_value;
+        break;
+
+    default:
+        break;
+    }
+
+    dispatchTask(&device.btDispatcher, deviceStateHandler, event, &record, sizeof(record));
 }
 
 static int32_t a2dpDataCallbackWrapper(uint8_t *data, int32_t length) {
@@ -481,7 +1038,27 @@ static int32_t a2dpDataCallbackWrapper(uint8_t *data, int32_t length) {
         return 0;
     }
 
-    return lengthRatio * device.callbacks.audioDataCallback((AudioFrame *) data, length / lengthRatio);
+    // Stack stops asking for data when the link can't keep up
+    int64_t now = esp_timer_get_time();
+
+    if (lastDataCallbackTimeUs != 0 && now - lastDataCallbackTimeUs > kDataStarvationGapUs) {
+        atomic_fetch_add_explicit(&dataStarvations, 1, memory_order_relaxed);
+    }
+
+    lastDataCallbackTimeUs = now;
+
+    if (atomic_load_explicit(&isFirstDataPending, memory_order_relaxed) && atomic_exchange(&isFirstDataPending, false)) {
+        recordMilestone(CONNECTION_MILESTONE_FIRST_DATA);
+    }
+
+    int32_t framesRequested = length / lengthRatio;
+    int32_t framesRead = device.callbacks.audioDataCallback((AudioFrame *) data, framesRequested);
+
+    if (framesRead < framesRequested) {
+        atomic_fetch_add_explicit(&dataStarvations, 1, memory_order_relaxed);
+    }
+
+    return lengthRatio * framesRead;
 }
 
 static void heartBeatTimer(TimerHandle_t timer) {
@@ -489,6 +1066,10 @@ static void heartBeatTimer(TimerHandle_t timer) {
     dispatchTask(&device.btDispatcher, deviceStateHandler, HEART_BEAT_EVENT, NULL, 0);
 }
 
+static void flushPeerCacheTask(uint16_t unused1, void *unused2) {
+    flushPeerCache();
+}
+
 static void deviceStateHandler(uint16_t event, void *param) {
     switch (device.deviceState) {
 
@@ -519,27 +1100,71 @@ static void deviceStateHandler(uint16_t event, void *param) {
 }
 
 static void connectingStateHandler(uint16_t event, void *param) {
-    esp_a2d_cb_param_t *paramPtr = param;
+    A2dpEventRecord *record = param;
 
     switch (event) {
     case ESP_A2D_CONNECTION_STATE_EVT:
-        if (paramPtr->conn_stat.state == ESP_A2D_CONNECTION_STATE_CONNECTED) {
+        if (record->connectionState == ESP_A2D_CONNECTION_STATE_CONNECTED) {
             ESP_LOGI(BT_DEVICE_TAG, "A2DP connected");
-            changeDeviceState(DEVICE_STATE_CONNECTED);
-            changeAudioState(AUDIO_STATE_IDLE);
-        } else if (paramPtr->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
-            ESP_LOGI(BT_DEVICE_TAG, "A2DP disconnected");
-            changeDeviceState(DEVICE_STATE_DISCONNECTED);
+            device.isAutoReconnecting = false;
+            recordMilestone(CONNECTION_MILESTONE_A2DP_CONNECTED);
+            saveLastPeer(&device.selectedPeer);
+            peerCacheConnected(&device.selectedPeer);
+            flushPeerCache();
+
+            if (transitionDeviceState(DEVICE_STATE_CONNECTING, DEVICE_STATE_CONNECTED)) {
+                changeAudioState(AUDIO_STATE_IDLE);
+
+                // Every link starts with the best quality and the max power
+                resetLinkQualityController(&device.linkQuality);
+                recordAdvisedBitpool(device.linkQuality.bitpool);
+
+                resetTxPowerController(&device.txPower);
+                applyTxPower(device.txPower.level, device.txPower.level);
+
+                // New link starts with the default poll interval, so the profile is applied again
+                device.isLowLatencyLink = false;
+
+                beginSnapshotWrite();
+                snapshot.isLowLatencyLink = false;
+                snapshot.isLinkInSniff = false;
+                endSnapshotWrite();
+
+                updateLinkProfile();
+            }
+        } else if (record->connectionState == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
+            handleA2dpDisconnected();
+
+            // Last peer is out of range or turned off, so fall back to the regular discovery
+            if (device.isAutoReconnecting) {
+                ESP_LOGI(BT_DEVICE_TAG, "Unable to reach the last peer. Starting discovery");
+                device.isAutoReconnecting = false;
+
+                DiscoveryConfig discoveryConfig = {
+                    .inquiryDuration = kAutoReconnectDiscoveryDuration,
+                    .maxRenderingDevices = 0,
+                    .stopOnKnownPeer = false,
+                };
+                startDiscovery(&discoveryConfig);
+            }
         }
         break;
 
-    case ESP_A2D_AUDIO_STATE_EVT:
     case ESP_A2D_AUDIO_CFG_EVT:
+        ESP_LOGI(BT_DEVICE_TAG, "A2DP audio config: codec type %d", record->codecConfig.type);
+
+        beginSnapshotWrite();
+        snapshot.codecConfig = record->codecConfig;
+        endSnapshotWrite();
+        break;
+
+    case ESP_A2D_AUDIO_STATE_EVT:
     case ESP_A2D_MEDIA_CTRL_ACK_EVT:
         break;
 
     case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "Delay value: %u * 1/10 ms", paramPtr->a2d_report_delay_value_stat.delay_value);
+        ESP_LOGI(BT_DEVICE_TAG, "Delay value: %u * 1/10 ms", record->sinkDelay);
+        updateSinkLatency(record->sinkDelay);
         break;
 
     default:
@@ -550,13 +1175,12 @@ static void connectingStateHandler(uint16_t event, void *param) {
 }
 
 static void connectedStateHandler(uint16_t event, void *param) {
-    esp_a2d_cb_param_t *paramPtr = param;
+    A2dpEventRecord *record = param;
     
     switch (event) {
     case ESP_A2D_CONNECTION_STATE_EVT:
-        if (paramPtr->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
-            ESP_LOGI(BT_DEVICE_TAG, "A2DP disconnected");
-            changeDeviceState(DEVICE_STATE_DISCONNECTED);
+        if (record->connectionState == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
+            handleA2dpDisconnected();
         }
         break;
 
@@ -569,7 +1193,8 @@ static void connectedStateHandler(uint16_t event, void *param) {
         break;
 
     case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "Delay value: %u * 1/10 ms", paramPtr->a2d_report_delay_value_stat.delay_value);
+        ESP_LOGI(BT_DEVICE_TAG, "Delay value: %u * 1/10 ms", record->sinkDelay);
+        updateSinkLatency(record->sinkDelay);
         break;
 
     default:
@@ -579,13 +1204,12 @@ static void connectedStateHandler(uint16_t event, void *param) {
 }
  
 static void disconnectingStateHandler(uint16_t event, void *param) {
-    esp_a2d_cb_param_t *paramPtr = param;
+    A2dpEventRecord *record = param;
 
     switch (event) {
     case ESP_A2D_CONNECTION_STATE_EVT:
-        if (paramPtr->conn_stat.state == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
-            ESP_LOGI(BT_DEVICE_TAG, "A2DP disconnected");
-            changeDeviceState(DEVICE_STATE_DISCONNECTED);
+        if (record->connectionState == ESP_A2D_CONNECTION_STATE_DISCONNECTED) {
+            handleA2dpDisconnected();
         }
         break;
     case ESP_A2D_AUDIO_STATE_EVT:
@@ -595,7 +1219,7 @@ static void disconnectingStateHandler(uint16_t event, void *param) {
         break;
 
     case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "Delay value: 0x%u * 1/10 ms", paramPtr->a2d_report_delay_value_stat.delay_value);
+        ESP_LOGI(BT_DEVICE_TAG, "Delay value: 0x%u * 1/10 ms", record->sinkDelay);
         break;
 
     default: 
@@ -606,7 +1230,7 @@ static void disconnectingStateHandler(uint16_t event, void *param) {
 }
 
 static void disconnectedStateHandler(uint16_t event, void *param) {
-    esp_a2d_cb_param_t *paramPtr = param;
+    A2dpEventRecord *record = param;
 
     switch (event) {
     case ESP_A2D_CONNECTION_STATE_EVT:
@@ -620,7 +1244,7 @@ static void disconnectedStateHandler(uint16_t event, void *param) {
         break;
 
     case ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "Delay value: %u * 1/10 ms", paramPtr->a2d_report_delay_value_stat.delay_value);
+        ESP_LOGI(BT_DEVICE_TAG, "Delay value: %u * 1/10 ms", record->sinkDelay);
         break;
 
     default:
@@ -629,32 +1253,57 @@ static void disconnectedStateHandler(uint16_t event, void *param) {
     }
 }
 
-static void processAudioState(uint16_t event, esp_a2d_cb_param_t *param) {
+static void processAudioState(uint16_t event, A2dpEventRecord *record) {
+    if (event == ESP_A2D_MEDIA_CTRL_ACK_EVT && record && record->mediaCtrlAck.status == ESP_A2D_MEDIA_CTRL_ACK_SUCCESS) {
+        if (record->mediaCtrlAck.command == ESP_A2D_MEDIA_CTRL_CHECK_SRC_RDY) {
+            recordMilestone(CONNECTION_MILESTONE_SOURCE_READY);
+            atomic_store(&isFirstDataPending, true);
+        } else if (record->mediaCtrlAck.command == ESP_A2D_MEDIA_CTRL_START) {
+            recordMilestone(CONNECTION_MILESTONE_STREAM_STARTED);
+        }
+    }
+
+    // Acks of the other commands (e.g. late or duplicated ones) don't belong to the current transition
+    if (event != ESP_A2D_MEDIA_CTRL_ACK_EVT || !record) {
+        return;
+    }
+
+    bool isSuccess = record->mediaCtrlAck.status == ESP_A2D_MEDIA_CTRL_ACK_SUCCESS;
+
     switch (device.audioState) {
     case AUDIO_STATE_STARTING:
-        if (event == ESP_A2D_MEDIA_CTRL_ACK_EVT) {
-            if (param && param->media_ctrl_stat.status == ESP_A2D_MEDIA_CTRL_ACK_SUCCESS &&
-                param->media_ctrl_stat.cmd == ESP_A2D_MEDIA_CTRL_CHECK_SRC_RDY) {
+        if (record->mediaCtrlAck.command != ESP_A2D_MEDIA_CTRL_CHECK_SRC_RDY) {
+            break;
+        }
 
-                ESP_LOGI(BT_DEVICE_TAG, "A2DP checked. Starting media...");
-                esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_START);
-                changeAudioState(AUDIO_STATE_STARTED);
-            }
+        // Otherwise audio state would stay in STARTING, and neither start nor stop would be accepted
+        if (!isSuccess) {
+            ESP_LOGE(BT_DEVICE_TAG, "A2DP source isn't ready");
+            transitionAudioState(AUDIO_STATE_STARTING, AUDIO_STATE_IDLE);
+            break;
         }
+
+        ESP_LOGI(BT_DEVICE_TAG, "A2DP checked. Starting media...");
+        esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_START);
+        transitionAudioState(AUDIO_STATE_STARTING, AUDIO_STATE_STARTED);
         break;
 
     case AUDIO_STATE_STOPPING:
-        if (event == ESP_A2D_MEDIA_CTRL_ACK_EVT) {
-            if (param->media_ctrl_stat.cmd == ESP_A2D_MEDIA_CTRL_SUSPEND &&
-                param->media_ctrl_stat.status == ESP_A2D_MEDIA_CTRL_ACK_SUCCESS) {
+        if (record->mediaCtrlAck.command != ESP_A2D_MEDIA_CTRL_SUSPEND) {
+            break;
+        }
 
-                ESP_LOGI(BT_DEVICE_TAG, "A2DP suspend successfully");
-                changeAudioState(AUDIO_STATE_IDLE);
-                break;
-            } else {
-                ESP_LOGI(BT_DEVICE_TAG, "A2DP suspending again...");
-                ESP_ERROR_CHECK(esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_SUSPEND));
-            }
+        if (isSuccess) {
+            ESP_LOGI(BT_DEVICE_TAG, "A2DP suspend successfully");
+            transitionAudioState(AUDIO_STATE_STOPPING, AUDIO_STATE_IDLE);
+            break;
+        }
+
+        ESP_LOGI(BT_DEVICE_TAG, "A2DP suspending again...");
+
+        if (esp_a2d_media_ctrl(ESP_A2D_MEDIA_CTRL_SUSPEND) != ESP_OK) {
+            ESP_LOGE(BT_DEVICE_TAG, "Unable to suspend A2DP");
+            transitionAudioState(AUDIO_STATE_STOPPING, AUDIO_STATE_IDLE);
         }
         break;
 
@@ -665,80 +1314,161 @@ static void processAudioState(uint16_t event, esp_a2d_cb_param_t *param) {
     }
 }
 
+// Link may be lost in any audio state, so the audio state is reset too. Otherwise a disconnection during
+// STARTING or STOPPING would leave it stuck until the next connection
+static void handleA2dpDisconnected() {
+    ESP_LOGI(BT_DEVICE_TAG, "A2DP disconnected");
+
+    atomic_store(&isFirstDataPending, false);
+
+    if (device.audioState != AUDIO_STATE_IDLE) {
+        changeAudioState(AUDIO_STATE_IDLE);
+    }
+
+    changeDeviceState(DEVICE_STATE_DISCONNECTED);
+    applyTxPower(device.defaultMinTxPower, device.defaultMaxTxPower);
+}
+
 static void avrcCallback(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t *param) {
     // Callback function for audio/video remote control protocol
     
+    AvrcEventRecord record = {};
+
     switch (event) {
     case ESP_AVRC_CT_CONNECTION_STATE_EVT:
+        record.connection.isConnected = param->conn_stat.connected;
+        memcpy(record.connection.address, param->conn_stat.remote_bda, sizeof(esp_bd_addr_t));
+        break;
+
     case ESP_AVRC_CT_PASSTHROUGH_RSP_EVT:
+        record.passthrough.keyCode = param->psth_rsp.key_code;
+        record.passthrough.keyState = param->psth_rsp.key_state;
+        record.passthrough.responseCode = param->psth_rsp.rsp_code;
+        break;
+
     case ESP_AVRC_CT_METADATA_RSP_EVT:
+        record.metadata.attributeId = param->meta_rsp.attr_id;
+        record.metadata.slot = copyMetadataText(param->meta_rsp.attr_text, param->meta_rsp.attr_length);
+        record.metadata.textLen = record.metadata.slot < 0 ? 0 : strlen(metadataSlab[record.metadata.slot]);
+        break;
+
     case ESP_AVRC_CT_CHANGE_NOTIFY_EVT:
+        record.notification.eventId = param->change_ntf.event_id;
+        record.notification.parameter = param->change_ntf.event_parameter;
+        break;
+
     case ESP_AVRC_CT_REMOTE_FEATURES_EVT:
+        record.features.featureMask = param->rmt_feats.feat_mask;
+        record.features.targetFeatures = param->rmt_feats.tg_feat_flag;
+        break;
+
     case ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT:
+        record.capabilities.count = param->get_rn_caps_rsp.cap_count;
+        record.capabilities.eventBits = param->get_rn_caps_rsp.evt_set.bits;
+        break;
+
     case ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT:
-        dispatchTask(&device.btDispatcher, handleAVRCEvent, event, param, sizeof(esp_avrc_ct_cb_param_t));
+        record.volume = param->set_volume_rsp.volume;
         break;
 
     default:
         ESP_LOGE(BT_DEVICE_TAG, "Invalid AVRC event: %d", event);
-        break;
+        return;
+    }
+
+    if (!dispatchTask(&device.btDispatcher, handleAVRCEvent, event, &record, sizeof(record)) &&
+        event == ESP_AVRC_CT_METADATA_RSP_EVT && record.metadata.slot >= 0) {
+
+        atomic_store(&isMetadataSlotBusy[record.metadata.slot], false);
     }
 }
 
+// Returns slab slot with the copied text or -1 if all slots are busy
+static int8_t copyMetadataText(const uint8_t *text, int textLen) {
+    for (int8_t slot = 0; slot < kMetadataSlabSlots; slot++) {
+        if (atomic_exchange(&isMetadataSlotBusy[slot], true)) {
+            continue;
+        }
+
+        size_t copyLen = 0;
+
+        if (text && textLen > 0) {
+            copyLen = textLen < kMetadataTextMaxLen ? textLen : kMetadataTextMaxLen;
+            memcpy(metadataSlab[slot], text, copyLen);
+        }
+
+        metadataSlab[slot][copyLen] = '\0';
+        return slot;
+    }
+
+    return -1;
+}
+
 static void handleAVRCEvent(uint16_t event, void *param) {
     ESP_LOGD(BT_DEVICE_TAG, "Got AVRCP event: %d", event);
-    esp_avrc_ct_cb_param_t *paramPtr = (esp_avrc_ct_cb_param_t *)(param);
+    AvrcEventRecord *record = param;
 
     switch (event) {
     // Connection state changed
     case ESP_AVRC_CT_CONNECTION_STATE_EVT: {
-        uint8_t *bda = paramPtr->conn_stat.remote_bda;
+        uint8_t *bda = record->connection.address;
         ESP_LOGI(BT_DEVICE_TAG, "AVRC connection state event: state %d, [%02x:%02x:%02x:%02x:%02x:%02x]",
-                 paramPtr->conn_stat.connected, bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
+                 record->connection.isConnected, bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
 
-        if (paramPtr->conn_stat.connected) {
+        if (record->connection.isConnected) {
+            recordMilestone(CONNECTION_MILESTONE_AVRC_CONNECTED);
             esp_avrc_ct_send_get_rn_capabilities_cmd(APP_RC_CT_TL_GET_CAPS);
         } else {
             device.avrcNotificationEventCapabilities.bits = 0;
+            resetVolumeScheduler();
         }
         break;
     }
     // TODO Passthrough responded
     case ESP_AVRC_CT_PASSTHROUGH_RSP_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "AVRC passthrough response: key_code 0x%x, key_state %d, rsp_code %d", paramPtr->psth_rsp.key_code,
-            paramPtr->psth_rsp.key_state, paramPtr->psth_rsp.rsp_code);
+        ESP_LOGI(BT_DEVICE_TAG, "AVRC passthrough response: key_code 0x%x, key_state %d, rsp_code %d", record->passthrough.keyCode,
+            record->passthrough.keyState, record->passthrough.responseCode);
         break;
 
     // Metadata responded
     case ESP_AVRC_CT_METADATA_RSP_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "AVRC metadata response: attribute id 0x%x, %s", paramPtr->meta_rsp.attr_id, paramPtr->meta_rsp.attr_text);
-        free(paramPtr->meta_rsp.attr_text);
+        if (record->metadata.slot < 0) {
+            ESP_LOGW(BT_DEVICE_TAG, "AVRC metadata response dropped: attribute id 0x%x", record->metadata.attributeId);
+            break;
+        }
+
+        ESP_LOGI(BT_DEVICE_TAG, "AVRC metadata response: attribute id 0x%x, %.*s", record->metadata.attributeId,
+                 record->metadata.textLen, metadataSlab[record->metadata.slot]);
+        atomic_store(&isMetadataSlotBusy[record->metadata.slot], false);
         break;
 
     // Notification changed
     case ESP_AVRC_CT_CHANGE_NOTIFY_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "AVRC event notification: %d", paramPtr->change_ntf.event_id);
-        avrcNotificationEvent(paramPtr->change_ntf.event_id, &paramPtr->change_ntf.event_parameter);
+        ESP_LOGI(BT_DEVICE_TAG, "AVRC event notification: %d", record->notification.eventId);
+        avrcNotificationEvent(record->notification.eventId, &record->notification.parameter);
         break;
 
     // Indicate feature of remote device
     case ESP_AVRC_CT_REMOTE_FEATURES_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "AVRC remote features %"PRIx32", TG features %x", paramPtr->rmt_feats.feat_mask, paramPtr->rmt_feats.tg_feat_flag);
+        ESP_LOGI(BT_DEVICE_TAG, "AVRC remote features %"PRIx32", TG features %x", record->features.featureMask, record->features.targetFeatures);
         break;
 
     // Get supported notification events capability of peer device
     case ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "Remote rn_cap: count %d, bitmask 0x%x", paramPtr->get_rn_caps_rsp.cap_count,
-                 paramPtr->get_rn_caps_rsp.evt_set.bits);
+        ESP_LOGI(BT_DEVICE_TAG, "Remote rn_cap: count %d, bitmask 0x%x", record->capabilities.count,
+                 record->capabilities.eventBits);
 
-        device.avrcNotificationEventCapabilities.bits = paramPtr->get_rn_caps_rsp.evt_set.bits;
+        device.avrcNotificationEventCapabilities.bits = record->capabilities.eventBits;
 
         avrcVolumeChanged();
         break;
 
     // Set absolute volume responded
     case ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT:
-        ESP_LOGI(BT_DEVICE_TAG, "Set absolute volume response: volume %d", paramPtr->set_volume_rsp.volume);
+        ESP_LOGI(BT_DEVICE_TAG, "Set absolute volume response: volume %d", record->volume);
+
+        device.isVolumeInFlight = false;
+        sendPendingVolume();
         break;
 
     default:
@@ -761,7 +1491,19 @@ static void avrcNotificationEvent(uint8_t event_id, esp_avrc_rn_param_t *event_p
     // Volume changed locally on target
     case ESP_AVRC_RN_VOLUME_CHANGE:
         ESP_LOGI(BT_DEVICE_TAG, "Volume changed: %d", event_parameter->volume);
-        setVolume(event_parameter->volume);
+
+        // Sink also notifies about the values set by us. While newer values are queued or in flight such echoes are
+        // stale, so sink's volume is adopted only when the scheduler is idle. It's not sent back, otherwise sink and
+        // source would echo it to each other
+        if (isVolumeSchedulerBusy() || event_parameter->volume == device.lastSentAvrcVolume) {
+            ESP_LOGD(BT_DEVICE_TAG, "Volume notification ignored");
+        } else {
+            device.lastSentAvrcVolume = kAvrcNoVolume;
+            updateVolume((event_parameter->volume * 100 + kAvrcMaxVolume / 2) / kAvrcMaxVolume);
+        }
+
+        // Notification is one-shot after it has changed
+        avrcVolumeChanged();
         break;
  
     default:
@@ -769,17 +1511,368 @@ static void avrcNotificationEvent(uint8_t event_id, esp_avrc_rn_param_t *event_p
     }
 }
 
-static void changeDeviceState(DeviceState newState) {
-    device.deviceState = newState;
+static void linkQualityTimer(TimerHandle_t timer) {
+    dispatchTask(&device.btDispatcher, linkQualityHandler, LINK_QUALITY_SAMPLE_EVENT, NULL, 0);
+}
+
+static void linkQualityHandler(uint16_t event, void *param) {
+    if (event == LINK_QUALITY_TX_POWER_CONFIG) {
+        initTxPowerController(&device.txPower, param);
+
+        if (device.deviceState == DEVICE_STATE_CONNECTED) {
+            applyTxPower(device.txPower.level, device.txPower.level);
+        }
+        return;
+    }
+
+    bool isStreaming = device.deviceState == DEVICE_STATE_CONNECTED && device.audioState == AUDIO_STATE_STARTED;
+
+    if (!isStreaming) {
+        // Gaps between the streaming sessions are not starvations
+        lastDataCallbackTimeUs = 0;
+        atomic_store(&dataStarvations, 0);
+    }
+
+    if (device.deviceState != DEVICE_STATE_CONNECTED) {
+        return;
+    }
+
+    switch (event) {
+    case LINK_QUALITY_SAMPLE_EVENT:
+        esp_bt_gap_read_rssi_delta(device.selectedPeer.address);
+        break;
+
+    case LINK_QUALITY_RSSI_EVENT: {
+        int8_t rssiDelta = *(int8_t *)param;
+
+        beginSnapshotWrite();
+        snapshot.rssiDelta = rssiDelta;
+        endSnapshotWrite();
+
+        // Headphones are often close to the transmitter, so there is no need to run at the full power
+        if (updateTxPower(&device.txPower, rssiDelta)) {
+            ESP_LOGI(BT_DEVICE_TAG, "TX power level changed: %u (RSSI delta: %d)", device.txPower.level, rssiDelta);
+            applyTxPower(device.txPower.level, device.txPower.level);
+        }
+
+        if (!isStreaming) {
+            break;
+        }
+
+        uint32_t starvations = atomic_exchange(&dataStarvations, 0);
+
+        // Same format as the host_test traces
+        ESP_LOGD(BT_DEVICE_TAG, "Link quality sample: %d,%" PRIu32, rssiDelta, starvations);
+
+        if (updateLinkQuality(&device.linkQuality, rssiDelta, starvations)) {
+            ESP_LOGI(BT_DEVICE_TAG, "Link quality changed. RSSI delta: %d, starvations: %" PRIu32 ", advised bitpool: %u",
+                     rssiDelta, starvations, device.linkQuality.bitpool);
+            recordAdvisedBitpool(device.linkQuality.bitpool);
+        }
+
+        if (updateAfh(&device.afh, starvations)) {
+            ESP_LOGI(BT_DEVICE_TAG, "AFH auto excluded blocks: 0x%x", device.afh.autoExcludedBlocks);
+            applyAfhChannels();
+        }
+        break;
+    }
+    }
+}
+
+// Telemetry only. Public Bluedroid A2DP source API has no runtime SBC bitpool control, so nothing applies it
+static void recordAdvisedBitpool(uint8_t bitpool) {
+    beginSnapshotWrite();
+    snapshot.advisedBitpool = bitpool;
+    endSnapshotWrite();
+}
+
+static void applyTxPower(esp_power_level_t minLevel, esp_power_level_t maxLevel) {
+    if (esp_bredr_tx_power_set(minLevel, maxLevel) != ESP_OK) {
+        ESP_LOGE(BT_DEVICE_TAG, "Unable to set TX power range [%d; %d]", minLevel, maxLevel);
+        return;
+    }
+
+    beginSnapshotWrite();
+    snapshot.txPowerLevel = maxLevel;
+    endSnapshotWrite();
+}
+
+static void afhHandler(uint16_t event, void *param) {
+    switch (event) {
+    case AFH_EXCLUSION_EVENT:
+        if (!setExcludedAfhChannels(&device.afh, param)) {
+            ESP_LOGE(BT_DEVICE_TAG, "AFH exclusion map leaves less than %d channels", kAfhMinUsedChannels);
+            return;
+        }
+
+        applyAfhChannels();
+        break;
+
+    case AFH_AUTO_MODE_EVENT: {
+        bool isEnabled = *(bool *)param;
+        ESP_LOGI(BT_DEVICE_TAG, "AFH auto mode: %s", isEnabled ? "on" : "off");
+
+        if (enableAutoAfh(&device.afh, isEnabled)) {
+            applyAfhChannels();
+        }
+        break;
+    }
+    }
+}
+
+// Controller still runs its own channel assessment, the map only limits the channels it can pick
+static void applyAfhChannels() {
+    AfhChannelMap usedChannels;
+    getUsedAfhChannels(&device.afh, usedChannels);
+
+    if (esp_bt_gap_set_afh_channels(usedChannels) != ESP_OK) {
+        ESP_LOGE(BT_DEVICE_TAG, "Unable to set AFH channels");
+    }
+}
+
+static void linkProfileHandler(uint16_t event, void *param) {
+    switch (event) {
+    case LINK_PROFILE_MODE_EVENT:
+        device.linkProfileMode = *(LinkProfileMode *)param;
+        updateLinkProfile();
+        break;
+
+    case LINK_PROFILE_AUDIO_EVENT:
+        updateLinkProfile();
+        break;
+
+    case LINK_PROFILE_SNIFF_EVENT: {
+        bool isSniff = *(bool *)param;
+
+        // Bluedroid has no public sniff control, so sniff is only reported. Under the low-latency profile it
+        // defeats the short poll interval, which is worth a note in the log
+        if (isSniff && device.isLowLatencyLink) {
+            ESP_LOGW(BT_DEVICE_TAG, "Link entered sniff mode with the low-latency profile");
+        }
+
+        beginSnapshotWrite();
+        snapshot.isLinkInSniff = isSniff;
+        endSnapshotWrite();
+        break;
+    }
+    }
+}
+
+// Low latency profile shortens the poll interval, so the sink gets media packets with less jitter.
+// Power profile returns the default interval
+static void updateLinkProfile() {
+    if (device.deviceState != DEVICE_STATE_CONNECTED) {
+        return;
+    }
+
+    bool isLowLatency = false;
+
+    switch (device.linkProfileMode) {
+    case LINK_PROFILE_AUTO:
+        isLowLatency = device.audioState != AUDIO_STATE_IDLE;
+        break;
+
+    case LINK_PROFILE_LOW_LATENCY:
+        isLowLatency = true;
+        break;
+
+    case LINK_PROFILE_POWER:
+        isLowLatency = false;
+        break;
+    }
+
+    if (isLowLatency == device.isLowLatencyLink) {
+        return;
+    }
+
+    uint32_t pollInterval = isLowLatency ? kLowLatencyPollSlots : ESP_BT_GAP_TPOLL_DFT;
+
+    if (esp_bt_gap_set_qos(device.selectedPeer.address, pollInterval) != ESP_OK) {
+        ESP_LOGE(BT_DEVICE_TAG, "Unable to set QoS poll interval");
+        return;
+    }
+
+    ESP_LOGI(BT_DEVICE_TAG, "Link profile: %s", isLowLatency ? "low latency" : "power");
+    device.isLowLatencyLink = isLowLatency;
+
+    beginSnapshotWrite();
+    snapshot.isLowLatencyLink = isLowLatency;
+    endSnapshotWrite();
+}
+
+static void volumeTimer(TimerHandle_t timer) {
+    dispatchTask(&device.btDispatcher, volumeSchedulerHandler, VOLUME_TIMER_EVENT, NULL, 0);
+}
+
+static void volumeSchedulerHandler(uint16_t event, void *param) {
+    switch (event) {
+    case VOLUME_REQUESTED_EVENT:
+        // Latest value wins. Intermediate values are never sent
+        device.pendingVolume = *(uint8_t *)param;
+        device.hasPendingVolume = true;
+        atomic_fetch_sub(&device.queuedVolumeRequests, 1);
+        break;
+
+    case VOLUME_TIMER_EVENT:
+        break;
+    }
+
+    sendPendingVolume();
+}
+
+static void sendPendingVolume() {
+    if (!device.hasPendingVolume) {
+        return;
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    TickType_t sinceLastSent = now - device.lastVolumeSentTick;
+
+    // Some sinks don't respond to the absolute volume command at all
+    if (device.isVolumeInFlight && sinceLastSent >= kVolumeResponseTimeoutMs / portTICK_PERIOD_MS) {
+        ESP_LOGW(BT_DEVICE_TAG, "Set absolute volume response timeout");
+        device.isVolumeInFlight = false;
+    }
+
+    if (device.isVolumeInFlight) {
+        xTimerChangePeriod(device.volumeTimer, kVolumeResponseTimeoutMs / portTICK_PERIOD_MS - sinceLastSent, 0);
+        return;
+    }
+
+    if (sinceLastSent < kVolumePacingMs / portTICK_PERIOD_MS) {
+        xTimerChangePeriod(device.volumeTimer, kVolumePacingMs / portTICK_PERIOD_MS - sinceLastSent, 0);
+        return;
+    }
+
+    uint8_t avrcVolume = (device.pendingVolume * kAvrcMaxVolume + 50) / 100;
+
+    if (esp_avrc_ct_send_set_absolute_volume_cmd(APP_RC_CT_TL_SET_ABSOLUTE_VOLUME, avrcVolume) != ESP_OK) {
+        ESP_LOGE(BT_DEVICE_TAG, "Unable to send absolute volume");
+        device.hasPendingVolume = false;
+        return;
+    }
+
+    device.hasPendingVolume = false;
+    device.isVolumeInFlight = true;
+    device.lastVolumeSentTick = now;
+    device.lastSentAvrcVolume = avrcVolume;
+
+    xTimerChangePeriod(device.volumeTimer, kVolumeResponseTimeoutMs / portTICK_PERIOD_MS, 0);
+}
+
+static bool isVolumeSchedulerBusy() {
+    return device.hasPendingVolume || device.isVolumeInFlight || atomic_load(&device.queuedVolumeRequests) > 0;
+}
+
+static void resetVolumeScheduler() {
+    device.hasPendingVolume = false;
+    device.isVolumeInFlight = false;
+    device.lastSentAvrcVolume = kAvrcNoVolume;
+
+    xTimerStop(device.volumeTimer, 0);
+}
+
+// Updates local volume state and notifies user
+static void updateVolume(uint8_t volumeLevel) {
+    beginSnapshotWrite();
+    snapshot.volume = volumeLevel;
+    endSnapshotWrite();
+
+    dispatchTask(&device.eventDispatcher, eventWrapper, VOLUME_CHANGED, &volumeLevel, sizeof(volumeLevel));
+}
+
+void getBtDeviceSnapshot(BluetoothDeviceSnapshot *snapshotCopy) {
+    assert(snapshotCopy);
+
+    uint32_t sequence = 0;
+
+    do {
+        sequence = atomic_load_explicit(&snapshotSequence, memory_order_acquire);
+
+        // Writer is in progress
+        if (sequence & 1) {
+            continue;
+        }
+
+        *snapshotCopy = snapshot;
+        atomic_thread_fence(memory_order_acquire);
+    } while ((sequence & 1) || atomic_load_explicit(&snapshotSequence, memory_order_relaxed) != sequence);
+}
+
+// Writers are serialized with the spinlock. Readers never take it
+static void beginSnapshotWrite() {
+    portENTER_CRITICAL(&snapshotWriteLock);
+    atomic_store_explicit(&snapshotSequence, atomic_load_explicit(&snapshotSequence, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void endSnapshotWrite() {
+    atomic_store_explicit(&snapshotSequence, atomic_load_explicit(&snapshotSequence, memory_order_relaxed) + 1,
+                          memory_order_release);
+    portEXIT_CRITICAL(&snapshotWriteLock);
+}
+
+static void publishStates() {
+    beginSnapshotWrite();
+
+    // Current values are taken instead of the passed ones, so a late writer can't publish an outdated state
+    snapshot.deviceState = device.deviceState;
+    snapshot.audioState = device.audioState;
+    snapshot.selectedPeer = device.selectedPeer;
+
+    endSnapshotWrite();
+}
+
+static void updateSinkLatency(uint16_t latency) {
+    beginSnapshotWrite();
+    snapshot.latency = latency;
+    endSnapshotWrite();
+}
+
+static void notifyDeviceStateChanged(DeviceState newState) {
+    publishStates();
     // TODO reduce memory allocations?
     dispatchTask(&device.eventDispatcher, eventWrapper, DEVICE_EVENT_STATE_CHANGED, &newState, sizeof(newState));
 }
 
-static void changeAudioState(AudioState newState) {
-    device.audioState = newState;
+static void notifyAudioStateChanged(AudioState newState) {
+    updateStreamingPmLock(newState);
+    publishStates();
+    dispatchTask(&device.btDispatcher, linkProfileHandler, LINK_PROFILE_AUDIO_EVENT, NULL, 0);
     dispatchTask(&device.eventDispatcher, eventWrapper, DEVICE_AUDIO_STATE_CHANGED, &newState, sizeof(newState));
 }
 
+// Unconditional transition. Used for events that are valid in any state (e.g. link loss)
+static void changeDeviceState(DeviceState newState) {
+    atomic_store(&device.deviceState, newState);
+    notifyDeviceStateChanged(newState);
+}
+
+static void changeAudioState(AudioState newState) {
+    atomic_store(&device.audioState, newState);
+    notifyAudioStateChanged(newState);
+}
+
+// Transition happens only if nobody has changed the state since it was checked
+static bool transitionDeviceState(DeviceState expectedState, DeviceState newState) {
+    if (!atomic_compare_exchange_strong(&device.deviceState, &expectedState, newState)) {
+        return false;
+    }
+
+    notifyDeviceStateChanged(newState);
+    return true;
+}
+
+static bool transitionAudioState(AudioState expectedState, AudioState newState) {
+    if (!atomic_compare_exchange_strong(&device.audioState, &expectedState, newState)) {
+        return false;
+    }
+
+    notifyAudioStateChanged(newState);
+    return true;
+}
+
 static void eventWrapper(uint16_t eventType, void *param) {
     switch ((BluetoothDeviceEventType)eventType) {
     case DEVICE_EVENT_STATE_CHANGED:
@@ -804,3 +1897,26 @@ static void eventWrapper(uint16_t eventType, void *param) {
         break;
     }
 }
+
+// Audio state may be changed from several tasks, so the lock is taken and released only once per streaming session
+static void updateStreamingPmLock(AudioState audioState) {
+    if (!streamingPmLock) {
+        return;
+    }
+
+    if (audioState != AUDIO_STATE_IDLE) {
+        if (!atomic_exchange(&isStreamingPmLockHeld, true)) {
+            esp_pm_lock_acquire(streamingPmLock);
+        }
+    } else if (atomic_exchange(&isStreamingPmLockHeld, false)) {
+        esp_pm_lock_release(streamingPmLock);
+    }
+}
+
+static void recordMilestone(ConnectionMilestone milestone) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&connectionProfilerLock);
+    recordConnectionMilestone(&connectionProfiler, milestone, now);
+    portEXIT_CRITICAL(&connectionProfilerLock);
+}
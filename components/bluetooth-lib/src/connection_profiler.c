@@ -0,0 +1,125 @@
+#include <assert.h>
+#include <string.h>
+
+#include "connection_profiler.h"
+
+static const char *kMilestoneNames[CONNECTION_MILESTONES_COUNT] = {
+    [CONNECTION_MILESTONE_DISCOVERY_STARTED] = "INQUIRY",
+    [CONNECTION_MILESTONE_FIRST_DEVICE_FOUND] = "FIRST RES",
+    [CONNECTION_MILESTONE_CONNECT_ISSUED] = "PAGE",
+    [CONNECTION_MILESTONE_AVRC_CONNECTED] = "AVRC",
+    [CONNECTION_MILESTONE_A2DP_CONNECTED] = "A2DP",
+    [CONNECTION_MILESTONE_SOURCE_READY] = "SRC RDY",
+    [CONNECTION_MILESTONE_STREAM_STARTED] = "START",
+    [CONNECTION_MILESTONE_FIRST_DATA] = "1ST DATA",
+};
+
+static void beginAttempt(ConnectionProfiler *profiler);
+
+void resetConnectionProfiler(ConnectionProfiler *profiler) {
+    assert(profiler);
+
+    memset(profiler, 0, sizeof(*profiler));
+}
+
+// Every milestone is recorded only once per attempt, so repeated play/stop doesn't overwrite the first timings
+void recordConnectionMilestone(ConnectionProfiler *profiler, ConnectionMilestone milestone, int64_t timeUs) {
+    assert(profiler);
+    assert(milestone < CONNECTION_MILESTONES_COUNT);
+
+    ConnectionAttempt *attempt = &profiler->attempts[profiler->head];
+
+    // Connection without discovery (e.g. to the last peer) starts a new attempt too
+    if (profiler->count == 0 || milestone == CONNECTION_MILESTONE_DISCOVERY_STARTED ||
+        (milestone == CONNECTION_MILESTONE_CONNECT_ISSUED && attempt->timestamps[milestone] != 0)) {
+
+        beginAttempt(profiler);
+        attempt = &profiler->attempts[profiler->head];
+    }
+
+    if (attempt->timestamps[milestone] == 0) {
+        attempt->timestamps[milestone] = timeUs;
+    }
+}
+
+// Copies attempts starting with the newest one. Returns number of copied attempts
+uint8_t copyConnectionAttempts(const ConnectionProfiler *profiler, ConnectionAttempt *attempts, uint8_t maxAttempts) {
+    assert(profiler);
+    assert(attempts);
+
+    uint8_t count = profiler->count < maxAttempts ? profiler->count : maxAttempts;
+
+    for (uint8_t i = 0; i < count; i++) {
+        attempts[i] = profiler->attempts[(profiler->head + kConnectionHistoryLen - i) % kConnectionHistoryLen];
+    }
+
+    return count;
+}
+
+// Time between the milestone and the closest milestone reached before it. Returns -1 if there is no such phase.
+// Milestones may come in a different order (e.g. AVRC may connect after A2DP), so the order is taken from timestamps
+int64_t getConnectionPhaseUs(const ConnectionAttempt *attempt, ConnectionMilestone milestone) {
+    assert(attempt);
+    assert(milestone < CONNECTION_MILESTONES_COUNT);
+
+    int64_t end = attempt->timestamps[milestone];
+    int64_t start = 0;
+
+    if (end == 0) {
+        return -1;
+    }
+
+    for (uint8_t i = 0; i < CONNECTION_MILESTONES_COUNT; i++) {
+        int64_t timestamp = attempt->timestamps[i];
+
+        if (i != milestone && timestamp != 0 && timestamp <= end && timestamp > start) {
+            start = timestamp;
+        }
+    }
+
+    return start == 0 ? -1 : end - start;
+}
+
+// Time between the first and the last reached milestones
+int64_t getConnectionTotalUs(const ConnectionAttempt *attempt) {
+    assert(attempt);
+
+    int64_t first = 0;
+    int64_t last = 0;
+
+    for (uint8_t i = 0; i < CONNECTION_MILESTONES_COUNT; i++) {
+        int64_t timestamp = attempt->timestamps[i];
+
+        if (timestamp == 0) {
+            continue;
+        }
+
+        if (first == 0 || timestamp < first) {
+            first = timestamp;
+        }
+
+        if (timestamp > last) {
+            last = timestamp;
+        }
+    }
+
+    return last - first;
+}
+
+const char *getConnectionMilestoneName(ConnectionMilestone milestone) {
+    assert(milestone < CONNECTION_MILESTONES_COUNT);
+
+    return kMilestoneNames[milestone];
+}
+
+static void beginAttempt(ConnectionProfiler *profiler) {
+    if (profiler->count != 0) {
+        profiler->head = (profiler->head + 1) % kConnectionHistoryLen;
+    }
+
+    if (profiler->count < kConnectionHistoryLen) {
+        profiler->count++;
+    }
+
+    memset(&profiler->attempts[profiler->head], 0, sizeof(ConnectionAttempt));
+}
@@ -0,0 +1,116 @@
+#include <assert.h>
+
+#include "link_quality.h"
+
+void initLinkQualityController(LinkQualityController *controller, const LinkQualityConfig *config) {
+    assert(controller);
+    assert(config);
+    assert(config->minBitpool <= config->maxBitpool);
+
+    controller->config = *config;
+    resetLinkQualityController(controller);
+}
+
+// Link starts with the best quality. It's lowered only if the link can't handle it
+void resetLinkQualityController(LinkQualityController *controller) {
+    assert(controller);
+
+    controller->bitpool = controller->config.maxBitpool;
+    controller->badSamples = 0;
+    controller->goodSamples = 0;
+}
+
+// Returns true if bitpool has been changed
+bool updateLinkQuality(LinkQualityController *controller, int8_t rssiDelta, uint16_t starvations) {
+    assert(controller);
+
+    const LinkQualityConfig *config = &controller->config;
+
+    bool isBadSample = rssiDelta < config->degradeRssiDelta || starvations >= config->degradeStarvations;
+    bool isGoodSample = rssiDelta > config->recoverRssiDelta && starvations == 0;
+
+    // Samples between thresholds keep the current bitpool, but break the sequences (hysteresis)
+    controller->badSamples = isBadSample ? controller->badSamples + 1 : 0;
+    controller->goodSamples = isGoodSample ? controller->goodSamples + 1 : 0;
+
+    if (controller->badSamples >= config->badSamplesToDegrade && controller->bitpool > config->minBitpool) {
+        controller->badSamples = 0;
+
+        if (controller->bitpool - config->minBitpool > config->bitpoolStep) {
+            controller->bitpool -= config->bitpoolStep;
+        } else {
+            controller->bitpool = config->minBitpool;
+        }
+
+        return true;
+    }
+
+    if (controller->goodSamples >= config->goodSamplesToRecover && controller->bitpool < config->maxBitpool) {
+        controller->goodSamples = 0;
+
+        if (config->maxBitpool - controller->bitpool > config->bitpoolStep) {
+            controller->bitpool += config->bitpoolStep;
+        } else {
+            controller->bitpool = config->maxBitpool;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void initTxPowerController(TxPowerController *controller, const TxPowerConfig *config) {
+    assert(controller);
+    assert(config);
+    assert(config->minLevel <= config->maxLevel);
+
+    controller->config = *config;
+    resetTxPowerController(controller);
+}
+
+// New link starts with the max power, so it isn't lost before the first samples
+void resetTxPowerController(TxPowerController *controller) {
+    assert(controller);
+
+    controller->level = controller->config.maxLevel;
+    controller->largeMarginSamples = 0;
+    controller->smallMarginSamples = 0;
+}
+
+// Returns true if power level has been changed
+bool updateTxPower(TxPowerController *controller, int8_t rssiDelta) {
+    assert(controller);
+
+    const TxPowerConfig *config = &controller->config;
+
+    controller->largeMarginSamples = rssiDelta > config->lowerRssiDelta ? controller->largeMarginSamples + 1 : 0;
+    controller->smallMarginSamples = rssiDelta < config->raiseRssiDelta ? controller->smallMarginSamples + 1 : 0;
+
+    // Raising is faster than lowering: losing the link is worse than spending some power
+    if (controller->smallMarginSamples >= config->samplesToRaise && controller->level < config->maxLevel) {
+        controller->smallMarginSamples = 0;
+
+        if (config->maxLevel - controller->level > config->levelStep) {
+            controller->level += config->levelStep;
+        } else {
+            controller->level = config->maxLevel;
+        }
+
+        return true;
+    }
+
+    if (controller->largeMarginSamples >= config->samplesToLower && controller->level > config->minLevel) {
+        controller->largeMarginSamples = 0;
+
+        if (controller->level - config->minLevel > config->levelStep) {
+            controller->level -= config->levelStep;
+        } else {
+            controller->level = config->minLevel;
+        }
+
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,334 @@
+#include <assert.h>
+#include <esp_attr.h>
+#include <esp_err.h>
+#include <esp_log.h>
+#include <freertos/idf_additions.h>
+#include <nvs.h>
+#include <string.h>
+
+#include "peer_storage.h"
+
+#define PEER_STORAGE_TAG "BT_PEER_STORAGE"
+
+static PeerCache peerCache = {};
+static bool peerCacheDirty = false;
+static SemaphoreHandle_t peerCacheMutex = NULL;
+
+// Survives deep sleep, so the wake from standby pages the last peer without reading NVS
+RTC_DATA_ATTR static PeerDeviceData rtcLastPeer;
+RTC_DATA_ATTR static bool hasRtcLastPeer = false;
+
+static bool isSamePeerRecord(const PeerDeviceData *first, const PeerDeviceData *second) {
+    return memcmp(first->address, second->address, sizeof(esp_bd_addr_t)) == 0 && first->nameLen == second->nameLen &&
+           memcmp(first->name, second->name, first->nameLen) == 0;
+}
+
+bool loadLastPeer(PeerDeviceData *peer) {
+    assert(peer);
+
+    if (hasRtcLastPeer) {
+        *peer = rtcLastPeer;
+        return true;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(kPeerStorageNamespace, NVS_READONLY, &handle);
+
+    if (err != ESP_OK) {
+        // Namespace doesn't exist until the first successful connection
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGE(PEER_STORAGE_TAG, "Unable to open peer storage: %s", esp_err_to_name(err));
+        }
+        return false;
+    }
+
+    PeerDeviceData storedPeer = {};
+    size_t storedSize = sizeof(storedPeer);
+
+    err = nvs_get_blob(handle, kLastPeerKey, &storedPeer, &storedSize);
+    nvs_close(handle);
+
+    if (err != ESP_OK || storedSize != sizeof(storedPeer)) {
+        return false;
+    }
+
+    if (storedPeer.nameLen > ESP_BT_GAP_MAX_BDNAME_LEN) {
+        ESP_LOGW(PEER_STORAGE_TAG, "Stored peer record is corrupted");
+        return false;
+    }
+
+    storedPeer.name[storedPeer.nameLen] = '\0';
+    *peer = storedPeer;
+
+    rtcLastPeer = storedPeer;
+    hasRtcLastPeer = true;
+
+    return true;
+}
+
+bool saveLastPeer(const PeerDeviceData *peer) {
+    assert(peer);
+
+    rtcLastPeer = *peer;
+    hasRtcLastPeer = true;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(kPeerStorageNamespace, NVS_READWRITE, &handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(PEER_STORAGE_TAG, "Unable to open peer storage: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    // Only the identity of the peer is stored. RSSI and score change on every connect
+    PeerDeviceData record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.address, peer->address, sizeof(esp_bd_addr_t));
+    record.nameLen = peer->nameLen <= ESP_BT_GAP_MAX_BDNAME_LEN ? peer->nameLen : ESP_BT_GAP_MAX_BDNAME_LEN;
+    memcpy(record.name, peer->name, record.nameLen);
+
+    // Don't wear flash if the same peer connects again
+    PeerDeviceData storedPeer;
+    memset(&storedPeer, 0, sizeof(storedPeer));
+    size_t storedSize = sizeof(storedPeer);
+
+    if (nvs_get_blob(handle, kLastPeerKey, &storedPeer, &storedSize) == ESP_OK && storedSize == sizeof(storedPeer) &&
+        isSamePeerRecord(&storedPeer, &record)) {
+        nvs_close(handle);
+        return true;
+    }
+
+    err = nvs_set_blob(handle, kLastPeerKey, &record, sizeof(record));
+
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+
+    nvs_close(handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(PEER_STORAGE_TAG, "Unable to save last peer: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    return true;
+}
+
+static uint16_t scoreRssi(int8_t rssi) {
+    return rssi > kPeerScoreMinRssi ? rssi - kPeerScoreMinRssi : 0;
+}
+
+static uint16_t saturateCount(uint32_t count) {
+    return count < kPeerScoreMaxCounted ? count : kPeerScoreMaxCounted;
+}
+
+static uint16_t scoreEntry(const PeerCacheEntry *entry) {
+    int32_t score = kPeerScoreCachedBonus + scoreRssi(entry->peer.rssi)
+                  + saturateCount(entry->connectCount) * kPeerScoreConnectWeight
+                  + saturateCount(entry->seenCount) * kPeerScoreSeenWeight
+                  - saturateCount(peerCache.generation - entry->lastSeenGeneration) * kPeerScoreAgePenalty;
+
+    return score > 0 ? score : 0;
+}
+
+static PeerCacheEntry *findEntry(const esp_bd_addr_t address) {
+    for (uint8_t entryIdx = 0; entryIdx < peerCache.entriesCount; entryIdx++) {
+        if (memcmp(peerCache.entries[entryIdx].peer.address, address, sizeof(esp_bd_addr_t)) == 0) {
+            return &peerCache.entries[entryIdx];
+        }
+    }
+
+    return NULL;
+}
+
+// Returns a free entry or the entry with the lowest score if the cache is full
+static PeerCacheEntry *allocateEntry() {
+    if (peerCache.entriesCount < kPeerCacheSize) {
+        return &peerCache.entries[peerCache.entriesCount++];
+    }
+
+    PeerCacheEntry *worstEntry = &peerCache.entries[0];
+
+    for (uint8_t entryIdx = 1; entryIdx < peerCache.entriesCount; entryIdx++) {
+        if (scoreEntry(&peerCache.entries[entryIdx]) < scoreEntry(worstEntry)) {
+            worstEntry = &peerCache.entries[entryIdx];
+        }
+    }
+
+    return worstEntry;
+}
+
+void initPeerCache() {
+    if (!peerCacheMutex) {
+        peerCacheMutex = xSemaphoreCreateMutex();
+    }
+
+    memset(&peerCache, 0, sizeof(peerCache));
+    peerCacheDirty = false;
+
+    nvs_handle_t handle;
+
+    if (nvs_open(kPeerStorageNamespace, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+
+    // Blob is read in place. Task stacks are too small for a copy of the cache
+    size_t storedSize = sizeof(peerCache);
+
+    esp_err_t err = nvs_get_blob(handle, kPeerCacheKey, &peerCache, &storedSize);
+    nvs_close(handle);
+
+    if (err != ESP_OK || storedSize != sizeof(peerCache) || peerCache.entriesCount > kPeerCacheSize) {
+        memset(&peerCache, 0, sizeof(peerCache));
+        return;
+    }
+
+    ESP_LOGI(PEER_STORAGE_TAG, "Loaded %u cached peers", peerCache.entriesCount);
+}
+
+// Blob is written from the cache itself under the lock, so no copy of it is needed on the caller's stack
+bool flushPeerCache() {
+    xSemaphoreTake(peerCacheMutex, portMAX_DELAY);
+
+    if (!peerCacheDirty) {
+        xSemaphoreGive(peerCacheMutex);
+        return true;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(kPeerStorageNamespace, NVS_READWRITE, &handle);
+
+    if (err != ESP_OK) {
+        xSemaphoreGive(peerCacheMutex);
+        ESP_LOGE(PEER_STORAGE_TAG, "Unable to open peer storage: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    err = nvs_set_blob(handle, kPeerCacheKey, &peerCache, sizeof(peerCache));
+
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+
+    nvs_close(handle);
+
+    // Failed write is retried by the next flush
+    peerCacheDirty = err != ESP_OK;
+
+    xSemaphoreGive(peerCacheMutex);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(PEER_STORAGE_TAG, "Unable to save peer cache: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    return true;
+}
+
+void peerCacheNewGeneration() {
+    xSemaphoreTake(peerCacheMutex, portMAX_DELAY);
+
+    // Generation alone doesn't make the cache dirty. It's stored with the next change of the cached peers
+    peerCache.generation++;
+
+    xSemaphoreGive(peerCacheMutex);
+}
+
+// Updates cache entry of the seen peer and sets its score. Returns true if peer is known
+bool peerCacheSeen(PeerDeviceData *peer) {
+    assert(peer);
+
+    xSemaphoreTake(peerCacheMutex, portMAX_DELAY);
+
+    PeerCacheEntry *entry = findEntry(peer->address);
+
+    if (!entry) {
+        // Unknown peers are ranked by signal strength only until they get connected
+        peer->score = scoreRssi(peer->rssi);
+        xSemaphoreGive(peerCacheMutex);
+        return false;
+    }
+
+    if (entry->lastSeenGeneration != peerCache.generation) {
+        entry->lastSeenGeneration = peerCache.generation;
+        entry->seenCount++;
+    }
+
+    // Sightings and RSSI are kept in RAM. Only the changed name or class is worth the flash write
+    if (entry->peer.deviceClass != peer->deviceClass) {
+        entry->peer.deviceClass = peer->deviceClass;
+        peerCacheDirty = true;
+    }
+
+    if (peer->nameLen > 0 &&
+        (entry->peer.nameLen != peer->nameLen || memcmp(entry->peer.name, peer->name, peer->nameLen) != 0)) {
+        memcpy(entry->peer.name, peer->name, sizeof(peer->name));
+        entry->peer.nameLen = peer->nameLen;
+        peerCacheDirty = true;
+    }
+
+    entry->peer.rssi = peer->rssi;
+    entry->peer.score = scoreEntry(entry);
+    *peer = entry->peer;
+
+    xSemaphoreGive(peerCacheMutex);
+
+    return true;
+}
+
+void peerCacheConnected(const PeerDeviceData *peer) {
+    assert(peer);
+
+    xSemaphoreTake(peerCacheMutex, portMAX_DELAY);
+
+    PeerCacheEntry *entry = findEntry(peer->address);
+
+    if (!entry) {
+        entry = allocateEntry();
+        memset(entry, 0, sizeof(*entry));
+    }
+
+    entry->peer = *peer;
+    entry->lastSeenGeneration = peerCache.generation;
+    entry->seenCount++;
+    entry->connectCount++;
+
+    peerCacheDirty = true;
+
+    xSemaphoreGive(peerCacheMutex);
+}
+
+// Copies the cached peer with the given rank, 0 is the best score. Peers with equal scores keep the cache order.
+// Returns false if there are fewer cached peers
+bool peerCacheGetRanked(size_t rank, PeerDeviceData *peer) {
+    assert(peer);
+
+    xSemaphoreTake(peerCacheMutex, portMAX_DELAY);
+
+    uint16_t scores[kPeerCacheSize];
+
+    for (uint8_t entryIdx = 0; entryIdx < peerCache.entriesCount; entryIdx++) {
+        scores[entryIdx] = scoreEntry(&peerCache.entries[entryIdx]);
+    }
+
+    bool isFound = false;
+
+    for (uint8_t entryIdx = 0; entryIdx < peerCache.entriesCount && !isFound; entryIdx++) {
+        size_t entryRank = 0;
+
+        for (uint8_t otherIdx = 0; otherIdx < peerCache.entriesCount; otherIdx++) {
+            entryRank += scores[otherIdx] > scores[entryIdx] ||
+                         (scores[otherIdx] == scores[entryIdx] && otherIdx < entryIdx);
+        }
+
+        if (entryRank == rank) {
+            *peer = peerCache.entries[entryIdx].peer;
+            peer->score = scores[entryIdx];
+            isFound = true;
+        }
+    }
+
+    xSemaphoreGive(peerCacheMutex);
+
+    return isFound;
+}
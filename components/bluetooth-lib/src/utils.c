@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <esp_gap_bt_api.h>
 #include <stdio.h>
 #include <string.h>
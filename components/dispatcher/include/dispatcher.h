@@ -3,6 +3,8 @@
 
 #include <freertos/idf_additions.h>
 
+#define kDispatcherInlineParamSize (24) // Params up to this size are copied into the queue item instead of the heap
+
 typedef struct {
     QueueHandle_t taskQueue;
     TaskHandle_t taskHandle;
@@ -16,8 +16,11 @@
 
 typedef struct {
     uint32_t event;
-    void *param;
+    void *param; // Heap copy of the param. NULL if param is inline or absent
     DispatcherTask callback;
+
+    uint8_t inlineParamLen;
+    uint8_t inlineParam[kDispatcherInlineParamSize] __attribute__((aligned(8)));
 } DispatcherMessage;
 
 static bool sendDispatcherMessage(Dispatcher *dispatcher, DispatcherMessage *message);
@@ -36,7 +39,7 @@ static void taskHandler(void *dispatcherPtr) {
         }
 
         if (message.callback) {
-            message.callback(message.event, message.param);
+            message.callback(message.event, message.inlineParamLen > 0 ? message.inlineParam : message.param);
         }
 
         if (message.param) {
@@ -67,22 +70,36 @@ bool dispatchTask(Dispatcher *dispatcher, DispatcherTask callback, uint16_t even
         .event = event,
         .param = NULL,
         .callback = callback,
+        .inlineParamLen = 0,
     };
 
     if (paramLen == 0) {
         return sendDispatcherMessage(dispatcher, &message);
-    } else if (param && paramLen > 0) {
-        message.param = calloc(1, paramLen);
-
-        if (!message.param) {
-            return false;
-        }
+    } else if (!param) {
+        return false;
+    }
 
-        memcpy(message.param, param, paramLen);
+    // Small params travel inside the queue item, so most of the events don't touch the heap
+    if (paramLen <= kDispatcherInlineParamSize) {
+        message.inlineParamLen = paramLen;
+        memcpy(message.inlineParam, param, paramLen);
         return sendDispatcherMessage(dispatcher, &message);
     }
 
-    return false;
+    message.param = calloc(1, paramLen);
+
+    if (!message.param) {
+        return false;
+    }
+
+    memcpy(message.param, param, paramLen);
+
+    if (!sendDispatcherMessage(dispatcher, &message)) {
+        free(message.param);
+        return false;
+    }
+
+    return true;
 }
 
 void initDispatcher(Dispatcher *dispatcher) {
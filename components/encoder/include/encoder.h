@@ -2,6 +2,7 @@
 #define ENCODER_H_
 
 #include <soc/gpio_num.h>
+#include <driver/pulse_cnt.h>
 #include <freertos/idf_additions.h>
 
 typedef enum {
@@ -29,11 +30,22 @@ typedef struct {
     TaskHandle_t monitoringTask;
 
     TimerHandle_t switchDebounceTimer;
+
+    // Switch interrupt is level triggered, so it can wake the chip from light sleep.
+    // It waits for the low level while released and for the high level while pressed
+    bool isSwitchPressed;
+
+    // Pulse counter backend. Unit is NULL if A and B are decoded from GPIO interrupts
+    pcnt_unit_handle_t pcntUnit;
+    pcnt_channel_handle_t pcntChannels[2];
+    bool hasGlitchFilter;
 } Encoder;
 
 typedef enum {
     ENCODER_AB,
     ENCODER_SWITCH,
+    ENCODER_DETENT_CW,  // Pulse counter reached a detent
+    ENCODER_DETENT_CCW,
 } EncoderPort;
 
 typedef struct {
@@ -43,6 +55,15 @@ typedef struct {
 } ISRParam;
 
 void initEncoder(Encoder *encoder, gpio_num_t aPort, gpio_num_t bPort, gpio_num_t cPort);
+
+// A and B are decoded by the pulse counter in quadrature mode, only detents interrupt the CPU.
+// Unit starts without the glitch filter and holds no power management lock, so DFS and light sleep aren't blocked.
+// The switch still wakes the chip
+void initPcntEncoder(Encoder *encoder, gpio_num_t aPort, gpio_num_t bPort, gpio_num_t cPort);
+
+// Glitch filter holds an APB_FREQ_MAX lock. Enable it only while the APB clock is kept at the max anyway,
+// e.g. while streaming. Does nothing for the GPIO interrupt decoder
+void setPcntGlitchFilter(Encoder *encoder, bool isEnabled);
 void destroyEncoder(Encoder *encoder);
 
 void setEncoderCallback(Encoder *encoder, EncoderCallback callback, void *param);
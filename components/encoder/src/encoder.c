@@ -15,8 +15,15 @@
 #define kTaskPriority (configMAX_PRIORITIES - 2)
 #define kDebounceTimerPeriod (50 / portTICK_PERIOD_MS)
 
+#define kPcntCountsPerDetent (4) // Full quadrature cycle between two detents
+#define kPcntGlitchFilterNs (1000)
+
 static void IRAM_ATTR isrABPortHandler(void *param);
 static void IRAM_ATTR isrSwitchPortHandler(void *param);
+static bool IRAM_ATTR pcntWatchPointHandler(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *eventData, void *param);
+static void initEncoderCommon(Encoder *encoder, gpio_num_t aPort, gpio_num_t bPort, gpio_num_t switchPort);
+static void createPcntUnit(Encoder *encoder, bool hasGlitchFilter);
+static void deletePcntUnit(Encoder *encoder);
 
 static void isrABPortHandler(void *param) {
     Encoder *encoder = param;
@@ -33,26 +40,48 @@ static void isrABPortHandler(void *param) {
 static void isrSwitchPortHandler(void *param) {
     Encoder *encoder = param;
 
-    gpio_isr_handler_remove(encoder->switchPort);
-    xTimerStart(encoder->switchDebounceTimer, 0);
+    // Level interrupt would fire again right away, so it stays disabled until the level is debounced
+    gpio_intr_disable(encoder->switchPort);
+    xTimerStartFromISR(encoder->switchDebounceTimer, NULL);
 }
 
-static void switchPortDebounceCheck(TimerHandle_t timer) {
-    Encoder *encoder = pvTimerGetTimerID(timer);
-
-    if (gpio_get_level(encoder->switchPort) == 1) {
-        ESP_ERROR_CHECK(gpio_isr_handler_add(encoder->switchPort, isrSwitchPortHandler, encoder));
-        return;
-    }
+// Called once per detent. Counter decreases for the clockwise rotation (B leads A)
+static bool pcntWatchPointHandler(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t *eventData, void *param) {
+    Encoder *encoder = param;
+    BaseType_t isTaskWoken = pdFALSE;
 
     ISRParam queueValue = {
-        .port = ENCODER_SWITCH,
+        .port = (eventData->watch_point_value < 0 ? ENCODER_DETENT_CW : ENCODER_DETENT_CCW),
         .aState = 0,
         .bState = 0,
     };
 
-    ESP_ERROR_CHECK(gpio_isr_handler_add(encoder->switchPort, isrSwitchPortHandler, encoder));
-    xQueueSend(encoder->queue, &queueValue, 0);
+    xQueueSendFromISR(encoder->queue, &queueValue, &isTaskWoken);
+
+    return isTaskWoken == pdTRUE;
+}
+
+static void switchPortDebounceCheck(TimerHandle_t timer) {
+    Encoder *encoder = pvTimerGetTimerID(timer);
+    bool isLow = gpio_get_level(encoder->switchPort) == 0;
+
+    if (!encoder->isSwitchPressed && isLow) {
+        encoder->isSwitchPressed = true;
+
+        ISRParam queueValue = {
+            .port = ENCODER_SWITCH,
+            .aState = 0,
+            .bState = 0,
+        };
+
+        xQueueSend(encoder->queue, &queueValue, 0);
+    } else if (encoder->isSwitchPressed && !isLow) {
+        encoder->isSwitchPressed = false;
+    }
+
+    // Wakeup level is the interrupt level
+    ESP_ERROR_CHECK(gpio_wakeup_enable(encoder->switchPort, encoder->isSwitchPressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL));
+    ESP_ERROR_CHECK(gpio_intr_enable(encoder->switchPort));
 }
 
 static void monitoringTask(void* param) {
@@ -71,6 +100,14 @@ static void monitoringTask(void* param) {
             continue;
         }
 
+        if (isrParam.port == ENCODER_DETENT_CW || isrParam.port == ENCODER_DETENT_CCW) {
+            if (encoder->callback) {
+                encoder->callback(isrParam.port == ENCODER_DETENT_CW ? ENCODER_STEP_CW : ENCODER_STEP_CCW,
+                                  encoder->callbackParam);
+            }
+            continue;
+        }
+
         uint8_t currentState = (isrParam.bState << 1) | isrParam.aState;
         uint8_t lastState = encoder->lastStates & 0x3; // lastStates & 0b00000011
 
@@ -102,11 +139,111 @@ void setEncoderCallback(Encoder *encoder, EncoderCallback callback, void *callba
 
 // ISR service should be started
 void initEncoder(Encoder *encoder, gpio_num_t aPort, gpio_num_t bPort, gpio_num_t switchPort) {
+    initEncoderCommon(encoder, aPort, bPort, switchPort);
+
+    gpio_config_t gpioConfig = {
+        .intr_type = GPIO_INTR_ANYEDGE,
+        .mode = GPIO_MODE_INPUT,
+        .pin_bit_mask = (1ull << aPort) | (1ull << bPort),
+        .pull_down_en = 0,
+        .pull_up_en = 0,
+    };
+
+    ESP_ERROR_CHECK(gpio_config(&gpioConfig));
+
+    ESP_ERROR_CHECK(gpio_isr_handler_add(aPort, isrABPortHandler, encoder));
+    ESP_ERROR_CHECK(gpio_isr_handler_add(bPort, isrABPortHandler, encoder));
+}
+
+void initPcntEncoder(Encoder *encoder, gpio_num_t aPort, gpio_num_t bPort, gpio_num_t switchPort) {
+    initEncoderCommon(encoder, aPort, bPort, switchPort);
+    createPcntUnit(encoder, false);
+}
+
+// Unit is rebuilt, because the driver keeps the APB lock of the filter until the unit is deleted.
+// Count is cleared, so it should be called while the knob rests at a detent
+void setPcntGlitchFilter(Encoder *encoder, bool isEnabled) {
     assert(encoder);
 
-    uint64_t aMask = 1ull << aPort;
-    uint64_t bMask = 1ull << bPort;
-    uint64_t switchMask = 1ull << switchPort;
+    if (!encoder->pcntUnit || encoder->hasGlitchFilter == isEnabled) {
+        return;
+    }
+
+    deletePcntUnit(encoder);
+    createPcntUnit(encoder, isEnabled);
+}
+
+static void createPcntUnit(Encoder *encoder, bool hasGlitchFilter) {
+    // Counter is cleared at the limits, so every detent starts from zero
+    pcnt_unit_config_t unitConfig = {
+        .low_limit = -kPcntCountsPerDetent,
+        .high_limit = kPcntCountsPerDetent,
+    };
+
+    ESP_ERROR_CHECK(pcnt_new_unit(&unitConfig, &encoder->pcntUnit));
+
+    if (hasGlitchFilter) {
+        pcnt_glitch_filter_config_t filterConfig = {
+            .max_glitch_ns = kPcntGlitchFilterNs,
+        };
+
+        ESP_ERROR_CHECK(pcnt_unit_set_glitch_filter(encoder->pcntUnit, &filterConfig));
+    }
+
+    encoder->hasGlitchFilter = hasGlitchFilter;
+
+    // Every edge of A and B is counted (x4 decoding). Direction comes from the level of the other port
+    pcnt_chan_config_t aChannelConfig = {
+        .edge_gpio_num = encoder->aPort,
+        .level_gpio_num = encoder->bPort,
+    };
+
+    pcnt_chan_config_t bChannelConfig = {
+        .edge_gpio_num = encoder->bPort,
+        .level_gpio_num = encoder->aPort,
+    };
+
+    ESP_ERROR_CHECK(pcnt_new_channel(encoder->pcntUnit, &aChannelConfig, &encoder->pcntChannels[0]));
+    ESP_ERROR_CHECK(pcnt_new_channel(encoder->pcntUnit, &bChannelConfig, &encoder->pcntChannels[1]));
+
+    ESP_ERROR_CHECK(pcnt_channel_set_edge_action(encoder->pcntChannels[0], PCNT_CHANNEL_EDGE_ACTION_DECREASE,
+                                                 PCNT_CHANNEL_EDGE_ACTION_INCREASE));
+    ESP_ERROR_CHECK(pcnt_channel_set_level_action(encoder->pcntChannels[0], PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                                  PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
+    ESP_ERROR_CHECK(pcnt_channel_set_edge_action(encoder->pcntChannels[1], PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+                                                 PCNT_CHANNEL_EDGE_ACTION_DECREASE));
+    ESP_ERROR_CHECK(pcnt_channel_set_level_action(encoder->pcntChannels[1], PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                                  PCNT_CHANNEL_LEVEL_ACTION_INVERSE));
+
+    ESP_ERROR_CHECK(pcnt_unit_add_watch_point(encoder->pcntUnit, kPcntCountsPerDetent));
+    ESP_ERROR_CHECK(pcnt_unit_add_watch_point(encoder->pcntUnit, -kPcntCountsPerDetent));
+
+    pcnt_event_callbacks_t callbacks = {
+        .on_reach = pcntWatchPointHandler,
+    };
+
+    ESP_ERROR_CHECK(pcnt_unit_register_event_callbacks(encoder->pcntUnit, &callbacks, encoder));
+
+    ESP_ERROR_CHECK(pcnt_unit_enable(encoder->pcntUnit));
+    ESP_ERROR_CHECK(pcnt_unit_clear_count(encoder->pcntUnit));
+    ESP_ERROR_CHECK(pcnt_unit_start(encoder->pcntUnit));
+}
+
+static void deletePcntUnit(Encoder *encoder) {
+    pcnt_unit_stop(encoder->pcntUnit);
+    pcnt_unit_disable(encoder->pcntUnit);
+    pcnt_del_channel(encoder->pcntChannels[0]);
+    pcnt_del_channel(encoder->pcntChannels[1]);
+    pcnt_del_unit(encoder->pcntUnit);
+
+    encoder->pcntUnit = NULL;
+    encoder->pcntChannels[0] = encoder->pcntChannels[1] = NULL;
+    encoder->hasGlitchFilter = false;
+}
+
+// Switch port, monitoring task and everything else that doesn't depend on the A and B backend
+static void initEncoderCommon(Encoder *encoder, gpio_num_t aPort, gpio_num_t bPort, gpio_num_t switchPort) {
+    assert(encoder);
 
     encoder->aPort = aPort;
     encoder->bPort = bPort;
@@ -115,30 +252,36 @@ void initEncoder(Encoder *encoder, gpio_num_t aPort, gpio_num_t bPort, gpio_num_
     encoder->callback = NULL;
     encoder->callbackParam = NULL;
     encoder->lastStates = 0;
+    encoder->isSwitchPressed = false;
+
+    encoder->pcntUnit = NULL;
+    encoder->pcntChannels[0] = encoder->pcntChannels[1] = NULL;
+    encoder->hasGlitchFilter = false;
 
     encoder->switchDebounceTimer = xTimerCreate("Debounce timer", kDebounceTimerPeriod, pdFALSE, encoder, switchPortDebounceCheck);
 
     gpio_config_t gpioConfig = {
         .intr_type = GPIO_INTR_ANYEDGE,
         .mode = GPIO_MODE_INPUT,
-        .pin_bit_mask = aMask | bMask | switchMask,
+        .pin_bit_mask = 1ull << switchPort,
         .pull_down_en = 0,
         .pull_up_en = 0,
     };
 
     ESP_ERROR_CHECK(gpio_config(&gpioConfig));
     ESP_ERROR_CHECK(gpio_pullup_en(switchPort));
+
+    // Switch held during the init (e.g. the one that woke the chip) isn't reported as a press
+    encoder->isSwitchPressed = gpio_get_level(switchPort) == 0;
     
-    gpio_set_intr_type(switchPort, GPIO_INTR_NEGEDGE);
+    ESP_ERROR_CHECK(gpio_wakeup_enable(switchPort, encoder->isSwitchPressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL));
 
     encoder->queue = xQueueCreate(kEncoderQueueSize, sizeof(ISRParam));
     
     ESP_ERROR_CHECK(gpio_install_isr_service(0));
-    ESP_ERROR_CHECK(gpio_isr_handler_add(aPort, isrABPortHandler, encoder));
-    ESP_ERROR_CHECK(gpio_isr_handler_add(bPort, isrABPortHandler, encoder));
     ESP_ERROR_CHECK(gpio_isr_handler_add(switchPort, isrSwitchPortHandler, encoder));
     
-    xTaskCreate(monitoringTask, "EcoderMonitoringTask", kTaskStackDepth, encoder, kTaskPriority, NULL);
+    xTaskCreate(monitoringTask, "EcoderMonitoringTask", kTaskStackDepth, encoder, kTaskPriority, &encoder->monitoringTask);
 }
 
 void destroyEncoder(Encoder *encoder) {
@@ -146,9 +289,15 @@ void destroyEncoder(Encoder *encoder) {
         return;
     }
 
-    gpio_isr_handler_remove(encoder->aPort);
-    gpio_isr_handler_remove(encoder->bPort);
+    if (encoder->pcntUnit) {
+        deletePcntUnit(encoder);
+    } else {
+        gpio_isr_handler_remove(encoder->aPort);
+        gpio_isr_handler_remove(encoder->bPort);
+    }
+
     gpio_isr_handler_remove(encoder->switchPort);
+    gpio_wakeup_disable(encoder->switchPort);
 
     encoder->aPort = encoder->bPort = encoder->switchPort = -1;
 
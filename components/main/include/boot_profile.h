@@ -0,0 +1,30 @@
+#ifndef BOOT_PROFILE_H_
+#define BOOT_PROFILE_H_
+
+#include <stdint.h>
+
+typedef enum {
+    BOOT_STAGE_APP_START,
+    BOOT_STAGE_DISPLAY_READY,
+    BOOT_STAGE_AUDIO_READY,
+    BOOT_STAGE_BT_STACK_READY,
+    BOOT_STAGE_BT_STARTED,
+    BOOT_STAGE_ENCODER_READY, // Encoder events reach the menu. Device is usable from here
+    BOOT_STAGES_COUNT,
+} BootStage;
+
+#define kBootStageReady (BOOT_STAGE_ENCODER_READY)
+
+void initBootProfile();
+
+// Stage timestamps are esp_timer_get_time() values: microseconds since the esp_timer init in the startup code,
+// which runs before app_main. Waiting on a stage is how boot tasks depend on each other
+void recordBootStage(BootStage stage);
+void waitBootStage(BootStage stage);
+
+int64_t getBootStageUs(BootStage stage);
+int64_t getBootTimeToReadyUs();
+
+void dumpBootProfile();
+
+#endif
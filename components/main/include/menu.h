@@ -1,6 +1,8 @@
 #ifndef MENU_H_
 #define MENU_H_
 
+#include <inttypes.h>
+
 #include "bt_lib.h"
 #include "display.h"
 #include "encoder.h"
@@ -12,12 +14,16 @@ typedef enum {
     MENU_DISCOVERY_IN_PROGRESS,
     MENU_CONNECTION,
     MENU_DISCONNECTION,
+    MENU_CONNECTION_TIMINGS, // Debug page with phase durations of the last connection attempt
+    MENU_SPECTRUM,           // Live spectrum of the input
 } MenuState;
 
 typedef enum {
     AUDIO_MENU_PLAY_BUTTON = 0,
     AUDIO_MENU_VOLUME = 1,
-    AUDIO_MENU_BACK_BUTTON = 2,
+    AUDIO_MENU_SPECTRUM_BUTTON = 2,
+    AUDIO_MENU_TIMINGS_BUTTON = 3,
+    AUDIO_MENU_BACK_BUTTON = 4,
 } AudioMenuEntries;
 
 #define kMaxPeerDevices (32)
@@ -29,18 +35,36 @@ typedef enum {
 #define kPickingArrowLen (sizeof(kPickingArrow) - 1)
 #define kPickingArrowWidth (16)
 
+#define kMarqueeGapWidth (12) // Blank columns between the end and the beginning of a scrolled name
+#define kNoMarqueeItem (SIZE_MAX)
+
 #define kRestartText "RESTART DISCOVERY"
 #define kRestartTextLen (sizeof(kRestartText) - 1)
 
 #define kDiscoveryText "SCANNING..."
+#define kDiscoveryTextLen (sizeof(kDiscoveryText) - 1)
 #define kStartupText1 "PRESS BUTTON"
 #define kStartupText2 "TO START"
 #define kConnectingText "CONNECTING..."
 #define kDisconnectingText "DISCONNECTIG..."
 
+#define kPlayText "PLAY"
+#define kStopText "STOP"
+#define kVolumeFormat "Volume: %" PRId32 "%%"
+#define kSpectrumText "SPECTRUM"
+#define kTimingsText "TIMINGS"
+#define kBackText "BACK"
+
 #define kDiscoveryDuration (5)
+#define kDiscoveryMaxDevices (8) // Inquiry is stopped early after finding this many devices
+
+#define kAudioControlMenuEntries (5)
+
+#define kTimingsMenuEntries (CONNECTION_MILESTONES_COUNT) // Total time and phases ending with every milestone but the first one
+#define kNoTimingsText "NO CONNECTIONS"
+#define kTimingsValueColumn (72)
 
-#define kAudioControlMenuEntries (3)
+#define kSpectrumBarGap (1) // Blank columns between the spectrum bars
 
 #define kDefaultAudioLevel (25)
 #define kAudioStep (5)
@@ -49,6 +73,7 @@ void volumeChangedCallback(uint8_t newVolumeLevel);
 void encoderCallback(EncoderEvent event, void *param);
 void handleDeviceDiscoveredEvent(PeerDeviceData *peer);
 void handleDeviceStateChangedEvent(DeviceState newState);
+void spectrumFrameCallback(const uint8_t *levels, uint8_t bandsCount);
 
 void setMenuDisplay(DisplayDevice *display);
 
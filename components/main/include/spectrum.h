@@ -0,0 +1,35 @@
+#ifndef SPECTRUM_H_
+#define SPECTRUM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bt_lib.h"
+#include "spectrum_fft.h"
+
+#define kSpectrumMaxLevel (64)
+#define kSpectrumFramePeriodUs (40000)  // 25 frames per second
+#define kSpectrumFloorLog2Q2 (24)       // Band power shown as an empty bar
+#define kSpectrumRangeLog2Q2 (88)       // Band power range from empty to full bar
+#define kSpectrumLevelDecay (4)         // Bars fall by this many levels every frame
+#define kSpectrumReportFrames (250)     // Cycle budget is logged every this many frames
+
+// Called from the analyzer task with levels in [0, kSpectrumMaxLevel]
+typedef void (*SpectrumFrameCallback)(const uint8_t *levels, uint8_t bandsCount);
+
+typedef struct {
+    uint32_t computedFrames;
+    uint32_t droppedSamples; // Samples came while the previous block was still analyzed
+    uint32_t lastCycles;
+    uint32_t maxCycles;
+} SpectrumStats;
+
+void initSpectrum(SpectrumFrameCallback callback);
+void setSpectrumEnabled(bool isEnabled);
+
+// Called from the audio data path. Never blocks, samples are dropped if the analyzer is busy
+void feedSpectrumSamples(const AudioFrame *frames, int32_t len);
+
+void getSpectrumStats(SpectrumStats *stats);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef SPECTRUM_FFT_H_
+#define SPECTRUM_FFT_H_
+
+#include <stdint.h>
+
+// Spectrum math doesn't depend on ESP-IDF, so it can be built on host and fed with recorded audio
+
+#define kSpectrumFftSize (256)                    // Real samples in a block, power of two
+#define kSpectrumHalfSize (kSpectrumFftSize / 2)  // Complex FFT size and count of the frequency bins
+#define kSpectrumBandsCount (16)
+
+typedef struct {
+    int16_t re;
+    int16_t im;
+} ComplexQ15;
+
+typedef struct {
+    int16_t window[kSpectrumFftSize];       // Hann window, Q15
+    int16_t twiddleCos[kSpectrumHalfSize];  // cos(2 * pi * k / N), Q15
+    int16_t twiddleSin[kSpectrumHalfSize];  // sin(2 * pi * k / N), Q15
+    uint8_t bandEdges[kSpectrumBandsCount + 1]; // First bin of every band, logarithmic spacing
+
+    ComplexQ15 scratch[kSpectrumHalfSize];
+} SpectrumFft;
+
+void initSpectrumFft(SpectrumFft *fft);
+
+// Band power is returned as log2 with 2 fractional bits (1.5 dB steps)
+void computeSpectrumBands(SpectrumFft *fft, const int16_t *samples, uint8_t *bandPowers);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef STANDBY_H_
+#define STANDBY_H_
+
+#include <stdbool.h>
+#include <soc/gpio_num.h>
+
+#include "display.h"
+
+#define kStandbyTimeoutMs (60000) // Inactivity on the idle screens before the deep sleep
+
+void initStandby(DisplayDevice *display, gpio_num_t wakePort);
+
+// Standby timer runs only while armed. Menu arms it on the screens without an active connection
+void armStandbyTimer();
+void disarmStandbyTimer();
+void resetStandbyTimer();
+
+bool isWakeFromStandby();
+
+#endif
@@ -0,0 +1,62 @@
+#include <assert.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <inttypes.h>
+
+#include "boot_profile.h"
+#include "freertos/idf_additions.h"
+#include "portmacro.h"
+
+#define BOOT_PROFILE_TAG "BOOT"
+
+static EventGroupHandle_t bootStages = NULL;
+static int64_t stageTimestamps[BOOT_STAGES_COUNT] = {};
+
+static const char *kBootStageNames[BOOT_STAGES_COUNT] = {
+    [BOOT_STAGE_APP_START] = "app start",
+    [BOOT_STAGE_DISPLAY_READY] = "display",
+    [BOOT_STAGE_AUDIO_READY] = "audio",
+    [BOOT_STAGE_BT_STACK_READY] = "bt stack",
+    [BOOT_STAGE_BT_STARTED] = "bt start",
+    [BOOT_STAGE_ENCODER_READY] = "encoder",
+};
+
+_Static_assert(BOOT_STAGES_COUNT <= 24, "Event group has 24 usable bits");
+
+void initBootProfile() {
+    bootStages = xEventGroupCreate();
+    assert(bootStages);
+
+    recordBootStage(BOOT_STAGE_APP_START);
+}
+
+void recordBootStage(BootStage stage) {
+    assert(stage < BOOT_STAGES_COUNT);
+
+    stageTimestamps[stage] = esp_timer_get_time();
+    xEventGroupSetBits(bootStages, 1 << stage);
+}
+
+void waitBootStage(BootStage stage) {
+    assert(stage < BOOT_STAGES_COUNT);
+
+    xEventGroupWaitBits(bootStages, 1 << stage, pdFALSE, pdTRUE, portMAX_DELAY);
+}
+
+int64_t getBootStageUs(BootStage stage) {
+    assert(stage < BOOT_STAGES_COUNT);
+
+    return stageTimestamps[stage];
+}
+
+int64_t getBootTimeToReadyUs() {
+    return stageTimestamps[kBootStageReady];
+}
+
+void dumpBootProfile() {
+    for (uint8_t stage = 0; stage < BOOT_STAGES_COUNT; stage++) {
+        ESP_LOGI(BOOT_PROFILE_TAG, "%-10s %" PRId64 "us", kBootStageNames[stage], stageTimestamps[stage]);
+    }
+
+    ESP_LOGI(BOOT_PROFILE_TAG, "Time to ready: %" PRId64 "us", getBootTimeToReadyUs());
+}
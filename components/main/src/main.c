@@ -2,6 +2,8 @@
 #include <esp_adc/adc_continuous.h>
 #include <soc/soc_caps.h>
 #include <esp_log.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
 #include <hal/adc_types.h>
 #include <driver/i2c_master.h>
 #include <driver/gpio.h>
@@ -10,17 +12,22 @@
 #include <string.h>
 
 #include "audio_stream.h"
+#include "boot_profile.h"
 #include "bt_lib.h"
 #include "display.h"
 #include "encoder.h"
 #include "portmacro.h"
 #include "menu.h"
+#include "spectrum.h"
+#include "standby.h"
 #include "stdbool.h"
 
 #define kMaxFramesRequested (256)
 #define kChannelsCount (2)
 #define kChannelFrameSize (sizeof(uint32_t))
 
+#define MAIN_TAG "MAIN"
+
 #define kDisplayAddress (0x3c) // 0x3c for 32-pixels tall displays, 0x3d for others
 
 #define kI2CMasterScl (GPIO_NUM_5)
@@ -32,12 +39,49 @@
 
 #define kAudioFrequency (44100)
 
+#define kBtInitTaskStackDepth (4096)
+#define kBtInitTaskPriority (tskIDLE_PRIORITY + 1)
+
+#define kPmMaxCpuFreqMhz (240)
+#define kPmMinCpuFreqMhz (40) // XTAL frequency. Locks of the drivers and of the streaming path raise it when needed
+
 static uint8_t *audioDataBuffer = NULL;
 static InputAudioStream stream = {};
+static Encoder encoder = {};
 
 static int32_t audioDataCallback(AudioFrame *data, int32_t len);
-
+static void audioStateChangedCallback(AudioState newState);
+static void btInitTask(void *param);
+
+static BluetoothDeviceCallbacks btCallbacks = {
+    .audioDataCallback = audioDataCallback,
+    .deviceStateChangedCallback = handleDeviceStateChangedEvent,
+    .audioStateChangedCallback = audioStateChangedCallback,
+    .deviceDiscoveredCallback = handleDeviceDiscoveredEvent,
+    .volumeChangedCallback = volumeChangedCallback,
+};
+
+// Boot stages:
+// app start -> bt stack -------------------+-> bt start -> encoder callback (ready)
+// app start -> display -> encoder -> audio -+
 void app_main() {
+    initBootProfile();
+
+    // Init power management. Chip runs at the max frequency only while somebody holds a lock
+    esp_pm_config_t pmConfig = {
+        .max_freq_mhz = kPmMaxCpuFreqMhz,
+        .min_freq_mhz = kPmMinCpuFreqMhz,
+        .light_sleep_enable = true,
+    };
+
+    ESP_ERROR_CHECK(esp_pm_configure(&pmConfig));
+
+    // Encoder switch wakes the chip from light sleep
+    ESP_ERROR_CHECK(esp_sleep_enable_gpio_wakeup());
+
+    // NVS, controller and Bluedroid bring-up is the slowest stage. It runs while the display and I2S are set up
+    xTaskCreate(btInitTask, "BtInitTask", kBtInitTaskStackDepth, &btCallbacks, kBtInitTaskPriority, NULL);
+
     // Init display
     i2c_master_bus_config_t masterBusConfig = {
         .clk_source = I2C_CLK_SRC_DEFAULT,
@@ -62,12 +106,15 @@ void app_main() {
 
     DisplayDevice display;
     initDisplay(&display, &displayI2C, DISPLAY_128_32);
+
+    // Encoder switch wakes the chip from the standby
+    initStandby(&display, kEncoderCPort);
     setMenuDisplay(&display);
+    recordBootStage(BOOT_STAGE_DISPLAY_READY);
 
-    // Init encoder
-    Encoder encoder;
-    initEncoder(&encoder, kEncoderAPort, kEncoderBPort, kEncoderCPort);
-    setEncoderCallback(&encoder, encoderCallback, NULL);
+    // Encoder is set up while bluetooth is starting. Its events use bluetooth device, so they are dropped until
+    // the callback is set. Switch that woke the chip is still held, but it isn't reported
+    initPcntEncoder(&encoder, kEncoderAPort, kEncoderBPort, kEncoderCPort);
 
     // Init I2S
     InputAudioStreamConfig audioStreamConfig = {
@@ -81,17 +128,19 @@ void app_main() {
     
     audioDataBuffer = calloc(kMaxFramesRequested * kChannelFrameSize * kChannelsCount, sizeof(uint8_t));
     initInputAudioStream(&stream, &audioStreamConfig);
+    initSpectrum(spectrumFrameCallback);
+    recordBootStage(BOOT_STAGE_AUDIO_READY);
 
-    // Init bluetooth
-    BluetoothDeviceCallbacks btCallbacks = {
-        .audioDataCallback = audioDataCallback,
-        .deviceStateChangedCallback = handleDeviceStateChangedEvent,
-        .audioStateChangedCallback = NULL,
-        .deviceDiscoveredCallback = handleDeviceDiscoveredEvent,
-        .volumeChangedCallback = volumeChangedCallback,
-    };
+    // Bluetooth callbacks draw the menu and start the audio stream
+    waitBootStage(BOOT_STAGE_BT_STACK_READY);
+    startBtDevice();
+    recordBootStage(BOOT_STAGE_BT_STARTED);
+
+    setEncoderCallback(&encoder, encoderCallback, NULL);
+    recordBootStage(BOOT_STAGE_ENCODER_READY);
 
-    initBtDevice(&btCallbacks);
+    ESP_LOGI(MAIN_TAG, "Boot from %s", isWakeFromStandby() ? "standby" : "reset");
+    dumpBootProfile();
 
     while (true) {
         vTaskDelay(portMAX_DELAY);
@@ -103,6 +152,33 @@ void app_main() {
     destroyI2CBus(&screenBus);
 }
 
+static void btInitTask(void *param) {
+    initBtDevice(param);
+    recordBootStage(BOOT_STAGE_BT_STACK_READY);
+
+    vTaskDelete(NULL);
+}
+
+// I2S capture runs only while streaming, so it doesn't block frequency scaling and light sleep the rest of the time.
+// Streaming keeps the CPU, and so the APB clock, at the max frequency, so the encoder glitch filter costs nothing then
+static void audioStateChangedCallback(AudioState newState) {
+    switch (newState) {
+    case AUDIO_STATE_STARTING:
+    case AUDIO_STATE_STARTED:
+        startInputAudioStream(&stream);
+        setPcntGlitchFilter(&encoder, true);
+        break;
+
+    case AUDIO_STATE_IDLE:
+        stopInputAudioStream(&stream);
+        setPcntGlitchFilter(&encoder, false);
+        break;
+
+    case AUDIO_STATE_STOPPING:
+        break;
+    }
+}
+
 // 44.1kHz, dual channel (16 bits every frame channel => 32 bits every frame)
 static int32_t audioDataCallback(AudioFrame *data, int32_t len) {
 
@@ -115,10 +191,9 @@ static int32_t audioDataCallback(AudioFrame *data, int32_t len) {
     for (size_t frameIdx = 0; frameIdx < len; ++frameIdx) {
         data[frameIdx].channel1 = readData[frameIdx * 4 + 1];
         data[frameIdx].channel2 = readData[frameIdx * 4 + 3];
-
     }
 
-    ESP_LOGI("AAA", "%" PRIu16 "\n", data[0].channel1);
+    feedSpectrumSamples(data, len);
 
     return len;
 }
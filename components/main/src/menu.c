@@ -1,3 +1,5 @@
+#include <assert.h>
+#include <esp_attr.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,6 +8,9 @@
 #include "bt_lib.h"
 #include "display.h"
 #include "encoder.h"
+#include "spectrum.h"
+#include "standby.h"
+#include "widget.h"
 
 static MenuState currentMenuState = MENU_STARTUP;
 
@@ -13,16 +18,50 @@ static PeerDeviceData peerDevices[kMaxPeerDevices] = {};
 static size_t peerDevicesCount = 0;
 
 static size_t pickedMenuItem = 0;
+static bool isDiscovering = false;
 
 static bool isPlayingAudio = false;
-static uint8_t volumeLevel = kDefaultAudioLevel;
+RTC_DATA_ATTR static uint8_t volumeLevel = kDefaultAudioLevel; // Kept through the standby
 static bool isFocusedOnAudio = false;
 
 static DisplayDevice *display = NULL;
 
+// Long picked name is shown a part at a time. The controller rotates the part, the timer moves to the next one
+// after every rotation
+static TimerHandle_t marqueeTimer = NULL;
+static size_t marqueeItem = kNoMarqueeItem;
+static uint8_t marqueeNameOffset = 0;
+
+// Audio control screen is retained. Items are in AudioMenuEntries order
+static Widget playButton;
+static Widget volumeValue;
+static Widget spectrumButton;
+static Widget timingsButton;
+static Widget backButton;
+static Widget audioMenuList;
+static Widget audioMenuArrow;
+
+static Widget *audioMenuItems[kAudioControlMenuEntries] = {
+    [AUDIO_MENU_PLAY_BUTTON] = &playButton,
+    [AUDIO_MENU_VOLUME] = &volumeValue,
+    [AUDIO_MENU_SPECTRUM_BUTTON] = &spectrumButton,
+    [AUDIO_MENU_TIMINGS_BUTTON] = &timingsButton,
+    [AUDIO_MENU_BACK_BUTTON] = &backButton,
+};
+
+static Widget *shownScreen = NULL; // Root widget of the shown screen, NULL for screens drawn directly
+
+static const DiscoveryConfig kDiscoveryConfig = {
+    .inquiryDuration = kDiscoveryDuration,
+    .maxRenderingDevices = kDiscoveryMaxDevices,
+    .stopOnKnownPeer = true,
+};
+
 static void encoderDeviceSelectionMenu(EncoderEvent event);
 static void encoderAudioControlMenu(EncoderEvent event);
 static void encoderStartupMenu(EncoderEvent event);
+static void encoderConnectionTimingsMenu(EncoderEvent event);
+static void encoderSpectrumMenu(EncoderEvent event);
 
 static void drawTextMenu(const char *line1, const char *line2, const char *line3, const char *line4);
 static void drawDeviceSelectionMenu();
@@ -31,48 +70,97 @@ static void drawAudioControlMenu();
 static void drawStartupMenu();
 static void drawConnectionMenu();
 static void drawDisconnectionMenu();
+static void drawConnectionTimingsMenu();
+static void drawSpectrumMenu(const uint8_t *levels, uint8_t bandsCount);
+static void initAudioControlWidgets();
+
+static void marqueeTimerCallback(TimerHandle_t timer);
+static void stopNameMarquee();
+static uint8_t countFittingChars(const char *string, uint8_t len, uint16_t width);
 
 void setMenuDisplay(DisplayDevice *newDisplay) {
     display = newDisplay;
+
+    marqueeTimer = xTimerCreate("MarqueeTimer", getMarqueeRotationMs(display) / portTICK_PERIOD_MS, pdTRUE, NULL,
+                                marqueeTimerCallback);
+    assert(marqueeTimer);
+
+    initAudioControlWidgets();
     drawStartupMenu();
+    armStandbyTimer();
 }
 
 void volumeChangedCallback(uint8_t newVolumeLevel) {
     volumeLevel = newVolumeLevel;
-    drawAudioControlMenu();
+
+    if (currentMenuState == MENU_AUDIO_CONTROL) {
+        drawAudioControlMenu();
+    }
 }
 
 void handleDeviceDiscoveredEvent(PeerDeviceData *peer) {
     assert(peer);
 
-    if (peerDevicesCount >= kMaxPeerDevices) {
-        return;
-    }
-
     for (uint8_t deviceIdx = 0; deviceIdx < peerDevicesCount; deviceIdx++) {
         if (memcmp(peer->address, peerDevices[deviceIdx].address, sizeof(esp_bd_addr_t)) == 0) {
+            // Peer is already shown (e.g. from cache). Keep its position and refresh the data
+            peerDevices[deviceIdx] = *peer;
             return;
         }
     }
 
-    peerDevices[peerDevicesCount] = *peer;
+    if (peerDevicesCount >= kMaxPeerDevices) {
+        return;
+    }
+
+    size_t insertIdx = peerDevicesCount;
+    while (insertIdx > 0 && peerDevices[insertIdx - 1].score < peer->score) {
+        peerDevices[insertIdx] = peerDevices[insertIdx - 1];
+        insertIdx--;
+    }
+
+    peerDevices[insertIdx] = *peer;
     peerDevicesCount++;
+
+    // Don't move the picked item from under the user
+    if (insertIdx <= pickedMenuItem && peerDevicesCount > 1) {
+        pickedMenuItem++;
+    }
+
+    // Peers are available for picking while inquiry is still running
+    if (currentMenuState == MENU_DISCOVERY_IN_PROGRESS || currentMenuState == MENU_DEVICE_SELECTION) {
+        currentMenuState = MENU_DEVICE_SELECTION;
+        drawDeviceSelectionMenu();
+    }
 }
 
 void handleDeviceStateChangedEvent(DeviceState newState) {
+    // Every state change leaves the spectrum screen
+    setSpectrumEnabled(false);
+
+    // Standby is allowed only while nothing is connected or in progress
+    if (newState == DEVICE_STATE_IDLE || newState == DEVICE_STATE_DISCONNECTED) {
+        armStandbyTimer();
+    } else {
+        disarmStandbyTimer();
+    }
+
     switch (newState) {
 
     case DEVICE_STATE_IDLE:
+        isDiscovering = false;
         currentMenuState = MENU_DEVICE_SELECTION;
         drawDeviceSelectionMenu();
         break;
     case DEVICE_STATE_DISCOVERING:
         currentMenuState = MENU_DISCOVERY_IN_PROGRESS;
+        isDiscovering = true;
         peerDevicesCount = 0;
         pickedMenuItem = 0;
         drawDiscoveryMenu();
         break;
     case DEVICE_STATE_CONNECTING:
+        isDiscovering = false;
         currentMenuState = MENU_CONNECTION;
         drawConnectionMenu();
         break;
@@ -81,7 +169,7 @@ void handleDeviceStateChangedEvent(DeviceState newState) {
         pickedMenuItem = 0;
         isPlayingAudio = false;
         isFocusedOnAudio = false;
-        setVolume(kDefaultAudioLevel);
+        setVolume(volumeLevel);
         break;
     case DEVICE_STATE_DISCONNECTING:
         currentMenuState = MENU_DISCONNECTION;
@@ -95,6 +183,8 @@ void handleDeviceStateChangedEvent(DeviceState newState) {
 }
 
 void encoderCallback(EncoderEvent event, void *param) {
+    resetStandbyTimer();
+
     switch (currentMenuState) {
     case MENU_DEVICE_SELECTION:
         encoderDeviceSelectionMenu(event);
@@ -105,6 +195,12 @@ void encoderCallback(EncoderEvent event, void *param) {
     case MENU_STARTUP:
         encoderStartupMenu(event);
         break;
+    case MENU_CONNECTION_TIMINGS:
+        encoderConnectionTimingsMenu(event);
+        break;
+    case MENU_SPECTRUM:
+        encoderSpectrumMenu(event);
+        break;
     case MENU_CONNECTION:
     case MENU_DISCONNECTION:
     case MENU_DISCOVERY_IN_PROGRESS:
@@ -130,17 +226,22 @@ static void encoderDeviceSelectionMenu(EncoderEvent event) {
         if (pickedMenuItem < peerDevicesCount) {
             connectToDevice(&peerDevices[pickedMenuItem]);
         } else {
-            startDiscovery(kDiscoveryDuration);
+            startDiscovery(&kDiscoveryConfig);
         }
         break;
     }
 }
 
 static void encoderAudioControlMenu(EncoderEvent event) {
+    // Volume change event may not be delivered yet if encoder is rotated fast, so the actual level is taken
+    BluetoothDeviceSnapshot btState;
+    getBtDeviceSnapshot(&btState);
+    uint8_t currentVolume = btState.volume;
+
     switch (event) {
     case ENCODER_STEP_CW:
         if (isFocusedOnAudio) {
-            setVolume((volumeLevel + kAudioStep) % 101);
+            setVolume((currentVolume + kAudioStep) % 101);
         } else if (pickedMenuItem + 1 < kAudioControlMenuEntries) {
             pickedMenuItem++;
             drawAudioControlMenu();
@@ -148,10 +249,10 @@ static void encoderAudioControlMenu(EncoderEvent event) {
         break;
     case ENCODER_STEP_CCW:
         if (isFocusedOnAudio) {
-            if (volumeLevel < kAudioStep) {
+            if (currentVolume < kAudioStep) {
                 setVolume(0);
             } else {
-                setVolume(volumeLevel - kAudioStep);
+                setVolume(currentVolume - kAudioStep);
             }
         }else if (pickedMenuItem > 0) {
             pickedMenuItem--;
@@ -173,6 +274,16 @@ static void encoderAudioControlMenu(EncoderEvent event) {
         case AUDIO_MENU_VOLUME:
             isFocusedOnAudio = !isFocusedOnAudio;
             break;
+        case AUDIO_MENU_SPECTRUM_BUTTON:
+            currentMenuState = MENU_SPECTRUM;
+            drawSpectrumMenu(NULL, 0);
+            setSpectrumEnabled(true);
+            break;
+        case AUDIO_MENU_TIMINGS_BUTTON:
+            currentMenuState = MENU_CONNECTION_TIMINGS;
+            pickedMenuItem = 0;
+            drawConnectionTimingsMenu();
+            break;
         case AUDIO_MENU_BACK_BUTTON:
             disconnectFromDevice();
             break;
@@ -181,20 +292,82 @@ static void encoderAudioControlMenu(EncoderEvent event) {
     }
 }
 
+static void encoderConnectionTimingsMenu(EncoderEvent event) {
+    switch (event) {
+    case ENCODER_STEP_CW:
+        if (pickedMenuItem + 1 < kTimingsMenuEntries) {
+            pickedMenuItem++;
+            drawConnectionTimingsMenu();
+        }
+        break;
+    case ENCODER_STEP_CCW:
+        if (pickedMenuItem > 0) {
+            pickedMenuItem--;
+            drawConnectionTimingsMenu();
+        }
+        break;
+    case ENCODER_SWITCH_PRESSED:
+        currentMenuState = MENU_AUDIO_CONTROL;
+        pickedMenuItem = AUDIO_MENU_TIMINGS_BUTTON;
+        drawAudioControlMenu();
+        break;
+    }
+}
+
+static void encoderSpectrumMenu(EncoderEvent event) {
+    if (event != ENCODER_SWITCH_PRESSED) {
+        return;
+    }
+
+    setSpectrumEnabled(false);
+    currentMenuState = MENU_AUDIO_CONTROL;
+    pickedMenuItem = AUDIO_MENU_SPECTRUM_BUTTON;
+    drawAudioControlMenu();
+}
+
 static void encoderStartupMenu(EncoderEvent event) {
     if (event != ENCODER_SWITCH_PRESSED) {
         return;
     }
 
-    startDiscovery(kDiscoveryDuration);
+    startDiscovery(&kDiscoveryConfig);
 }
 
 static void drawDeviceSelectionMenu() {
     uint8_t textRightBorder = display->width - kPickingArrowWidth;
+    uint8_t marqueeWidth = display->width - kMarqueeGapWidth;
+
+    // Picked name that doesn't fit is scrolled by the display controller. Scrolling row shows it's picked
+    bool isPickedNameLong = pickedMenuItem < peerDevicesCount &&
+        measureString(peerDevices[pickedMenuItem].name, peerDevices[pickedMenuItem].nameLen) > textRightBorder;
+
+    lockDisplay(display);
+    shownScreen = NULL;
+
+    // Name of a shown peer can be refreshed by the discovery, so the part may be gone
+    if (isPickedNameLong &&
+        (marqueeItem != pickedMenuItem || marqueeNameOffset >= peerDevices[pickedMenuItem].nameLen)) {
+        marqueeItem = pickedMenuItem;
+        marqueeNameOffset = 0;
+        xTimerReset(marqueeTimer, portMAX_DELAY);
+    }
 
     for (uint8_t row = kMenuStartRow; row < kMenuEndRow; ++row) {
+        if (row == kMenuStartRow && isPickedNameLong) {
+            PeerDeviceData *peer = &peerDevices[pickedMenuItem];
+
+            drawString(display, peer->name + marqueeNameOffset, peer->nameLen - marqueeNameOffset, row,
+                       0, marqueeWidth, ALIGNMENT_LEFT);
+            eraseRowPart(display, row, marqueeWidth, display->width);
+            continue;
+        }
+
         if (pickedMenuItem + row == peerDevicesCount) {
-            drawString(display, kRestartText, kRestartTextLen, row, 0, textRightBorder, ALIGNMENT_LEFT);
+            if (isDiscovering) {
+                drawString(display, kDiscoveryText, kDiscoveryTextLen, row, 0, textRightBorder, ALIGNMENT_LEFT);
+            } else {
+                drawString(display, kRestartText, kRestartTextLen, row, 0, textRightBorder, ALIGNMENT_LEFT);
+            }
             continue;
         }
 
@@ -207,56 +380,174 @@ static void drawDeviceSelectionMenu() {
                    0, textRightBorder, ALIGNMENT_LEFT);
     }
 
-    drawString(display, kPickingArrow, kPickingArrowLen, 0,
-               textRightBorder, display->width, ALIGNMENT_RIGHT);
+    if (isPickedNameLong) {
+        setMarquee(display, kMenuStartRow);
+    } else {
+        stopNameMarquee();
+        drawString(display, kPickingArrow, kPickingArrowLen, 0,
+                   textRightBorder, display->width, ALIGNMENT_RIGHT);
+    }
 
+    unlockDisplay(display);
     displayBuffer(display);
 }
 
+// Redrawn part is sent with the scroll stopped, then the rotation starts again from its beginning
+static void marqueeTimerCallback(TimerHandle_t timer) {
+    if (currentMenuState != MENU_DEVICE_SELECTION || marqueeItem != pickedMenuItem ||
+        marqueeItem >= peerDevicesCount) {
+        return;
+    }
+
+    PeerDeviceData *peer = &peerDevices[marqueeItem];
+    uint8_t shownLen = countFittingChars(peer->name + marqueeNameOffset, peer->nameLen - marqueeNameOffset,
+                                         display->width - kMarqueeGapWidth);
+
+    // Tail has been shown, the name starts over
+    if (marqueeNameOffset + shownLen >= peer->nameLen || peer->name[marqueeNameOffset + shownLen] == '\0') {
+        marqueeNameOffset = 0;
+    } else {
+        marqueeNameOffset += shownLen;
+    }
+
+    drawDeviceSelectionMenu();
+}
+
+static void stopNameMarquee() {
+    stopMarquee(display);
+
+    if (marqueeItem != kNoMarqueeItem) {
+        marqueeItem = kNoMarqueeItem;
+        xTimerStop(marqueeTimer, portMAX_DELAY);
+    }
+}
+
+// Characters drawn whole within the width, like drawString cuts them
+static uint8_t countFittingChars(const char *string, uint8_t len, uint16_t width) {
+    uint8_t count = 0;
+
+    while (count < len && string[count] != '\0' && measureString(string, count + 1) <= width) {
+        count++;
+    }
+
+    return count;
+}
+
+// Only widgets whose bound values changed are drawn
 static void drawAudioControlMenu() {
-    uint8_t textRightBorder = display->width - kPickingArrowWidth;
+    lockDisplay(display);
+    stopNameMarquee();
+
+    if (shownScreen != &audioMenuList) {
+        clearBuffer(display);
+        invalidateWidget(&audioMenuList);
+        invalidateWidget(&audioMenuArrow);
+        shownScreen = &audioMenuList;
+    }
+
+    setLabelText(&playButton, isPlayingAudio ? kStopText : kPlayText);
+    setWidgetValue(&volumeValue, volumeLevel);
+    setListFirstItem(&audioMenuList, pickedMenuItem);
+
+    bool isDrawn = renderWidget(display, &audioMenuList);
+    isDrawn |= renderWidget(display, &audioMenuArrow);
+
+    unlockDisplay(display);
+
+    if (isDrawn) {
+        displayBuffer(display);
+    }
+}
+
+static void drawConnectionTimingsMenu() {
+    ConnectionAttempt attempt;
+
+    if (getConnectionTimings(&attempt, 1) == 0) {
+        drawTextMenu("", kNoTimingsText, "", "");
+        return;
+    }
 
-    // Text with max possible size
     char text[20] = {};
-    uint8_t textLen = 20;
+    uint8_t textLen = 0;
+
+    lockDisplay(display);
+    stopNameMarquee();
+    shownScreen = NULL;
 
     for (uint8_t row = kMenuStartRow; row < kMenuEndRow; ++row) {
-        if (pickedMenuItem + row >= kAudioControlMenuEntries) {
+        size_t entry = pickedMenuItem + row;
+
+        if (entry >= kTimingsMenuEntries) {
             eraseRowPart(display, row, 0, display->width);
             continue;
         }
 
-        switch ((AudioMenuEntries)(pickedMenuItem + row)) {
-        case AUDIO_MENU_PLAY_BUTTON:
-            if (isPlayingAudio) {
-                textLen = snprintf(text, sizeof(text), "STOP");
-            } else {
-                textLen = snprintf(text, sizeof(text), "PLAY");
-            }
-            break;
-        case AUDIO_MENU_VOLUME:
-            textLen = snprintf(text, sizeof(text), "Volume: %u%%", volumeLevel);
-            break;
-        case AUDIO_MENU_BACK_BUTTON:
-            textLen = snprintf(text, sizeof(text), "BACK");
-            break;
+        // First entry is the whole attempt, the rest are phases ending with the milestone
+        const char *name = "TOTAL";
+        int64_t durationUs = getConnectionTotalUs(&attempt);
+
+        if (entry != 0) {
+            name = getConnectionMilestoneName((ConnectionMilestone)entry);
+            durationUs = getConnectionPhaseUs(&attempt, (ConnectionMilestone)entry);
+        }
+
+        if (durationUs < 0) {
+            textLen = snprintf(text, sizeof(text), "-");
+        } else {
+            textLen = snprintf(text, sizeof(text), "%ldms", (long)(durationUs / 1000));
         }
 
-        drawString(display, text, textLen, row, 0, textRightBorder, ALIGNMENT_LEFT);
+        // Font is proportional, so the values are aligned by the right border instead of padding
+        drawString(display, name, strlen(name), row, 0, kTimingsValueColumn, ALIGNMENT_LEFT);
+        drawString(display, text, textLen, row, kTimingsValueColumn, display->width, ALIGNMENT_RIGHT);
     }
 
-    drawString(display, kPickingArrow, kPickingArrowLen, 0,
-               textRightBorder, display->width, ALIGNMENT_RIGHT);
+    unlockDisplay(display);
+    displayBuffer(display);
+}
 
+void spectrumFrameCallback(const uint8_t *levels, uint8_t bandsCount) {
+    if (currentMenuState == MENU_SPECTRUM) {
+        drawSpectrumMenu(levels, bandsCount);
+    }
+}
+
+// Bars are drawn over the previous frame, so dirty windows contain only the changed bar tops.
+// Empty screen is drawn without levels on the entry
+static void drawSpectrumMenu(const uint8_t *levels, uint8_t bandsCount) {
+    lockDisplay(display);
+    stopNameMarquee();
+    shownScreen = NULL;
+
+    if (levels == NULL) {
+        clearBuffer(display);
+    } else {
+        uint8_t barStep = display->width / bandsCount;
+
+        for (uint8_t band = 0; band < bandsCount; band++) {
+            int16_t barHeight = levels[band] * display->height / kSpectrumMaxLevel;
+            int16_t x = band * barStep;
+
+            fillRect(display, x, 0, barStep - kSpectrumBarGap, display->height - barHeight, DISPLAY_COLOR_BLACK);
+            fillRect(display, x, display->height - barHeight, barStep - kSpectrumBarGap, barHeight, DISPLAY_COLOR_WHITE);
+        }
+    }
+
+    unlockDisplay(display);
     displayBuffer(display);
 }
 
 static void drawTextMenu(const char *line1, const char *line2, const char *line3, const char *line4) {
+    lockDisplay(display);
+    stopNameMarquee();
+    shownScreen = NULL;
+
     drawStringFullLine(display, line1, 0, ALIGNMENT_LEFT);
     drawStringFullLine(display, line2, 1, ALIGNMENT_LEFT);
     drawStringFullLine(display, line3, 2, ALIGNMENT_LEFT);
     drawStringFullLine(display, line4, 3, ALIGNMENT_LEFT);
 
+    unlockDisplay(display);
     displayBuffer(display);
 }
 
@@ -275,3 +566,19 @@ static void drawConnectionMenu() {
 static void drawDisconnectionMenu() {
     drawTextMenu("", kDisconnectingText, "", "");
 }
+
+static void initAudioControlWidgets() {
+    uint8_t textRightBorder = display->width - kPickingArrowWidth;
+
+    initLabelWidget(&playButton, kPlayText);
+    initValueWidget(&volumeValue, kVolumeFormat, volumeLevel);
+    initLabelWidget(&spectrumButton, kSpectrumText);
+    initLabelWidget(&timingsButton, kTimingsText);
+    initLabelWidget(&backButton, kBackText);
+
+    initListWidget(&audioMenuList, audioMenuItems, kAudioControlMenuEntries, kMenuEndRow - kMenuStartRow);
+    setWidgetBounds(&audioMenuList, kMenuStartRow, 0, textRightBorder, ALIGNMENT_LEFT);
+
+    initLabelWidget(&audioMenuArrow, kPickingArrow);
+    setWidgetBounds(&audioMenuArrow, kMenuStartRow, textRightBorder, display->width, ALIGNMENT_RIGHT);
+}
@@ -0,0 +1,159 @@
+#include <assert.h>
+#include <esp_cpu.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "spectrum.h"
+#include "spectrum_fft.h"
+#include "freertos/idf_additions.h"
+#include "portmacro.h"
+
+#define SPECTRUM_TAG "SPECTRUM"
+
+#define kAnalyzerTaskStackDepth (3072)
+#define kAnalyzerTaskPriority (tskIDLE_PRIORITY + 1)
+#define kAnalyzerTaskCore (1) // Bluetooth controller and Bluedroid are pinned to core 0
+
+static SpectrumFft fft;
+static SpectrumFrameCallback frameCallback = NULL;
+static TaskHandle_t analyzerTaskHandle = NULL;
+
+// Capture block is filled by the audio path and handed over to the analyzer while isBlockReady is set
+static int16_t captureBlock[kSpectrumFftSize];
+static uint16_t capturedCount = 0;
+static int64_t lastBlockUs = 0;
+static atomic_bool isBlockReady = false;
+static atomic_bool isSpectrumEnabled = false;
+
+// Levels are owned by the analyzer task. Other tasks only request them to be cleared
+static uint8_t levels[kSpectrumBandsCount] = {};
+static atomic_bool isLevelsResetRequested = false;
+static SpectrumStats stats = {};
+static portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+
+static void analyzerTask(void *param);
+static uint8_t powerToLevel(uint8_t bandPower);
+
+void initSpectrum(SpectrumFrameCallback callback) {
+    assert(callback);
+
+    frameCallback = callback;
+    initSpectrumFft(&fft);
+
+    xTaskCreatePinnedToCore(analyzerTask, "SpectrumTask", kAnalyzerTaskStackDepth, NULL, kAnalyzerTaskPriority,
+                            &analyzerTaskHandle, kAnalyzerTaskCore);
+    assert(analyzerTaskHandle);
+}
+
+void setSpectrumEnabled(bool isEnabled) {
+    if (isEnabled && !atomic_load(&isSpectrumEnabled)) {
+        atomic_store(&isLevelsResetRequested, true);
+    }
+
+    atomic_store(&isSpectrumEnabled, isEnabled);
+}
+
+void feedSpectrumSamples(const AudioFrame *frames, int32_t len) {
+    assert(frames);
+
+    if (!atomic_load(&isSpectrumEnabled)) {
+        return;
+    }
+
+    if (atomic_load(&isBlockReady)) {
+        portENTER_CRITICAL(&statsLock);
+        stats.droppedSamples += len;
+        portEXIT_CRITICAL(&statsLock);
+        return;
+    }
+
+    // Blocks start at the frame rate, samples between them aren't analyzed
+    int64_t now = esp_timer_get_time();
+
+    if (capturedCount == 0 && now - lastBlockUs < kSpectrumFramePeriodUs) {
+        return;
+    }
+
+    for (int32_t idx = 0; idx < len && capturedCount < kSpectrumFftSize; idx++) {
+        captureBlock[capturedCount++] = ((int16_t)frames[idx].channel1 + (int16_t)frames[idx].channel2) / 2;
+    }
+
+    if (capturedCount < kSpectrumFftSize) {
+        return;
+    }
+
+    capturedCount = 0;
+    lastBlockUs = now;
+
+    atomic_store(&isBlockReady, true);
+    xTaskNotifyGive(analyzerTaskHandle);
+}
+
+void getSpectrumStats(SpectrumStats *outStats) {
+    assert(outStats);
+
+    portENTER_CRITICAL(&statsLock);
+    *outStats = stats;
+    portEXIT_CRITICAL(&statsLock);
+}
+
+static void analyzerTask(void *param) {
+    uint8_t bandPowers[kSpectrumBandsCount];
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        if (!atomic_load(&isBlockReady)) {
+            continue;
+        }
+
+        uint32_t startCycles = esp_cpu_get_cycle_count();
+        computeSpectrumBands(&fft, captureBlock, bandPowers);
+        uint32_t cycles = esp_cpu_get_cycle_count() - startCycles;
+
+        // Block is free for the audio path again
+        atomic_store(&isBlockReady, false);
+
+        // Screen was reopened, bars from the last time it was shown don't decay on it
+        if (atomic_exchange(&isLevelsResetRequested, false)) {
+            memset(levels, 0, sizeof(levels));
+        }
+
+        // Bars rise at once and fall slowly, so the picture doesn't flicker
+        for (uint8_t band = 0; band < kSpectrumBandsCount; band++) {
+            uint8_t level = powerToLevel(bandPowers[band]);
+            uint8_t decayed = (levels[band] > kSpectrumLevelDecay ? levels[band] - kSpectrumLevelDecay : 0);
+
+            levels[band] = (level > decayed ? level : decayed);
+        }
+
+        portENTER_CRITICAL(&statsLock);
+        stats.computedFrames++;
+        stats.lastCycles = cycles;
+        stats.maxCycles = (cycles > stats.maxCycles ? cycles : stats.maxCycles);
+        SpectrumStats reportedStats = stats;
+        portEXIT_CRITICAL(&statsLock);
+
+        if (reportedStats.computedFrames % kSpectrumReportFrames == 0) {
+            ESP_LOGI(SPECTRUM_TAG, "FFT cycles: last %" PRIu32 ", max %" PRIu32 ". Frames %" PRIu32 ", dropped samples %" PRIu32,
+                     reportedStats.lastCycles, reportedStats.maxCycles, reportedStats.computedFrames,
+                     reportedStats.droppedSamples);
+        }
+
+        if (atomic_load(&isSpectrumEnabled)) {
+            frameCallback(levels, kSpectrumBandsCount);
+        }
+    }
+}
+
+static uint8_t powerToLevel(uint8_t bandPower) {
+    if (bandPower <= kSpectrumFloorLog2Q2) {
+        return 0;
+    }
+
+    uint32_t level = (uint32_t)(bandPower - kSpectrumFloorLog2Q2) * kSpectrumMaxLevel / kSpectrumRangeLog2Q2;
+    return (level < kSpectrumMaxLevel ? level : kSpectrumMaxLevel);
+}
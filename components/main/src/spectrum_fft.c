@@ -0,0 +1,146 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+
+#include "spectrum_fft.h"
+
+#define kQ15One (32767)
+
+static int16_t toQ15(float value);
+static int16_t mulQ15(int16_t a, int16_t b);
+static void fftQ15(SpectrumFft *fft);
+static uint8_t log2Q2(uint64_t value);
+
+void initSpectrumFft(SpectrumFft *fft) {
+    assert(fft);
+
+    for (uint16_t idx = 0; idx < kSpectrumFftSize; idx++) {
+        fft->window[idx] = toQ15(0.5f - 0.5f * cosf(2.0f * M_PI * idx / (kSpectrumFftSize - 1)));
+    }
+
+    for (uint16_t idx = 0; idx < kSpectrumHalfSize; idx++) {
+        fft->twiddleCos[idx] = toQ15(cosf(2.0f * M_PI * idx / kSpectrumFftSize));
+        fft->twiddleSin[idx] = toQ15(sinf(2.0f * M_PI * idx / kSpectrumFftSize));
+    }
+
+    // Bands grow geometrically from the first bin to the last one. Low bands take at least one bin
+    fft->bandEdges[0] = 1;
+
+    for (uint8_t band = 1; band <= kSpectrumBandsCount; band++) {
+        uint16_t edge = lroundf(powf(kSpectrumHalfSize, (float)band / kSpectrumBandsCount));
+        uint16_t minEdge = fft->bandEdges[band - 1] + 1;
+
+        fft->bandEdges[band] = (edge > minEdge ? edge : minEdge);
+    }
+
+    fft->bandEdges[kSpectrumBandsCount] = kSpectrumHalfSize;
+}
+
+// Real FFT is computed as a complex one of the half size: even samples are real parts, odd ones are imaginary
+void computeSpectrumBands(SpectrumFft *fft, const int16_t *samples, uint8_t *bandPowers) {
+    assert(fft);
+    assert(samples);
+    assert(bandPowers);
+
+    for (uint16_t idx = 0; idx < kSpectrumHalfSize; idx++) {
+        fft->scratch[idx].re = mulQ15(samples[2 * idx], fft->window[2 * idx]);
+        fft->scratch[idx].im = mulQ15(samples[2 * idx + 1], fft->window[2 * idx + 1]);
+    }
+
+    fftQ15(fft);
+
+    uint8_t band = 0;
+    uint64_t bandPower = 0;
+
+    for (uint16_t bin = 1; bin < kSpectrumHalfSize; bin++) {
+        ComplexQ15 z = fft->scratch[bin];
+        ComplexQ15 zMirror = fft->scratch[kSpectrumHalfSize - bin];
+
+        // Even part E = (Z[k] + conj(Z[M - k])) / 2, odd part O = (Z[k] - conj(Z[M - k])) / 2j
+        int32_t evenRe = (z.re + zMirror.re) / 2;
+        int32_t evenIm = (z.im - zMirror.im) / 2;
+        int32_t oddRe = (z.im + zMirror.im) / 2;
+        int32_t oddIm = (zMirror.re - z.re) / 2;
+
+        // X[k] = E + W^k * O, where W^k = cos - j * sin
+        int32_t cosK = fft->twiddleCos[bin];
+        int32_t sinK = fft->twiddleSin[bin];
+        int32_t re = evenRe + ((oddRe * cosK + oddIm * sinK) >> 15);
+        int32_t im = evenIm + ((oddIm * cosK - oddRe * sinK) >> 15);
+
+        bandPower += (uint64_t)((int64_t)re * re + (int64_t)im * im);
+
+        if (bin + 1 == fft->bandEdges[band + 1]) {
+            bandPowers[band] = log2Q2(bandPower);
+            bandPower = 0;
+            band++;
+        }
+    }
+}
+
+// In-place radix-2 decimation in time. Every stage is scaled by 1/2, so nothing overflows
+static void fftQ15(SpectrumFft *fft) {
+    ComplexQ15 *data = fft->scratch;
+
+    for (uint16_t idx = 1, reversed = 0; idx < kSpectrumHalfSize; idx++) {
+        uint16_t bit = kSpectrumHalfSize >> 1;
+
+        for (; reversed & bit; bit >>= 1) {
+            reversed ^= bit;
+        }
+        reversed ^= bit;
+
+        if (idx < reversed) {
+            ComplexQ15 tmp = data[idx];
+            data[idx] = data[reversed];
+            data[reversed] = tmp;
+        }
+    }
+
+    for (uint16_t len = 2; len <= kSpectrumHalfSize; len <<= 1) {
+        uint16_t half = len / 2;
+        uint16_t twiddleStep = kSpectrumFftSize / len; // W_M^j = W_N^(2j)
+
+        for (uint16_t start = 0; start < kSpectrumHalfSize; start += len) {
+            for (uint16_t j = 0; j < half; j++) {
+                int32_t cosJ = fft->twiddleCos[j * twiddleStep];
+                int32_t sinJ = fft->twiddleSin[j * twiddleStep];
+
+                ComplexQ15 *a = &data[start + j];
+                ComplexQ15 *b = &data[start + j + half];
+
+                // t = b * (cos - j * sin)
+                int32_t tRe = (b->re * cosJ + b->im * sinJ) >> 15;
+                int32_t tIm = (b->im * cosJ - b->re * sinJ) >> 15;
+
+                int32_t aRe = a->re;
+                int32_t aIm = a->im;
+
+                a->re = (aRe + tRe) >> 1;
+                a->im = (aIm + tIm) >> 1;
+                b->re = (aRe - tRe) >> 1;
+                b->im = (aIm - tIm) >> 1;
+            }
+        }
+    }
+}
+
+static uint8_t log2Q2(uint64_t value) {
+    if (value == 0) {
+        return 0;
+    }
+
+    uint8_t msb = 63 - __builtin_clzll(value);
+    uint8_t fraction = (msb >= 2 ? (value >> (msb - 2)) & 0x3 : (value << (2 - msb)) & 0x3);
+
+    return msb * 4 + fraction;
+}
+
+static int16_t toQ15(float value) {
+    int32_t scaled = lroundf(value * kQ15One);
+    return (scaled > kQ15One ? kQ15One : (scaled < -kQ15One ? -kQ15One : scaled));
+}
+
+static int16_t mulQ15(int16_t a, int16_t b) {
+    return ((int32_t)a * b) >> 15;
+}
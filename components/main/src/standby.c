@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <driver/rtc_io.h>
+#include <esp_log.h>
+#include <esp_sleep.h>
+#include <stdatomic.h>
+
+#include "standby.h"
+#include "bt_lib.h"
+#include "display.h"
+#include "freertos/idf_additions.h"
+#include "portmacro.h"
+
+#define STANDBY_TAG "STANDBY"
+
+#define kStandbyTaskStackDepth (4096)
+#define kStandbyTaskPriority (tskIDLE_PRIORITY + 1)
+
+static DisplayDevice *display = NULL;
+static gpio_num_t wakePort = GPIO_NUM_NC;
+
+static TimerHandle_t standbyTimer = NULL;
+static TaskHandle_t standbyTaskHandle = NULL;
+static atomic_bool isStandbyArmed = false;
+
+static void standbyTimerCallback(TimerHandle_t timer);
+static void standbyTask(void *param);
+
+void initStandby(DisplayDevice *newDisplay, gpio_num_t newWakePort) {
+    assert(newDisplay);
+
+    display = newDisplay;
+    wakePort = newWakePort;
+
+    // Wake port stays routed to the RTC domain after the wake up
+    if (isWakeFromStandby()) {
+        rtc_gpio_deinit(wakePort);
+    }
+
+    standbyTimer = xTimerCreate("StandbyTimer", kStandbyTimeoutMs / portTICK_PERIOD_MS, pdFALSE, NULL,
+                                standbyTimerCallback);
+    assert(standbyTimer);
+
+    xTaskCreate(standbyTask, "StandbyTask", kStandbyTaskStackDepth, NULL, kStandbyTaskPriority, &standbyTaskHandle);
+    assert(standbyTaskHandle);
+}
+
+void armStandbyTimer() {
+    atomic_store(&isStandbyArmed, true);
+    xTimerReset(standbyTimer, portMAX_DELAY);
+}
+
+void disarmStandbyTimer() {
+    atomic_store(&isStandbyArmed, false);
+    xTimerStop(standbyTimer, portMAX_DELAY);
+}
+
+void resetStandbyTimer() {
+    if (atomic_load(&isStandbyArmed)) {
+        xTimerReset(standbyTimer, portMAX_DELAY);
+    }
+}
+
+bool isWakeFromStandby() {
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0;
+}
+
+// Bluetooth shutdown takes too much stack for the timer task
+static void standbyTimerCallback(TimerHandle_t timer) {
+    xTaskNotifyGive(standbyTaskHandle);
+}
+
+static void standbyTask(void *param) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Menu could leave the idle screens while the notification was pending
+        if (!atomic_load(&isStandbyArmed)) {
+            continue;
+        }
+
+        ESP_LOGI(STANDBY_TAG, "Entering standby");
+
+        setDisplayPower(display, false);
+        shutdownBtDevice();
+
+        // Encoder switch is active low. RTC pull up keeps it released during the deep sleep
+        rtc_gpio_pullup_en(wakePort);
+        rtc_gpio_pulldown_dis(wakePort);
+        ESP_ERROR_CHECK(esp_sleep_enable_ext0_wakeup(wakePort, 0));
+
+        esp_deep_sleep_start();
+    }
+}
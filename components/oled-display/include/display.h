@@ -2,10 +2,14 @@
 #define SCREEN_H_
 
 #include <driver/i2c_master.h>
+#include <freertos/idf_additions.h>
 #include <stdint.h>
 
 #define DISPLAY_TAG "DISPLAY"
 
+#define kDisplayFlushTaskStackDepth (2048)
+#define kDisplayFlushTaskPriority (tskIDLE_PRIORITY + 2)
+
 typedef struct {
     i2c_master_bus_handle_t handle;
     size_t devicesOnBus;
@@ -21,6 +25,21 @@ typedef enum {
     DISPLAY_128_32,
 } DisplayType;
 
+#define kDisplayMaxPages (8)
+#define kDisplayNoMarquee (0xFF)
+#define kMarqueeScrollInterval (0x00) // Step every 5 frames
+#define kMarqueeFramesPerStep (5)
+#define kDisplayOscillatorHz (370000) // Typical, with the 0x80 clock setting of the init sequence
+#define kDisplayRowClocks (66)        // Precharge phases of 1 and 15 clocks, 50 clocks for the row itself
+
+// Bus traffic of the flush task. Bytes don't include I2C address bytes
+typedef struct {
+    uint32_t flushesCount;
+    uint32_t totalBytes;
+    uint32_t lastFlushBytes;
+    uint32_t lastFlushUs;
+} DisplayStats;
+
 typedef struct {
     I2CDevice device;
 
@@ -31,8 +50,23 @@ typedef struct {
 
     uint8_t contrast;
 
-    uint8_t *dataControlByte;
+    // Drawing goes to the back buffer. Flush task copies its dirty windows to the front buffer and sends them,
+    // so I2C transfers never block the drawing tasks
     uint8_t *buffer;
+    uint8_t *frontBuffer;
+
+    SemaphoreHandle_t bufferMutex;
+    TaskHandle_t flushTask;
+
+    // Page scrolled by the controller. Requested one is set by drawing tasks, active one is owned by flush task
+    uint8_t marqueePage;
+    uint8_t activeMarqueePage;
+
+    DisplayStats stats;
+
+    // Columns changed since the last flush for every page. Range is [start, end), it's empty if start >= end
+    uint8_t dirtyStartCol[kDisplayMaxPages];
+    uint8_t dirtyEndCol[kDisplayMaxPages];
 } DisplayDevice;
 
 typedef enum {
@@ -52,6 +86,7 @@ typedef enum {
 //The GDDRAM column address pointer will be increased by one automatically after each data write.
 static const uint8_t kCommandControlByte = 0x00;
 static const uint8_t kDataControlByte = 0x40;
+static const uint8_t kSingleCommandControlByte = 0x80; // One command byte follows, then another control byte
 
 void initDisplay(DisplayDevice *display, I2CDevice *i2cDevice, DisplayType type);
 void initI2CBus(I2CBus *bus, i2c_master_bus_config_t *busConfig);
@@ -65,11 +100,37 @@ void sendCommandList(DisplayDevice *display, uint8_t *commands, size_t len);
 void sendSingleCommand(DisplayDevice *display, uint8_t command);
 void sendData(DisplayDevice *display, uint8_t *data, size_t len);
 
+void displayFlushTask(void *param);
+
+// Drawing functions change the back buffer. Callers from different tasks should draw between these calls
+void lockDisplay(DisplayDevice *display);
+void unlockDisplay(DisplayDevice *display);
+
+// Requests a flush and returns right away. Requests made while one is pending are merged
 void displayBuffer(DisplayDevice *display);
+void invalidateDisplay(DisplayDevice *display);
+void setMarquee(DisplayDevice *display, uint8_t page);
+void stopMarquee(DisplayDevice *display);
+uint32_t getMarqueeRotationMs(DisplayDevice *display);
+void getDisplayStats(DisplayDevice *display, DisplayStats *stats);
 void clearBuffer(DisplayDevice *display);
+void setDisplayPower(DisplayDevice *display, bool isOn);
 
 void setPixel(DisplayDevice *display, uint8_t x, uint8_t y, DisplayColor color);
+void applyBufferMask(DisplayDevice *display, uint8_t page, uint8_t col, uint8_t mask, DisplayColor color);
+
+// Primitives clip everything outside of the screen, so coordinates may be negative
+void drawHorizontalSpan(DisplayDevice *display, int16_t x, int16_t y, int16_t width, DisplayColor color);
+void drawVerticalSpan(DisplayDevice *display, int16_t x, int16_t y, int16_t height, DisplayColor color);
+void fillRect(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height, DisplayColor color);
+void invertRect(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height);
+void drawRect(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height, DisplayColor color);
+void drawLine(DisplayDevice *display, int16_t x0, int16_t y0, int16_t x1, int16_t y1, DisplayColor color);
+void drawBitmap(DisplayDevice *display, const uint8_t *bitmap, int16_t x, int16_t y, uint8_t width, uint8_t height);
+void drawBar(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height, uint16_t value, uint16_t maxValue);
 void drawString(DisplayDevice *display, const char *string, uint8_t len, uint8_t row, uint8_t leftBorder, uint8_t rightBorder, DisplayAlignment alignment);
+void drawStringAt(DisplayDevice *display, const char *string, uint8_t len, uint8_t y, uint8_t leftBorder, uint8_t rightBorder, DisplayAlignment alignment);
+uint16_t measureString(const char *string, uint8_t len);
 void drawStringFullLine(DisplayDevice *display, const char *string, uint8_t row, DisplayAlignment alignment);
 void eraseRowPart(DisplayDevice *display, uint8_t row, uint8_t start, uint8_t end);
 
@@ -0,0 +1,64 @@
+#ifndef WIDGET_H_
+#define WIDGET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "display.h"
+
+#define kWidgetTextMaxLen (24)
+
+typedef enum {
+    WIDGET_LABEL,
+    WIDGET_VALUE,
+    WIDGET_LIST,
+} WidgetType;
+
+// Retained widget. Setters mark it dirty only if the bound data changes, render pass draws dirty widgets only
+typedef struct Widget {
+    WidgetType type;
+
+    uint8_t row;
+    uint8_t leftBorder;
+    uint8_t rightBorder;
+    DisplayAlignment alignment;
+
+    bool isDirty;
+
+    union {
+        struct {
+            const char *text;
+        } label;
+
+        struct {
+            const char *format; // printf format with one int32_t argument
+            int32_t value;
+        } value;
+
+        // Shows items from the first one in the rows of the list. Items take position from the list
+        struct {
+            struct Widget **items;
+            uint8_t itemsCount;
+            uint8_t firstItem;
+            uint8_t rowsCount;
+        } list;
+    };
+} Widget;
+
+void initLabelWidget(Widget *widget, const char *text);
+void initValueWidget(Widget *widget, const char *format, int32_t value);
+void initListWidget(Widget *widget, Widget **items, uint8_t itemsCount, uint8_t rowsCount);
+
+void setWidgetBounds(Widget *widget, uint8_t row, uint8_t leftBorder, uint8_t rightBorder, DisplayAlignment alignment);
+
+void setLabelText(Widget *widget, const char *text);
+void setWidgetValue(Widget *widget, int32_t value);
+void setListFirstItem(Widget *widget, uint8_t firstItem);
+
+// Whole widget is drawn again, e.g. after other screen was shown
+void invalidateWidget(Widget *widget);
+
+// Should be called between lockDisplay and unlockDisplay. Returns true if anything was drawn
+bool renderWidget(DisplayDevice *display, Widget *widget);
+
+#endif
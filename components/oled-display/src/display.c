@@ -2,6 +2,8 @@
 #include <driver/i2c_master.h>
 #include <esp_err.h>
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -9,6 +11,22 @@
 #include "display.h"
 
 static uint8_t charToFontIndex(char c);
+static void writeBufferByte(DisplayDevice *display, uint8_t page, uint8_t col, uint8_t value);
+static void writeColumnBits(DisplayDevice *display, uint8_t x, uint8_t y, uint8_t bits);
+static void markDirty(DisplayDevice *display, uint8_t page, uint8_t startCol, uint8_t endCol);
+static size_t flushPageWindow(DisplayDevice *display, uint8_t page, uint8_t startCol, uint8_t endCol);
+static bool hasDirtyWindows(DisplayDevice *display);
+static size_t startHardwareScroll(DisplayDevice *display, uint8_t page);
+
+void lockDisplay(DisplayDevice *display) {
+    assert(display);
+    xSemaphoreTake(display->bufferMutex, portMAX_DELAY);
+}
+
+void unlockDisplay(DisplayDevice *display) {
+    assert(display);
+    xSemaphoreGive(display->bufferMutex);
+}
 
 void drawStringFullLine(DisplayDevice *display, const char *string, uint8_t row, DisplayAlignment alignment) {
     drawString(display, string, strlen(string), row, 0, display->width - 1, alignment);
@@ -25,87 +43,341 @@ void drawString(DisplayDevice *display, const char *string, uint8_t len, uint8_t
         return;
     }
 
+    drawStringAt(display, string, len, row * 8, leftBorder, rightBorder, alignment);
+}
+
+// Text is 8 pixels tall starting from any y. Unused part of the range is erased within these 8 pixels only
+void drawStringAt(DisplayDevice *display, const char *string, uint8_t len, uint8_t y, uint8_t leftBorder, uint8_t rightBorder, DisplayAlignment alignment) {
+    assert(display);
+    assert(string);
+
+    if (y >= display->height) {
+        ESP_LOGE(DISPLAY_TAG, "Screen line %u is bigger than available %u", y, display->height);
+        return;
+    }
+
     rightBorder = (rightBorder <= display->width ? rightBorder : display->width);
 
-    uint8_t idx = 0;
     uint8_t bufferCol = leftBorder;
     
     // If alignment to right move text begin right to needed amount and erase all pixels in unused space
     if (alignment == ALIGNMENT_RIGHT) {
-        uint8_t newLeftBorder = rightBorder - len * kFontWidth + 1;
+        uint16_t textWidth = measureString(string, len);
+        uint8_t newLeftBorder = (leftBorder + textWidth < rightBorder ? rightBorder - textWidth : leftBorder);
 
         for (; bufferCol < newLeftBorder; bufferCol++) {
-            display->buffer[bufferCol + row * display->width] = 0x00;
+            writeColumnBits(display, bufferCol, y, 0x00);
         }
     }
 
-    while (string[idx] != '\0') {
-        if (bufferCol + kFontWidth > rightBorder) {
+    for (uint8_t idx = 0; idx < len && string[idx] != '\0'; idx++) {
+        // Glyph is resolved once, then its columns are merged into the pages
+        uint8_t fontIndex = charToFontIndex(string[idx]);
+        uint8_t glyphWidth = fontWidths[fontIndex];
+
+        if (bufferCol + glyphWidth > rightBorder) {
             break;
         }
 
-        char symbol = string[idx];
+        const uint8_t *glyph = font[fontIndex];
 
-        for (uint8_t fontCol = 0; fontCol < kFontWidth; fontCol++) {
-            display->buffer[bufferCol + row * display->width] = font[charToFontIndex(symbol)][fontCol];
+        for (uint8_t fontCol = 0; fontCol < glyphWidth; fontCol++) {
+            writeColumnBits(display, bufferCol, y, fontCol < kFontWidth ? glyph[fontCol] : 0x00);
             bufferCol++;
         }
-
-        idx++;
     }
 
     if (alignment == ALIGNMENT_LEFT) {
         for (;bufferCol < rightBorder; bufferCol++) {
-            display->buffer[bufferCol + row * display->width] = 0x00;
+            writeColumnBits(display, bufferCol, y, 0x00);
         }
     }
 }
 
+uint16_t measureString(const char *string, uint8_t len) {
+    assert(string);
+
+    uint16_t width = 0;
+
+    for (uint8_t idx = 0; idx < len && string[idx] != '\0'; idx++) {
+        width += fontWidths[charToFontIndex(string[idx])];
+    }
+
+    return width;
+}
+
 void eraseRowPart(DisplayDevice *display, uint8_t row, uint8_t start, uint8_t end) {
     end = (end <= display->width ? end : display->width);
 
     for (uint8_t col = start; col < end; col++) {
-        display->buffer[col + row * display->width] = 0x00;
+        writeBufferByte(display, row, col, 0x00);
     }
 }
 
 void setPixel(DisplayDevice *display, uint8_t x, uint8_t y, DisplayColor color) {
-    size_t idx = x + (y / 8) * display->width; // Set segment
-    uint8_t mask = 1 << (y & 7); // Set bit in segment
+    if (x >= display->width || y >= display->height) {
+        return;
+    }
+
+    applyBufferMask(display, y / 8, x, 1 << (y & 7), color); // Set bit in segment
+}
+
+// Changes masked bits of one page byte. Primitives work on the whole bytes through it
+void applyBufferMask(DisplayDevice *display, uint8_t page, uint8_t col, uint8_t mask, DisplayColor color) {
+    uint8_t value = display->buffer[col + page * display->width];
 
     switch (color) {
     case DISPLAY_COLOR_WHITE:
-        display->buffer[idx] |= mask; 
+        value |= mask; 
         break;
     case DISPLAY_COLOR_BLACK:
-        display->buffer[idx] &= ~mask; 
+        value &= ~mask; 
         break;
     case DISPLAY_COLOR_INVERSE:
-        display->buffer[idx] |= mask; 
+        value ^= mask; 
         break;
     }
 
+    writeBufferByte(display, page, col, value);
 }
 
 void clearBuffer(DisplayDevice *display) {
     assert(display);
-    memset(display->buffer, 0, display->width * display->height / 8);
+
+    for (uint8_t page = 0; page < display->height / 8; page++) {
+        for (uint8_t col = 0; col < display->width; col++) {
+            writeBufferByte(display, page, col, 0x00);
+        }
+    }
+}
+
+// Next flush sends the whole buffer. Needed when GDDRAM content is unknown
+void invalidateDisplay(DisplayDevice *display) {
+    assert(display);
+
+    for (uint8_t page = 0; page < display->height / 8; page++) {
+        markDirty(display, page, 0, display->width);
+    }
 }
 
 void displayBuffer(DisplayDevice *display) {
     assert(display);
+    xTaskNotifyGive(display->flushTask);
+}
+
+// Page content rotates in the controller, so it should fit the screen width. Takes effect with the next flush
+void setMarquee(DisplayDevice *display, uint8_t page) {
+    assert(display);
+    assert(page < display->height / 8);
+
+    display->marqueePage = page;
+}
+
+void stopMarquee(DisplayDevice *display) {
+    assert(display);
+    display->marqueePage = kDisplayNoMarquee;
+}
+
+// Time the controller takes to rotate the page by the full width. Frame rate follows the multiplex ratio
+uint32_t getMarqueeRotationMs(DisplayDevice *display) {
+    assert(display);
+
+    uint64_t frameClocks = (uint64_t)display->height * kDisplayRowClocks;
+    return display->width * kMarqueeFramesPerStep * frameClocks * 1000 / kDisplayOscillatorHz;
+}
+
+void getDisplayStats(DisplayDevice *display, DisplayStats *stats) {
+    assert(display);
+    assert(stats);
+
+    lockDisplay(display);
+    *stats = display->stats;
+    unlockDisplay(display);
+}
+
+// Only changed column ranges are sent, one transaction for every page
+void displayFlushTask(void *param) {
+    DisplayDevice *display = param;
+
+    uint8_t startCols[kDisplayMaxPages];
+    uint8_t endCols[kDisplayMaxPages];
+    uint8_t pagesCount = display->height / 8;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Swap dirty windows under the lock, so drawing isn't blocked by the transfer
+        lockDisplay(display);
+
+        // RAM writes aren't allowed while scrolling. Scrolled page is rotated in GDDRAM, so it's sent again
+        uint8_t requestedMarqueePage = display->marqueePage;
+        bool shouldStopScroll = display->activeMarqueePage != kDisplayNoMarquee &&
+                                (hasDirtyWindows(display) || requestedMarqueePage != display->activeMarqueePage);
+
+        if (shouldStopScroll) {
+            markDirty(display, display->activeMarqueePage, 0, display->width);
+        }
 
+        for (uint8_t page = 0; page < pagesCount; page++) {
+            startCols[page] = display->dirtyStartCol[page];
+            endCols[page] = display->dirtyEndCol[page];
+
+            if (startCols[page] < endCols[page]) {
+                size_t offset = page * display->width + startCols[page];
+                memcpy(display->frontBuffer + offset, display->buffer + offset, endCols[page] - startCols[page]);
+            }
+
+            display->dirtyStartCol[page] = display->width;
+            display->dirtyEndCol[page] = 0;
+        }
+
+        unlockDisplay(display);
+
+        int64_t flushStartUs = esp_timer_get_time();
+        size_t flushBytes = 0;
+
+        if (shouldStopScroll) {
+            sendSingleCommand(display, DISPLAY_DEACTIVATE_SCROLL);
+            display->activeMarqueePage = kDisplayNoMarquee;
+            flushBytes += 2;
+        }
+
+        for (uint8_t page = 0; page < pagesCount; page++) {
+            if (startCols[page] < endCols[page]) {
+                flushBytes += flushPageWindow(display, page, startCols[page], endCols[page]);
+            }
+        }
+
+        if (requestedMarqueePage != kDisplayNoMarquee && display->activeMarqueePage == kDisplayNoMarquee) {
+            flushBytes += startHardwareScroll(display, requestedMarqueePage);
+            display->activeMarqueePage = requestedMarqueePage;
+        }
+
+        uint32_t flushUs = esp_timer_get_time() - flushStartUs;
+
+        lockDisplay(display);
+        display->stats.flushesCount++;
+        display->stats.totalBytes += flushBytes;
+        display->stats.lastFlushBytes = flushBytes;
+        display->stats.lastFlushUs = flushUs;
+        unlockDisplay(display);
+
+        ESP_LOGD(DISPLAY_TAG, "Flush: %u bytes, %" PRIu32 "us", (unsigned)flushBytes, flushUs);
+    }
+}
+
+static bool hasDirtyWindows(DisplayDevice *display) {
+    for (uint8_t page = 0; page < display->height / 8; page++) {
+        if (display->dirtyStartCol[page] < display->dirtyEndCol[page]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Controller rotates the page by itself, scrolling doesn't take any bus time
+static size_t startHardwareScroll(DisplayDevice *display, uint8_t page) {
     uint8_t commands[] = {
-        DISPLAY_PAGEADDR,
-        0,                  // Page start address
-        0xFF,               // Page end (not really, but works here)
-        DISPLAY_COLUMNADDR, // Column start address
-        0,
+        DISPLAY_LEFT_HORIZONTAL_SCROLL,
+        0x00,                     // Dummy byte
+        page,                     // Start page
+        kMarqueeScrollInterval,   // Time interval between scroll steps
+        page,                     // End page
+        0x00,                     // Dummy byte
+        0xFF,                     // Dummy byte
+        DISPLAY_ACTIVATE_SCROLL,
     };
+
     sendCommandList(display, commands, sizeof(commands) / sizeof(commands[0]));
-    sendSingleCommand(display, display->width - 1);
 
-    sendData(display, display->dataControlByte, display->width * display->height / 8);
+    return sizeof(commands) + 1; // Control byte
+}
+
+// Window commands and data go in one transaction. Every command byte is prefixed by its own control byte
+static size_t flushPageWindow(DisplayDevice *display, uint8_t page, uint8_t startCol, uint8_t endCol) {
+    uint8_t header[] = {
+        kSingleCommandControlByte, DISPLAY_PAGEADDR,
+        kSingleCommandControlByte, page,       // Page start address
+        kSingleCommandControlByte, page,       // Page end address
+        kSingleCommandControlByte, DISPLAY_COLUMNADDR,
+        kSingleCommandControlByte, startCol,   // Column start address
+        kSingleCommandControlByte, endCol - 1, // Column end address
+        kDataControlByte,
+    };
+
+    i2c_master_transmit_multi_buffer_info_t windowBuffer[] = {
+        {.write_buffer = header, .buffer_size = sizeof(header)},
+        {.write_buffer = display->frontBuffer + page * display->width + startCol, .buffer_size = endCol - startCol},
+    };
+
+    size_t bufferSize = sizeof(windowBuffer) / sizeof(windowBuffer[0]);
+
+    ESP_ERROR_CHECK(i2c_master_multi_buffer_transmit(display->device.handle, windowBuffer, bufferSize, -1));
+
+    return sizeof(header) + endCol - startCol;
+}
+
+// Column of 8 pixels starting from y. Unaligned column is split between two pages as one 16-bit word
+static void writeColumnBits(DisplayDevice *display, uint8_t x, uint8_t y, uint8_t bits) {
+    uint8_t page = y / 8;
+    uint8_t shift = y & 7;
+
+    uint16_t mask = 0xFF << shift;
+    uint16_t value = bits << shift;
+
+    uint8_t *lowerByte = &display->buffer[x + page * display->width];
+    writeBufferByte(display, page, x, (*lowerByte & ~mask) | value);
+
+    if (shift != 0 && page + 1 < display->height / 8) {
+        uint8_t *upperByte = lowerByte + display->width;
+        writeBufferByte(display, page + 1, x, (*upperByte & ~(mask >> 8)) | (value >> 8));
+    }
+}
+
+static void writeBufferByte(DisplayDevice *display, uint8_t page, uint8_t col, uint8_t value) {
+    uint8_t *bufferByte = &display->buffer[col + page * display->width];
+
+    // Redrawing the same content doesn't cost bus time
+    if (*bufferByte == value) {
+        return;
+    }
+
+    *bufferByte = value;
+    markDirty(display, page, col, col + 1);
+}
+
+static void markDirty(DisplayDevice *display, uint8_t page, uint8_t startCol, uint8_t endCol) {
+    if (startCol < display->dirtyStartCol[page]) {
+        display->dirtyStartCol[page] = startCol;
+    }
+
+    if (endCol > display->dirtyEndCol[page]) {
+        display->dirtyEndCol[page] = endCol;
+    }
+}
+
+// Charge pump is turned off too, so the panel draws almost nothing. GDDRAM content is kept
+void setDisplayPower(DisplayDevice *display, bool isOn) {
+    assert(display);
+
+    uint8_t onCommands[] = {
+        DISPLAY_CHARGEPUMP,
+        0x14, // Enable charge pump
+        DISPLAY_DISPLAYON,
+    };
+
+    uint8_t offCommands[] = {
+        DISPLAY_DISPLAYOFF,
+        DISPLAY_CHARGEPUMP,
+        0x10, // Disable charge pump
+    };
+
+    if (isOn) {
+        sendCommandList(display, onCommands, sizeof(onCommands) / sizeof(onCommands[0]));
+    } else {
+        sendCommandList(display, offCommands, sizeof(offCommands) / sizeof(offCommands[0]));
+    }
 }
 
 void sendCommandList(DisplayDevice *display, uint8_t *commands, size_t len) {
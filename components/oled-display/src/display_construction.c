@@ -20,14 +20,33 @@ void initDisplay(DisplayDevice *display, I2CDevice *i2cDevice, DisplayType type)
 
     size_t bufferSize = display->width * display->height / 8;
 
-    display->dataControlByte = (uint8_t *) calloc(bufferSize + 1, sizeof(uint8_t));
-    display->buffer = display->dataControlByte + 1;
+    display->buffer = (uint8_t *) calloc(bufferSize, sizeof(uint8_t));
+    display->frontBuffer = (uint8_t *) calloc(bufferSize, sizeof(uint8_t));
+    assert(display->buffer && display->frontBuffer);
 
-    *display->dataControlByte = kDataControlByte;
+    display->bufferMutex = xSemaphoreCreateMutex();
+    assert(display->bufferMutex);
+
+    display->marqueePage = kDisplayNoMarquee;
+    display->activeMarqueePage = kDisplayNoMarquee;
+
+    display->stats = (DisplayStats){};
+
+    assert(display->height / 8 <= kDisplayMaxPages);
+
+    for (uint8_t page = 0; page < kDisplayMaxPages; page++) {
+        display->dirtyStartCol[page] = display->width;
+        display->dirtyEndCol[page] = 0;
+    }
 
     displayInitSequence(display);
 
+    xTaskCreate(displayFlushTask, "DisplayFlushTask", kDisplayFlushTaskStackDepth, display, kDisplayFlushTaskPriority,
+                &display->flushTask);
+    assert(display->flushTask);
+
     clearBuffer(display); // Calloc should clear the buffer, but it behaves strange in esp32 libc implementation
+    invalidateDisplay(display); // GDDRAM content is random after power on
     displayBuffer(display);
 }
 
@@ -115,9 +134,17 @@ void destroyDisplay(DisplayDevice *display) {
         return;
     }
 
+    vTaskDelete(display->flushTask);
+    display->flushTask = NULL;
+
     destroyDevice(&display->device);
 
+    vSemaphoreDelete(display->bufferMutex);
+    display->bufferMutex = NULL;
+
     free(display->buffer);
+    free(display->frontBuffer);
+    display->buffer = display->frontBuffer = NULL;
 
     display->width = display->height = 0;
 }
@@ -0,0 +1,181 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "display.h"
+
+static bool clipRange(int16_t *start, int16_t *len, int16_t limit);
+static void mergeBits(DisplayDevice *display, int16_t page, uint8_t col, uint8_t mask, uint8_t value);
+
+// Spans are rectangles one pixel thick. They share the page masks of fillRect
+void drawHorizontalSpan(DisplayDevice *display, int16_t x, int16_t y, int16_t width, DisplayColor color) {
+    fillRect(display, x, y, width, 1, color);
+}
+
+void drawVerticalSpan(DisplayDevice *display, int16_t x, int16_t y, int16_t height, DisplayColor color) {
+    fillRect(display, x, y, 1, height, color);
+}
+
+// Mask is computed once for every page and applied to the whole byte of each column
+void fillRect(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height, DisplayColor color) {
+    assert(display);
+
+    if (!clipRange(&x, &width, display->width) || !clipRange(&y, &height, display->height)) {
+        return;
+    }
+
+    uint8_t firstPage = y / 8;
+    uint8_t lastPage = (y + height - 1) / 8;
+
+    for (uint8_t page = firstPage; page <= lastPage; page++) {
+        uint8_t topBit = (page == firstPage ? y & 7 : 0);
+        uint8_t bottomBit = (page == lastPage ? (y + height - 1) & 7 : 7);
+        uint8_t mask = (0xFF << topBit) & (0xFF >> (7 - bottomBit));
+
+        for (int16_t col = x; col < x + width; col++) {
+            applyBufferMask(display, page, col, mask, color);
+        }
+    }
+}
+
+void invertRect(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height) {
+    fillRect(display, x, y, width, height, DISPLAY_COLOR_INVERSE);
+}
+
+// Vertical sides don't include corners, so inverse color doesn't toggle them twice
+void drawRect(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height, DisplayColor color) {
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    drawHorizontalSpan(display, x, y, width, color);
+
+    if (height > 1) {
+        drawHorizontalSpan(display, x, y + height - 1, width, color);
+    }
+
+    drawVerticalSpan(display, x, y + 1, height - 2, color);
+
+    if (width > 1) {
+        drawVerticalSpan(display, x + width - 1, y + 1, height - 2, color);
+    }
+}
+
+// Bresenham. Axis aligned lines go through the spans
+void drawLine(DisplayDevice *display, int16_t x0, int16_t y0, int16_t x1, int16_t y1, DisplayColor color) {
+    assert(display);
+
+    if (y0 == y1) {
+        drawHorizontalSpan(display, (x0 < x1 ? x0 : x1), y0, abs(x1 - x0) + 1, color);
+        return;
+    }
+
+    if (x0 == x1) {
+        drawVerticalSpan(display, x0, (y0 < y1 ? y0 : y1), abs(y1 - y0) + 1, color);
+        return;
+    }
+
+    int16_t dx = abs(x1 - x0);
+    int16_t dy = -abs(y1 - y0);
+    int16_t stepX = (x0 < x1 ? 1 : -1);
+    int16_t stepY = (y0 < y1 ? 1 : -1);
+    int16_t error = dx + dy;
+
+    while (true) {
+        if (x0 >= 0 && x0 < display->width && y0 >= 0 && y0 < display->height) {
+            setPixel(display, x0, y0, color);
+        }
+
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+
+        int16_t doubledError = 2 * error;
+
+        if (doubledError >= dy) {
+            error += dy;
+            x0 += stepX;
+        }
+
+        if (doubledError <= dx) {
+            error += dx;
+            y0 += stepY;
+        }
+    }
+}
+
+// Bitmap has the layout of the display buffer: bytes are 8 pixel columns, pages follow each other.
+// Bitmap is opaque, its unset bits clear the buffer
+void drawBitmap(DisplayDevice *display, const uint8_t *bitmap, int16_t x, int16_t y, uint8_t width, uint8_t height) {
+    assert(display);
+    assert(bitmap);
+
+    uint8_t bitmapPages = (height + 7) / 8;
+
+    for (uint8_t bitmapPage = 0; bitmapPage < bitmapPages; bitmapPage++) {
+        int16_t top = y + bitmapPage * 8;
+
+        if (top >= display->height || top + 8 <= 0) {
+            continue;
+        }
+
+        // Last page of the bitmap may be partial
+        uint8_t validBits = (bitmapPage == bitmapPages - 1 && (height & 7) != 0 ? height & 7 : 8);
+        uint16_t mask = (0xFF >> (8 - validBits)) << (top & 7);
+
+        int16_t page = top >> 3; // Floor division, top may be negative
+
+        for (uint8_t bitmapCol = 0; bitmapCol < width; bitmapCol++) {
+            int16_t col = x + bitmapCol;
+
+            if (col < 0 || col >= display->width) {
+                continue;
+            }
+
+            uint16_t value = bitmap[bitmapCol + bitmapPage * width] << (top & 7);
+
+            mergeBits(display, page, col, mask, value);
+            mergeBits(display, page + 1, col, mask >> 8, value >> 8);
+        }
+    }
+}
+
+// Outlined bar filled by value / maxValue. Used for meters and progress
+void drawBar(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height, uint16_t value, uint16_t maxValue) {
+    if (width < 3 || height < 3 || maxValue == 0) {
+        return;
+    }
+
+    value = (value < maxValue ? value : maxValue);
+
+    int16_t innerWidth = width - 2;
+    int16_t filledWidth = (int32_t)innerWidth * value / maxValue;
+
+    drawRect(display, x, y, width, height, DISPLAY_COLOR_WHITE);
+    fillRect(display, x + 1, y + 1, filledWidth, height - 2, DISPLAY_COLOR_WHITE);
+    fillRect(display, x + 1 + filledWidth, y + 1, innerWidth - filledWidth, height - 2, DISPLAY_COLOR_BLACK);
+}
+
+// Returns false if nothing is left after clipping to [0, limit)
+static bool clipRange(int16_t *start, int16_t *len, int16_t limit) {
+    if (*start < 0) {
+        *len += *start;
+        *start = 0;
+    }
+
+    if (*start + *len > limit) {
+        *len = limit - *start;
+    }
+
+    return *len > 0;
+}
+
+static void mergeBits(DisplayDevice *display, int16_t page, uint8_t col, uint8_t mask, uint8_t value) {
+    if (page < 0 || page >= display->height / 8 || mask == 0) {
+        return;
+    }
+
+    applyBufferMask(display, page, col, mask & ~value, DISPLAY_COLOR_BLACK);
+    applyBufferMask(display, page, col, mask & value, DISPLAY_COLOR_WHITE);
+}
@@ -0,0 +1,160 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "widget.h"
+#include "display.h"
+
+static void initWidget(Widget *widget, WidgetType type);
+static bool renderList(DisplayDevice *display, Widget *widget);
+
+void initLabelWidget(Widget *widget, const char *text) {
+    assert(text);
+
+    initWidget(widget, WIDGET_LABEL);
+    widget->label.text = text;
+}
+
+void initValueWidget(Widget *widget, const char *format, int32_t value) {
+    assert(format);
+
+    initWidget(widget, WIDGET_VALUE);
+    widget->value.format = format;
+    widget->value.value = value;
+}
+
+void initListWidget(Widget *widget, Widget **items, uint8_t itemsCount, uint8_t rowsCount) {
+    assert(items);
+
+    initWidget(widget, WIDGET_LIST);
+    widget->list.items = items;
+    widget->list.itemsCount = itemsCount;
+    widget->list.firstItem = 0;
+    widget->list.rowsCount = rowsCount;
+}
+
+// List bounds are the bounds of its first row
+void setWidgetBounds(Widget *widget, uint8_t row, uint8_t leftBorder, uint8_t rightBorder, DisplayAlignment alignment) {
+    assert(widget);
+
+    widget->row = row;
+    widget->leftBorder = leftBorder;
+    widget->rightBorder = rightBorder;
+    widget->alignment = alignment;
+    widget->isDirty = true;
+}
+
+void setLabelText(Widget *widget, const char *text) {
+    assert(widget && widget->type == WIDGET_LABEL);
+    assert(text);
+
+    if (widget->label.text == text || strcmp(widget->label.text, text) == 0) {
+        widget->label.text = text;
+        return;
+    }
+
+    widget->label.text = text;
+    widget->isDirty = true;
+}
+
+void setWidgetValue(Widget *widget, int32_t value) {
+    assert(widget && widget->type == WIDGET_VALUE);
+
+    if (widget->value.value == value) {
+        return;
+    }
+
+    widget->value.value = value;
+    widget->isDirty = true;
+}
+
+void setListFirstItem(Widget *widget, uint8_t firstItem) {
+    assert(widget && widget->type == WIDGET_LIST);
+
+    if (widget->list.firstItem == firstItem) {
+        return;
+    }
+
+    widget->list.firstItem = firstItem;
+    widget->isDirty = true;
+}
+
+void invalidateWidget(Widget *widget) {
+    assert(widget);
+
+    widget->isDirty = true;
+}
+
+bool renderWidget(DisplayDevice *display, Widget *widget) {
+    assert(display);
+    assert(widget);
+
+    if (widget->type == WIDGET_LIST) {
+        return renderList(display, widget);
+    }
+
+    if (!widget->isDirty) {
+        return false;
+    }
+
+    char text[kWidgetTextMaxLen];
+    const char *shownText = text;
+    int textLen = 0;
+
+    switch (widget->type) {
+    case WIDGET_LABEL:
+        shownText = widget->label.text;
+        textLen = strlen(shownText);
+        break;
+    case WIDGET_VALUE:
+        textLen = snprintf(text, sizeof(text), widget->value.format, widget->value.value);
+        textLen = (textLen < (int)sizeof(text) ? textLen : (int)sizeof(text) - 1);
+        break;
+    case WIDGET_LIST:
+        break;
+    }
+
+    drawString(display, shownText, textLen, widget->row, widget->leftBorder, widget->rightBorder, widget->alignment);
+    widget->isDirty = false;
+
+    return true;
+}
+
+static void initWidget(Widget *widget, WidgetType type) {
+    assert(widget);
+
+    memset(widget, 0, sizeof(*widget));
+    widget->type = type;
+    widget->alignment = ALIGNMENT_LEFT;
+    widget->isDirty = true;
+}
+
+// Dirty list lays out its items again. Otherwise only dirty items are drawn
+static bool renderList(DisplayDevice *display, Widget *widget) {
+    bool isRelayout = widget->isDirty;
+    bool isDrawn = false;
+
+    for (uint8_t row = 0; row < widget->list.rowsCount; row++) {
+        uint8_t itemIdx = widget->list.firstItem + row;
+
+        if (itemIdx >= widget->list.itemsCount) {
+            if (isRelayout) {
+                eraseRowPart(display, widget->row + row, widget->leftBorder, widget->rightBorder);
+                isDrawn = true;
+            }
+            continue;
+        }
+
+        Widget *item = widget->list.items[itemIdx];
+
+        if (isRelayout) {
+            setWidgetBounds(item, widget->row + row, widget->leftBorder, widget->rightBorder, widget->alignment);
+        }
+
+        isDrawn |= renderWidget(display, item);
+    }
+
+    widget->isDirty = false;
+
+    return isDrawn;
+}
@@ -0,0 +1,591 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bt_lib.h"
+#include "esp_log.h"
+#include "fake_bt.h"
+#include "fake_call_log.h"
+#include "fake_esp.h"
+#include "fake_rtos.h"
+#include "nvs_flash.h"
+#include "peer_storage.h"
+
+// Feeds sequences of stack events, user calls and timer ticks to bt_lib and checks the invariants after each step.
+// Every case runs in a forked process, because bt_lib keeps its state in statics. Cases which reach new basic
+// blocks of bt_lib are kept and mutated, so the event orderings are explored by coverage, like AFL does.
+//
+//   fuzz_bt_events --seed <seed> --runs <count>  Generates cases. Failed ones are saved to fuzz-<seed>-<run>.bin
+//   fuzz_bt_events <case.bin>                     Replays a saved case
+//
+// Failures are injected only into the calls whose errors bt_lib handles. ESP_ERROR_CHECK sites abort by design
+
+#define kCaseMinLen (16)
+#define kCaseMaxLen (512)
+#define kCorpusMaxSize (512)
+#define kCoverageMapBits (16)
+#define kCoverageMapSize (1 << kCoverageMapBits)
+#define kPeersCount (4)
+#define kRecentCallsCount (24) // Printed when an invariant is broken
+
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    size_t offset;
+} CaseReader;
+
+typedef struct {
+    size_t scannedCalls;         // Call log entries which have been checked
+    int outstandingNameRequests; // Remote name requests without reply
+    int volumesInFlight;
+    int64_t lastVolumeSentUs;
+} InvariantState;
+
+typedef struct {
+    uint8_t data[kCaseMaxLen];
+    size_t length;
+} CorpusEntry;
+
+static uint8_t *coverageMap = NULL; // Blocks reached by the running case. Shared between the parent and the case
+static uint8_t totalCoverage[kCoverageMapSize];
+
+static CorpusEntry corpus[kCorpusMaxSize];
+static size_t corpusCount = 0;
+
+static const esp_bd_addr_t peers[kPeersCount] = {
+    { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 },
+    { 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 },
+    { 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 },
+    { 0x44, 0x55, 0x66, 0x77, 0x88, 0x99 },
+};
+
+static int32_t audioDataCallback(AudioFrame *frames, int32_t framesCount) {
+    memset(frames, 0, framesCount * sizeof(AudioFrame));
+    return framesCount / 2; // Half of the requests starve
+}
+
+static uint8_t nextByte(CaseReader *reader) {
+    return reader->offset < reader->length ? reader->data[reader->offset++] : 0;
+}
+
+static void injectDiscoveryResult(CaseReader *reader) {
+    esp_bt_gap_cb_param_t param = {};
+    memcpy(param.disc_res.bda, peers[nextByte(reader) % kPeersCount], ESP_BD_ADDR_LEN);
+
+    uint8_t flags = nextByte(reader);
+    uint32_t deviceClass = (flags & 1) ? 0x240404 : 0x5a020c;
+    int8_t rssi = -40 - nextByte(reader) % 60;
+    uint8_t eir[240] = {};
+
+    // Malformed EIR lengths are valid fuzz input too
+    if (flags & 2) {
+        eir[0] = nextByte(reader) % 16;
+        eir[1] = (flags & 4) ? ESP_BT_EIR_TYPE_CMPL_LOCAL_NAME : ESP_BT_EIR_TYPE_SHORT_LOCAL_NAME;
+        memset(&eir[2], 'a' + flags % 26, 14);
+    }
+
+    esp_bt_gap_dev_prop_t properties[] = {
+        { .type = ESP_BT_GAP_DEV_PROP_COD, .len = sizeof(deviceClass), .val = &deviceClass },
+        { .type = ESP_BT_GAP_DEV_PROP_RSSI, .len = sizeof(rssi), .val = &rssi },
+        { .type = ESP_BT_GAP_DEV_PROP_EIR, .len = sizeof(eir), .val = eir },
+    };
+
+    param.disc_res.prop = properties;
+    param.disc_res.num_prop = (flags & 2) ? 3 : 2;
+
+    injectGapEvent(ESP_BT_GAP_DISC_RES_EVT, &param);
+}
+
+static void injectRemoteName(CaseReader *reader) {
+    esp_bt_gap_cb_param_t param = {};
+    memcpy(param.read_rmt_name.bda, peers[nextByte(reader) % kPeersCount], ESP_BD_ADDR_LEN);
+
+    param.read_rmt_name.stat = nextByte(reader) % 4 == 0 ? ESP_BT_STATUS_FAIL : ESP_BT_STATUS_SUCCESS;
+    memset(param.read_rmt_name.rmt_name, 'n', nextByte(reader) % 32);
+
+    recordFakeCall("inject remote name");
+    injectGapEvent(ESP_BT_GAP_READ_REMOTE_NAME_EVT, &param);
+}
+
+static void runStep(CaseReader *reader, InvariantState *state) {
+    uint8_t operation = nextByte(reader) % 20;
+    uint8_t argument = nextByte(reader);
+
+    // Steps are logged along with the calls, so a dump of the failed case can be read without the replay
+    recordFakeCall("step %u %u", operation, argument);
+
+    switch (operation) {
+    case 0: {
+        DiscoveryConfig config = {
+            .inquiryDuration = 1 + argument % 10,
+            .maxRenderingDevices = argument % 3,
+            .stopOnKnownPeer = argument & 0x80,
+        };
+        startDiscovery(&config);
+        break;
+    }
+
+    case 1: {
+        PeerDeviceData peer = { .name = "Peer", .nameLen = 4 };
+        memcpy(peer.address, peers[argument % kPeersCount], ESP_BD_ADDR_LEN);
+        connectToDevice(&peer);
+        break;
+    }
+
+    case 2:
+        connectToLastPeer();
+        break;
+
+    case 3:
+        disconnectFromDevice();
+        break;
+
+    case 4:
+        startAudio();
+        break;
+
+    case 5:
+        stopAudio();
+        break;
+
+    case 6:
+        if (argument & 1) {
+            failNextFakeBtCall("esp_avrc_ct_send_set_absolute_volume_cmd");
+        }
+        setVolume(argument % 110);
+        break;
+
+    case 7: {
+        esp_bt_gap_cb_param_t param = {
+            .disc_st_chg.state = argument & 1 ? ESP_BT_GAP_DISCOVERY_STARTED : ESP_BT_GAP_DISCOVERY_STOPPED,
+        };
+
+        if (argument & 2) {
+            failNextFakeBtCall("esp_bt_gap_read_remote_name");
+        }
+        injectGapEvent(ESP_BT_GAP_DISC_STATE_CHANGED_EVT, &param);
+        break;
+    }
+
+    case 8:
+    case 9:
+        reader->offset--;
+        injectDiscoveryResult(reader);
+        break;
+
+    case 10:
+        reader->offset--;
+        injectRemoteName(reader);
+        break;
+
+    case 11: {
+        esp_a2d_cb_param_t param = { .conn_stat.state = argument % 4 };
+        injectA2dpEvent(ESP_A2D_CONNECTION_STATE_EVT, &param);
+        break;
+    }
+
+    case 12: {
+        esp_a2d_cb_param_t param = {
+            .media_ctrl_stat.cmd = argument % 4,
+            .media_ctrl_stat.status = (argument >> 2) % 3,
+        };
+        injectA2dpEvent(ESP_A2D_MEDIA_CTRL_ACK_EVT, &param);
+        break;
+    }
+
+    case 13: {
+        esp_a2d_cb_param_t param = { .audio_stat.state = argument & 1 };
+        injectA2dpEvent(argument & 2 ? ESP_A2D_AUDIO_STATE_EVT : ESP_A2D_REPORT_SNK_DELAY_VALUE_EVT, &param);
+        break;
+    }
+
+    case 14: {
+        esp_avrc_ct_cb_param_t param = { .conn_stat.connected = argument & 1 };
+        memcpy(param.conn_stat.remote_bda, peers[0], ESP_BD_ADDR_LEN);
+
+        // Queued commands are sent before the event is handled, so the invariant is reset at the logged mark
+        if (!param.conn_stat.connected) {
+            runFakeDispatchers();
+            recordFakeCall("inject volume reset");
+        }
+        injectAvrcEvent(ESP_AVRC_CT_CONNECTION_STATE_EVT, &param);
+        break;
+    }
+
+    case 15: {
+        esp_avrc_ct_cb_param_t param = {};
+        param.get_rn_caps_rsp.evt_set.bits = argument & 1 ? 1u << ESP_AVRC_RN_VOLUME_CHANGE : 0;
+        injectAvrcEvent(ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT, &param);
+        break;
+    }
+
+    case 16: {
+        // Sink responds only to the sent commands. Late response after the timeout is still possible
+        if (state->volumesInFlight == 0) {
+            break;
+        }
+
+        esp_avrc_ct_cb_param_t param = { .set_volume_rsp.volume = argument % 128 };
+        runFakeDispatchers();
+        recordFakeCall("inject volume reset");
+        injectAvrcEvent(ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT, &param);
+        break;
+    }
+
+    case 17: {
+        esp_avrc_ct_cb_param_t param = {};
+        param.change_ntf.event_id = ESP_AVRC_RN_VOLUME_CHANGE;
+        param.change_ntf.event_parameter.volume = argument % 128;
+        injectAvrcEvent(ESP_AVRC_CT_CHANGE_NOTIFY_EVT, &param);
+        break;
+    }
+
+    case 18: {
+        esp_bt_gap_cb_param_t param = {
+            .read_rssi_delta.stat = ESP_BT_STATUS_SUCCESS,
+            .read_rssi_delta.rssi_delta = (int8_t)argument,
+        };
+        injectGapEvent(ESP_BT_GAP_READ_RSSI_DELTA_EVT, &param);
+
+        uint8_t buffer[256];
+        requestFakeA2dpData(buffer, argument);
+        break;
+    }
+
+    case 19:
+        // Some events are left in the dispatcher queues to race with the next ones
+        advanceFakeTime((argument % 64) * 50);
+        return;
+    }
+
+    if (argument & 0x40) {
+        runFakeDispatchers();
+    }
+}
+
+static void dumpRecentCalls(void) {
+    size_t callsCount = getFakeCallsCount();
+    size_t startIndex = callsCount > kRecentCallsCount ? callsCount - kRecentCallsCount : 0;
+
+    fprintf(stderr, "Last calls:\n");
+
+    for (size_t callIdx = startIndex; callIdx < callsCount; callIdx++) {
+        fprintf(stderr, "    %s\n", getFakeCall(callIdx));
+    }
+}
+
+static bool checkInvariants(InvariantState *state) {
+    BluetoothDeviceSnapshot snapshot;
+    getBtDeviceSnapshot(&snapshot);
+
+    // Streaming PM lock is held once per session and released with it
+    int pmLockCount = getFakePmLockCount("bt_streaming");
+
+    if (pmLockCount != (snapshot.audioState != AUDIO_STATE_IDLE)) {
+        fprintf(stderr, "PM lock count %d with audio state %d\n", pmLockCount, snapshot.audioState);
+        return false;
+    }
+
+    if (snapshot.deviceState != DEVICE_STATE_CONNECTED && snapshot.audioState != AUDIO_STATE_IDLE) {
+        fprintf(stderr, "Audio state %d without connection (device state %d)\n", snapshot.audioState,
+                snapshot.deviceState);
+        return false;
+    }
+
+    for (; state->scannedCalls < getFakeCallsCount(); state->scannedCalls++) {
+        const char *call = getFakeCall(state->scannedCalls);
+        bool isFailed = strstr(call, " failed") != NULL;
+
+        // Remote name is handled synchronously by the GAP callback, volume events are marked after the queues are drained
+        if (strcmp(call, "inject remote name") == 0) {
+            state->outstandingNameRequests = 0;
+        }
+
+        if (strcmp(call, "inject volume reset") == 0) {
+            state->volumesInFlight = 0;
+        }
+
+        // Failed call is logged twice: as the call and as its failure
+        if (strncmp(call, "esp_bt_gap_read_remote_name", strlen("esp_bt_gap_read_remote_name")) == 0) {
+            state->outstandingNameRequests += isFailed ? -1 : 1;
+        }
+
+        if (strncmp(call, "esp_avrc_ct_send_set_absolute_volume_cmd",
+                    strlen("esp_avrc_ct_send_set_absolute_volume_cmd")) == 0 && isFailed) {
+            state->volumesInFlight = 0;
+            continue;
+        }
+
+        if (state->outstandingNameRequests > 1) {
+            fprintf(stderr, "Remote name is requested while another request is active\n");
+            return false;
+        }
+
+        if (strncmp(call, "esp_avrc_ct_send_set_absolute_volume_cmd",
+                    strlen("esp_avrc_ct_send_set_absolute_volume_cmd")) == 0) {
+            int64_t now = getFakeCallTime(state->scannedCalls);
+            bool isTimedOut = now - state->lastVolumeSentUs >= kVolumeResponseTimeoutMs * 1000;
+
+            if (state->volumesInFlight > 0 && !isTimedOut) {
+                fprintf(stderr, "Absolute volume is sent while another command is in flight\n");
+                return false;
+            }
+
+            state->volumesInFlight = 1;
+            state->lastVolumeSentUs = now;
+        }
+    }
+
+    // Fuzzer doesn't match the log, so it's dropped before it overflows
+    if (getFakeCallsCount() > kFakeCallLogSize / 2) {
+        clearFakeCalls();
+        state->scannedCalls = 0;
+    }
+
+    return true;
+}
+
+static int runCase(const uint8_t *data, size_t length) {
+    static BluetoothDeviceCallbacks callbacks = {
+        .audioDataCallback = audioDataCallback,
+    };
+
+    CaseReader reader = { .data = data, .length = length, .offset = 0 };
+    InvariantState state = {};
+
+    // First byte decides whether there is a last peer to reconnect to
+    if (nextByte(&reader) & 1) {
+        PeerDeviceData peer = { .name = "Last", .nameLen = 4 };
+        memcpy(peer.address, peers[0], ESP_BD_ADDR_LEN);
+
+        nvs_handle_t handle;
+        nvs_flash_init();
+        nvs_open(kPeerStorageNamespace, NVS_READWRITE, &handle);
+        nvs_set_blob(handle, kLastPeerKey, &peer, sizeof(peer));
+        nvs_close(handle);
+    }
+
+    initBtDevice(&callbacks);
+    startBtDevice();
+    runFakeDispatchers();
+
+    while (reader.offset < reader.length) {
+        runStep(&reader, &state);
+
+        if (!checkInvariants(&state)) {
+            dumpRecentCalls();
+            return EXIT_FAILURE;
+        }
+    }
+
+    runFakeDispatchers();
+
+    if (!checkInvariants(&state)) {
+        dumpRecentCalls();
+        return EXIT_FAILURE;
+    }
+
+    shutdownBtDevice();
+    return EXIT_SUCCESS;
+}
+
+// Called at every basic block of the bt_lib sources built with -fsanitize-coverage=trace-pc. The map is shared
+// with the parent, so it sees the coverage of the forked case
+void __sanitizer_cov_trace_pc(void) {
+    if (!coverageMap) {
+        return;
+    }
+
+    uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+    coverageMap[(pc ^ (pc >> kCoverageMapBits)) & (kCoverageMapSize - 1)] = 1;
+}
+
+// Returns the number of blocks which no case has reached before
+static uint32_t mergeCoverage(void) {
+    uint32_t newBlocksCount = 0;
+
+    for (size_t blockIdx = 0; blockIdx < kCoverageMapSize; blockIdx++) {
+        if (coverageMap[blockIdx] && !totalCoverage[blockIdx]) {
+            totalCoverage[blockIdx] = 1;
+            newBlocksCount++;
+        }
+    }
+
+    return newBlocksCount;
+}
+
+static bool runForked(const uint8_t *data, size_t length) {
+    memset(coverageMap, 0, kCoverageMapSize);
+    fflush(NULL);
+
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0) {
+        _exit(runCase(data, length));
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+// xorshift32. Same seed gives the same cases on every host
+static uint32_t nextRandom(uint32_t *state) {
+    uint32_t value = *state;
+
+    value ^= value << 13;
+    value ^= value >> 17;
+    value ^= value << 5;
+
+    *state = value;
+    return value;
+}
+
+// Case is a sequence of steps, so the mutations work on both the bytes and the step pairs
+static size_t mutateCase(uint8_t *data, size_t length, uint32_t *randomState) {
+    uint32_t mutationsCount = 1 + nextRandom(randomState) % 4;
+
+    for (uint32_t mutationIdx = 0; mutationIdx < mutationsCount; mutationIdx++) {
+        size_t position = nextRandom(randomState) % length;
+
+        switch (nextRandom(randomState) % 5) {
+        case 0:
+            data[position] ^= 1u << (nextRandom(randomState) % 8);
+            break;
+
+        case 1:
+            data[position] = nextRandom(randomState);
+            break;
+
+        case 2: // Insert a random step
+            if (length + 2 <= kCaseMaxLen) {
+                memmove(&data[position + 2], &data[position], length - position);
+                data[position] = nextRandom(randomState);
+                data[position + 1] = nextRandom(randomState);
+                length += 2;
+            }
+            break;
+
+        case 3: // Remove a step
+            if (length > position + 2 && length > kCaseMinLen) {
+                memmove(&data[position], &data[position + 2], length - position - 2);
+                length -= 2;
+            }
+            break;
+
+        case 4: // Repeat a step, e.g. a duplicated ACK
+            if (length + 2 <= kCaseMaxLen && position + 2 <= length) {
+                memmove(&data[position + 2], &data[position], length - position);
+                length += 2;
+            }
+            break;
+        }
+    }
+
+    return length;
+}
+
+static void saveFailedCase(const uint8_t *data, size_t length, uint32_t seed, uint32_t run) {
+    char path[64];
+    snprintf(path, sizeof(path), "fuzz-%" PRIu32 "-%" PRIu32 ".bin", seed, run);
+
+    FILE *file = fopen(path, "wb");
+
+    if (file) {
+        fwrite(data, 1, length, file);
+        fclose(file);
+    }
+
+    fprintf(stderr, "Case %" PRIu32 " failed, saved to %s\n", run, path);
+}
+
+static int replayCase(const char *path) {
+    uint8_t data[kCaseMaxLen];
+    FILE *file = fopen(path, "rb");
+
+    if (!file) {
+        fprintf(stderr, "Unable to open case %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    size_t length = fread(data, 1, sizeof(data), file);
+    fclose(file);
+
+    return runCase(data, length);
+}
+
+int main(int argc, char **argv) {
+    if (argc == 2) {
+        return replayCase(argv[1]);
+    }
+
+    if (argc != 5 || strcmp(argv[1], "--seed") != 0 || strcmp(argv[3], "--runs") != 0) {
+        fprintf(stderr, "Usage: %s --seed <seed> --runs <count> | %s <case.bin>\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t seed = strtoul(argv[2], NULL, 10);
+    uint32_t runsCount = strtoul(argv[4], NULL, 10);
+    uint32_t randomState = seed != 0 ? seed : 1;
+    uint32_t failuresCount = 0;
+    uint32_t coveredBlocksCount = 0;
+
+    // Expected errors of the injected failures would hide the reports of the failed cases
+    esp_log_level_set("*", ESP_LOG_NONE);
+
+    coverageMap = mmap(NULL, kCoverageMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (coverageMap == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t run = 0; run < runsCount; run++) {
+        uint8_t data[kCaseMaxLen];
+        size_t length = 0;
+
+        // Mostly mutations of the cases which have reached new code, sometimes a fresh random case
+        if (corpusCount > 0 && nextRandom(&randomState) % 8 != 0) {
+            const CorpusEntry *parent = &corpus[nextRandom(&randomState) % corpusCount];
+
+            memcpy(data, parent->data, parent->length);
+            length = mutateCase(data, parent->length, &randomState);
+        } else {
+            length = kCaseMinLen + nextRandom(&randomState) % (kCaseMaxLen - kCaseMinLen);
+
+            for (size_t byteIdx = 0; byteIdx < length; byteIdx++) {
+                data[byteIdx] = nextRandom(&randomState);
+            }
+        }
+
+        if (!runForked(data, length)) {
+            saveFailedCase(data, length, seed, run);
+            failuresCount++;
+            continue;
+        }
+
+        uint32_t newBlocksCount = mergeCoverage();
+        coveredBlocksCount += newBlocksCount;
+
+        if (newBlocksCount > 0 && corpusCount < kCorpusMaxSize) {
+            memcpy(corpus[corpusCount].data, data, length);
+            corpus[corpusCount].length = length;
+            corpusCount++;
+        }
+    }
+
+    printf("%" PRIu32 " cases, %" PRIu32 " failures, %" PRIu32 " blocks covered, corpus of %zu cases\n", runsCount,
+           failuresCount, coveredBlocksCount, corpusCount);
+
+    return failuresCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
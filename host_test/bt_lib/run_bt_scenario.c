@@ -0,0 +1,673 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bt_lib.h"
+#include "esp_log.h"
+#include "fake_bt.h"
+#include "fake_call_log.h"
+#include "fake_esp.h"
+#include "fake_rtos.h"
+#include "nvs_flash.h"
+#include "peer_storage.h"
+
+// Runs a scripted scenario against bt_lib on top of the fake Bluedroid. One command per line, '#' starts a comment.
+// Injected events and user calls are followed by the dispatchers run unless "auto_pump off" is used, which keeps
+// them queued to model the races between the stack callbacks and the bt_lib tasks.
+//
+// Setup:        store_last_peer <address> <name>, boot, init (boot without startBtDevice), log_level <0..5>
+// User calls:   call <api> [args], call_rejected <api> [args]. Apis: connect <address> <name>, connect_last_peer,
+//               disconnect, start_audio, stop_audio, discovery <duration> <max devices> <stop on known 0|1>,
+//               volume <0..100>, shutdown
+// Stack events: gap_discovery_started, gap_discovery_stopped, gap_result <address> <class hex> <rssi> [name],
+//               gap_remote_name <address> <name|-> (- means failed request), gap_rssi_delta <address> <delta>,
+//               a2d_connection <disconnected|connecting|connected|disconnecting>,
+//               a2d_ack <check_src_rdy|start|suspend> <success|failure|busy>, a2d_data <frames>,
+//               avrc_connection <connected|disconnected> <address>, avrc_caps <event bits hex>,
+//               avrc_volume_rsp <volume>, avrc_volume_notify <volume>
+// Flow:         advance <ms>, pump, auto_pump <on|off>, fail_next <api function name>
+// Checks:       expect <call log prefix> (consumes the log up to the match), expect_none <call log prefix>,
+//               expect_state <device state>, expect_audio <audio state>, expect_volume <0..100>,
+//               expect_nvs_writes <count>, expect_pm_lock <count>, expect_timer <name> <active|stopped>
+//
+// Callbacks of the user are logged as "state <STATE>", "audio <STATE>", "discovered <address> <name>", "volume <level>"
+
+#define kScenarioLineMaxLen (256)
+#define kScenarioArgsMax (8)
+#define kAudioFramesMax (512)
+
+typedef struct {
+    const char *path;
+    unsigned lineNumber;
+    size_t logCursor; // Entries before it have been matched by "expect"
+    bool isAutoPump;
+} ScenarioContext;
+
+typedef bool (*ScenarioCommand)(ScenarioContext *context, int argc, char **argv);
+
+typedef struct {
+    const char *name;
+    int minArgs;
+    ScenarioCommand handler;
+} ScenarioCommandEntry;
+
+static const char *deviceStateNames[] = { "IDLE", "DISCOVERING", "CONNECTING", "CONNECTED", "DISCONNECTING", "DISCONNECTED" };
+static const char *audioStateNames[] = { "IDLE", "STARTING", "STARTED", "STOPPING" };
+
+static bool fail(ScenarioContext *context, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void dumpCallLog(size_t startIndex);
+static bool parseAddress(const char *text, esp_bd_addr_t address);
+static int findName(const char *name, const char **names, size_t namesCount);
+static void pumpIfNeeded(ScenarioContext *context);
+
+static int32_t audioDataCallback(AudioFrame *frames, int32_t framesCount) {
+    memset(frames, 0, framesCount * sizeof(AudioFrame));
+    return framesCount;
+}
+
+static void deviceStateChangedCallback(DeviceState state) {
+    recordFakeCall("state %s", deviceStateNames[state]);
+}
+
+static void audioStateChangedCallback(AudioState state) {
+    recordFakeCall("audio %s", audioStateNames[state]);
+}
+
+static void deviceDiscoveredCallback(PeerDeviceData *peer) {
+    recordFakeCall("discovered %s %s", fakeBdaToStr(peer->address), peer->name);
+}
+
+static void volumeChangedCallback(uint8_t volume) {
+    recordFakeCall("volume %u", volume);
+}
+
+static bool storeLastPeerCommand(ScenarioContext *context, int argc, char **argv) {
+    PeerDeviceData peer = {};
+
+    if (!parseAddress(argv[1], peer.address)) {
+        return fail(context, "bad address %s", argv[1]);
+    }
+
+    peer.nameLen = strlen(argv[2]);
+    memcpy(peer.name, argv[2], peer.nameLen);
+
+    // Written directly, so the boot reads it from NVS like after a power cycle
+    nvs_handle_t handle;
+    nvs_flash_init();
+    nvs_open(kPeerStorageNamespace, NVS_READWRITE, &handle);
+    nvs_set_blob(handle, kLastPeerKey, &peer, sizeof(peer));
+    nvs_close(handle);
+
+    return true;
+}
+
+// Only initializes the device, startBtDevice isn't called
+static bool initCommand(ScenarioContext *context, int argc, char **argv) {
+    static BluetoothDeviceCallbacks callbacks = {
+        .audioDataCallback = audioDataCallback,
+        .deviceStateChangedCallback = deviceStateChangedCallback,
+        .audioStateChangedCallback = audioStateChangedCallback,
+        .deviceDiscoveredCallback = deviceDiscoveredCallback,
+        .volumeChangedCallback = volumeChangedCallback,
+    };
+
+    initBtDevice(&callbacks);
+
+    if (!isFakeBluedroidEnabled()) {
+        return fail(context, "Bluedroid isn't enabled after initBtDevice");
+    }
+
+    return true;
+}
+
+static bool bootCommand(ScenarioContext *context, int argc, char **argv) {
+    if (!initCommand(context, argc, argv)) {
+        return false;
+    }
+
+    startBtDevice();
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool logLevelCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_log_level_set("*", atoi(argv[1]));
+    return true;
+}
+
+static bool runApiCall(ScenarioContext *context, int argc, char **argv, bool *result) {
+    const char *api = argv[1];
+
+    if (strcmp(api, "connect") == 0 && argc >= 4) {
+        PeerDeviceData peer = {};
+
+        if (!parseAddress(argv[2], peer.address)) {
+            return fail(context, "bad address %s", argv[2]);
+        }
+
+        peer.nameLen = strlen(argv[3]);
+        memcpy(peer.name, argv[3], peer.nameLen);
+        *result = connectToDevice(&peer);
+    } else if (strcmp(api, "connect_last_peer") == 0) {
+        *result = connectToLastPeer();
+    } else if (strcmp(api, "disconnect") == 0) {
+        *result = disconnectFromDevice();
+    } else if (strcmp(api, "start_audio") == 0) {
+        *result = startAudio();
+    } else if (strcmp(api, "stop_audio") == 0) {
+        *result = stopAudio();
+    } else if (strcmp(api, "discovery") == 0 && argc >= 5) {
+        DiscoveryConfig config = {
+            .inquiryDuration = atoi(argv[2]),
+            .maxRenderingDevices = atoi(argv[3]),
+            .stopOnKnownPeer = atoi(argv[4]) != 0,
+        };
+        *result = startDiscovery(&config);
+    } else if (strcmp(api, "volume") == 0 && argc >= 3) {
+        *result = setVolume(atoi(argv[2]));
+    } else if (strcmp(api, "shutdown") == 0) {
+        shutdownBtDevice();
+        *result = true;
+    } else {
+        return fail(context, "unknown call %s or missing arguments", api);
+    }
+
+    pumpIfNeeded(context);
+    return true;
+}
+
+static bool callCommand(ScenarioContext *context, int argc, char **argv) {
+    bool result = false;
+
+    if (!runApiCall(context, argc, argv, &result)) {
+        return false;
+    }
+
+    return result || fail(context, "call %s has been rejected", argv[1]);
+}
+
+static bool callRejectedCommand(ScenarioContext *context, int argc, char **argv) {
+    bool result = true;
+
+    if (!runApiCall(context, argc, argv, &result)) {
+        return false;
+    }
+
+    return !result || fail(context, "call %s has been accepted", argv[1]);
+}
+
+static bool gapDiscoveryStartedCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_bt_gap_cb_param_t param = { .disc_st_chg.state = ESP_BT_GAP_DISCOVERY_STARTED };
+
+    injectGapEvent(ESP_BT_GAP_DISC_STATE_CHANGED_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool gapDiscoveryStoppedCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_bt_gap_cb_param_t param = { .disc_st_chg.state = ESP_BT_GAP_DISCOVERY_STOPPED };
+
+    injectGapEvent(ESP_BT_GAP_DISC_STATE_CHANGED_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool gapResultCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_bt_gap_cb_param_t param = {};
+
+    if (!parseAddress(argv[1], param.disc_res.bda)) {
+        return fail(context, "bad address %s", argv[1]);
+    }
+
+    uint32_t deviceClass = strtoul(argv[2], NULL, 16);
+    int8_t rssi = atoi(argv[3]);
+    uint8_t eir[240] = {};
+
+    esp_bt_gap_dev_prop_t properties[] = {
+        { .type = ESP_BT_GAP_DEV_PROP_COD, .len = sizeof(deviceClass), .val = &deviceClass },
+        { .type = ESP_BT_GAP_DEV_PROP_RSSI, .len = sizeof(rssi), .val = &rssi },
+        { .type = ESP_BT_GAP_DEV_PROP_EIR, .len = sizeof(eir), .val = eir },
+    };
+
+    param.disc_res.prop = properties;
+    param.disc_res.num_prop = 2;
+
+    // Name travels in the complete local name field of the extended inquiry response
+    if (argc >= 5) {
+        size_t nameLen = strlen(argv[4]);
+
+        if (nameLen > sizeof(eir) - 3) {
+            return fail(context, "name is too long for EIR");
+        }
+
+        eir[0] = nameLen + 1;
+        eir[1] = ESP_BT_EIR_TYPE_CMPL_LOCAL_NAME;
+        memcpy(&eir[2], argv[4], nameLen);
+        param.disc_res.num_prop = 3;
+    }
+
+    injectGapEvent(ESP_BT_GAP_DISC_RES_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool gapRemoteNameCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_bt_gap_cb_param_t param = {};
+
+    if (!parseAddress(argv[1], param.read_rmt_name.bda)) {
+        return fail(context, "bad address %s", argv[1]);
+    }
+
+    if (strcmp(argv[2], "-") == 0) {
+        param.read_rmt_name.stat = ESP_BT_STATUS_FAIL;
+    } else {
+        param.read_rmt_name.stat = ESP_BT_STATUS_SUCCESS;
+        strncpy((char *)param.read_rmt_name.rmt_name, argv[2], ESP_BT_GAP_MAX_BDNAME_LEN);
+    }
+
+    injectGapEvent(ESP_BT_GAP_READ_REMOTE_NAME_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool gapRssiDeltaCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_bt_gap_cb_param_t param = {};
+
+    if (!parseAddress(argv[1], param.read_rssi_delta.bda)) {
+        return fail(context, "bad address %s", argv[1]);
+    }
+
+    param.read_rssi_delta.stat = ESP_BT_STATUS_SUCCESS;
+    param.read_rssi_delta.rssi_delta = atoi(argv[2]);
+
+    injectGapEvent(ESP_BT_GAP_READ_RSSI_DELTA_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool a2dConnectionCommand(ScenarioContext *context, int argc, char **argv) {
+    static const char *names[] = { "disconnected", "connecting", "connected", "disconnecting" };
+    int state = findName(argv[1], names, sizeof(names) / sizeof(names[0]));
+
+    if (state < 0) {
+        return fail(context, "unknown A2DP connection state %s", argv[1]);
+    }
+
+    esp_a2d_cb_param_t param = { .conn_stat.state = state };
+
+    injectA2dpEvent(ESP_A2D_CONNECTION_STATE_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool a2dAckCommand(ScenarioContext *context, int argc, char **argv) {
+    static const char *commands[] = { "none", "check_src_rdy", "start", "suspend" };
+    static const char *statuses[] = { "success", "failure", "busy" };
+
+    int command = findName(argv[1], commands, sizeof(commands) / sizeof(commands[0]));
+    int status = findName(argv[2], statuses, sizeof(statuses) / sizeof(statuses[0]));
+
+    if (command < 0 || status < 0) {
+        return fail(context, "unknown media control %s or status %s", argv[1], argv[2]);
+    }
+
+    esp_a2d_cb_param_t param = {
+        .media_ctrl_stat.cmd = command,
+        .media_ctrl_stat.status = status,
+    };
+
+    injectA2dpEvent(ESP_A2D_MEDIA_CTRL_ACK_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool a2dDataCommand(ScenarioContext *context, int argc, char **argv) {
+    static AudioFrame frames[kAudioFramesMax];
+    int framesCount = atoi(argv[1]);
+
+    if (framesCount <= 0 || framesCount > kAudioFramesMax) {
+        return fail(context, "frames count should be in [1; %d]", kAudioFramesMax);
+    }
+
+    int32_t length = framesCount * sizeof(AudioFrame);
+
+    if (requestFakeA2dpData((uint8_t *)frames, length) != length) {
+        return fail(context, "data callback hasn't filled %d frames", framesCount);
+    }
+
+    return true;
+}
+
+static bool avrcConnectionCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_avrc_ct_cb_param_t param = { .conn_stat.connected = strcmp(argv[1], "connected") == 0 };
+
+    if (!parseAddress(argv[2], param.conn_stat.remote_bda)) {
+        return fail(context, "bad address %s", argv[2]);
+    }
+
+    injectAvrcEvent(ESP_AVRC_CT_CONNECTION_STATE_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool avrcCapsCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_avrc_ct_cb_param_t param = {};
+
+    param.get_rn_caps_rsp.evt_set.bits = strtoul(argv[1], NULL, 16);
+    param.get_rn_caps_rsp.cap_count = __builtin_popcount(param.get_rn_caps_rsp.evt_set.bits);
+
+    injectAvrcEvent(ESP_AVRC_CT_GET_RN_CAPABILITIES_RSP_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool avrcVolumeRspCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_avrc_ct_cb_param_t param = { .set_volume_rsp.volume = atoi(argv[1]) };
+
+    injectAvrcEvent(ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool avrcVolumeNotifyCommand(ScenarioContext *context, int argc, char **argv) {
+    esp_avrc_ct_cb_param_t param = {};
+
+    param.change_ntf.event_id = ESP_AVRC_RN_VOLUME_CHANGE;
+    param.change_ntf.event_parameter.volume = atoi(argv[1]);
+
+    injectAvrcEvent(ESP_AVRC_CT_CHANGE_NOTIFY_EVT, &param);
+    pumpIfNeeded(context);
+
+    return true;
+}
+
+static bool advanceCommand(ScenarioContext *context, int argc, char **argv) {
+    advanceFakeTime(atoi(argv[1]));
+    return true;
+}
+
+static bool pumpCommand(ScenarioContext *context, int argc, char **argv) {
+    runFakeDispatchers();
+    return true;
+}
+
+static bool autoPumpCommand(ScenarioContext *context, int argc, char **argv) {
+    context->isAutoPump = strcmp(argv[1], "on") == 0;
+    pumpIfNeeded(context);
+    return true;
+}
+
+static bool failNextCommand(ScenarioContext *context, int argc, char **argv) {
+    failNextFakeBtCall(argv[1]);
+    return true;
+}
+
+// Prefix is the rest of the line, so it may contain spaces
+static bool expectCommand(ScenarioContext *context, int argc, char **argv) {
+    long index = findFakeCall(argv[1], context->logCursor);
+
+    if (index < 0) {
+        dumpCallLog(context->logCursor);
+        return fail(context, "\"%s\" hasn't been logged", argv[1]);
+    }
+
+    context->logCursor = index + 1;
+    return true;
+}
+
+static bool expectNoneCommand(ScenarioContext *context, int argc, char **argv) {
+    long index = findFakeCall(argv[1], context->logCursor);
+
+    if (index >= 0) {
+        dumpCallLog(context->logCursor);
+        return fail(context, "\"%s\" has been logged", argv[1]);
+    }
+
+    return true;
+}
+
+static bool expectStateCommand(ScenarioContext *context, int argc, char **argv) {
+    BluetoothDeviceSnapshot snapshot;
+    getBtDeviceSnapshot(&snapshot);
+
+    if (strcmp(deviceStateNames[snapshot.deviceState], argv[1]) != 0) {
+        return fail(context, "device state is %s", deviceStateNames[snapshot.deviceState]);
+    }
+
+    return true;
+}
+
+static bool expectAudioCommand(ScenarioContext *context, int argc, char **argv) {
+    BluetoothDeviceSnapshot snapshot;
+    getBtDeviceSnapshot(&snapshot);
+
+    if (strcmp(audioStateNames[snapshot.audioState], argv[1]) != 0) {
+        return fail(context, "audio state is %s", audioStateNames[snapshot.audioState]);
+    }
+
+    return true;
+}
+
+static bool expectVolumeCommand(ScenarioContext *context, int argc, char **argv) {
+    BluetoothDeviceSnapshot snapshot;
+    getBtDeviceSnapshot(&snapshot);
+
+    if (snapshot.volume != atoi(argv[1])) {
+        return fail(context, "volume is %u", snapshot.volume);
+    }
+
+    return true;
+}
+
+static bool expectNvsWritesCommand(ScenarioContext *context, int argc, char **argv) {
+    uint32_t writesCount = getFakeNvsWritesCount();
+
+    if (writesCount != strtoul(argv[1], NULL, 10)) {
+        return fail(context, "NVS has been written %u times", writesCount);
+    }
+
+    return true;
+}
+
+static bool expectPmLockCommand(ScenarioContext *context, int argc, char **argv) {
+    int lockCount = getFakePmLockCount("bt_streaming");
+
+    if (lockCount != atoi(argv[1])) {
+        return fail(context, "streaming PM lock count is %d", lockCount);
+    }
+
+    return true;
+}
+
+static bool expectTimerCommand(ScenarioContext *context, int argc, char **argv) {
+    bool isActive = isFakeTimerActive(argv[1]);
+
+    if (isActive != (strcmp(argv[2], "active") == 0)) {
+        return fail(context, "timer %s is %s", argv[1], isActive ? "active" : "stopped");
+    }
+
+    return true;
+}
+
+static const ScenarioCommandEntry commands[] = {
+    { "store_last_peer", 2, storeLastPeerCommand },
+    { "boot", 0, bootCommand },
+    { "init", 0, initCommand },
+    { "log_level", 1, logLevelCommand },
+    { "call", 1, callCommand },
+    { "call_rejected", 1, callRejectedCommand },
+    { "gap_discovery_started", 0, gapDiscoveryStartedCommand },
+    { "gap_discovery_stopped", 0, gapDiscoveryStoppedCommand },
+    { "gap_result", 3, gapResultCommand },
+    { "gap_remote_name", 2, gapRemoteNameCommand },
+    { "gap_rssi_delta", 2, gapRssiDeltaCommand },
+    { "a2d_connection", 1, a2dConnectionCommand },
+    { "a2d_ack", 2, a2dAckCommand },
+    { "a2d_data", 1, a2dDataCommand },
+    { "avrc_connection", 2, avrcConnectionCommand },
+    { "avrc_caps", 1, avrcCapsCommand },
+    { "avrc_volume_rsp", 1, avrcVolumeRspCommand },
+    { "avrc_volume_notify", 1, avrcVolumeNotifyCommand },
+    { "advance", 1, advanceCommand },
+    { "pump", 0, pumpCommand },
+    { "auto_pump", 1, autoPumpCommand },
+    { "fail_next", 1, failNextCommand },
+    { "expect", 1, expectCommand },
+    { "expect_none", 1, expectNoneCommand },
+    { "expect_state", 1, expectStateCommand },
+    { "expect_audio", 1, expectAudioCommand },
+    { "expect_volume", 1, expectVolumeCommand },
+    { "expect_nvs_writes", 1, expectNvsWritesCommand },
+    { "expect_pm_lock", 1, expectPmLockCommand },
+    { "expect_timer", 2, expectTimerCommand },
+};
+
+// Splits the line into words. Rest of the line is kept as the only argument of "expect" and "expect_none"
+static int splitLine(char *line, char **argv) {
+    int argc = 0;
+    char *word = strtok(line, " \t\r\n");
+
+    while (word && argc < kScenarioArgsMax) {
+        argv[argc++] = word;
+
+        if (argc == 1 && (strcmp(word, "expect") == 0 || strcmp(word, "expect_none") == 0)) {
+            char *rest = strtok(NULL, "\r\n");
+
+            if (rest) {
+                argv[argc++] = rest;
+            }
+            break;
+        }
+
+        word = strtok(NULL, " \t\r\n");
+    }
+
+    return argc;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <scenario.txt>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *scenario = fopen(argv[1], "r");
+
+    if (!scenario) {
+        fprintf(stderr, "Unable to open scenario %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    ScenarioContext context = {
+        .path = argv[1],
+        .lineNumber = 0,
+        .logCursor = 0,
+        .isAutoPump = true,
+    };
+
+    char line[kScenarioLineMaxLen];
+    unsigned commandsCount = 0;
+
+    while (fgets(line, sizeof(line), scenario)) {
+        context.lineNumber++;
+
+        char *commandArgs[kScenarioArgsMax];
+        int commandArgsCount = line[0] == '#' ? 0 : splitLine(line, commandArgs);
+
+        if (commandArgsCount == 0) {
+            continue;
+        }
+
+        const ScenarioCommandEntry *command = NULL;
+
+        for (size_t commandIdx = 0; commandIdx < sizeof(commands) / sizeof(commands[0]); commandIdx++) {
+            if (strcmp(commands[commandIdx].name, commandArgs[0]) == 0) {
+                command = &commands[commandIdx];
+                break;
+            }
+        }
+
+        if (!command) {
+            fail(&context, "unknown command %s", commandArgs[0]);
+            return EXIT_FAILURE;
+        }
+
+        if (commandArgsCount - 1 < command->minArgs) {
+            fail(&context, "%s needs %d arguments", command->name, command->minArgs);
+            return EXIT_FAILURE;
+        }
+
+        if (!command->handler(&context, commandArgsCount, commandArgs)) {
+            return EXIT_FAILURE;
+        }
+
+        commandsCount++;
+    }
+
+    fclose(scenario);
+
+    printf("%s: %u commands passed\n", argv[1], commandsCount);
+    return EXIT_SUCCESS;
+}
+
+static bool fail(ScenarioContext *context, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    fprintf(stderr, "%s:%u: ", context->path, context->lineNumber);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+
+    va_end(args);
+    return false;
+}
+
+static void dumpCallLog(size_t startIndex) {
+    fprintf(stderr, "Call log since the last match:\n");
+
+    for (size_t callIdx = startIndex; callIdx < getFakeCallsCount(); callIdx++) {
+        fprintf(stderr, "    %s\n", getFakeCall(callIdx));
+    }
+}
+
+static bool parseAddress(const char *text, esp_bd_addr_t address) {
+    unsigned bytes[ESP_BD_ADDR_LEN];
+
+    if (sscanf(text, "%x:%x:%x:%x:%x:%x", &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &bytes[5]) != 6) {
+        return false;
+    }
+
+    for (size_t byteIdx = 0; byteIdx < ESP_BD_ADDR_LEN; byteIdx++) {
+        address[byteIdx] = bytes[byteIdx];
+    }
+
+    return true;
+}
+
+static int findName(const char *name, const char **names, size_t namesCount) {
+    for (size_t nameIdx = 0; nameIdx < namesCount; nameIdx++) {
+        if (strcmp(names[nameIdx], name) == 0) {
+            return nameIdx;
+        }
+    }
+
+    return -1;
+}
+
+static void pumpIfNeeded(ScenarioContext *context) {
+    if (context->isAutoPump) {
+        runFakeDispatchers();
+    }
+}
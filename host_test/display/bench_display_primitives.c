@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "display.h"
+
+// Times every primitive against the per-pixel setPixel path drawing the same shape and checks that both leave
+// the same buffer. Shapes are clipped by the screen edges where the primitive has to clip.
+//
+// Usage: bench_display_primitives [iterations]
+// Host timings only show the ratio between the paths. Sanitized builds are several times slower
+
+#define kDefaultIterations (2000)
+#define kBitmapWidth (40)
+#define kBitmapHeight (20)
+#define kBitmapPages ((kBitmapHeight + 7) / 8)
+
+typedef void (*DrawFunction)(DisplayDevice *display);
+
+typedef struct {
+    const char *name;
+    DrawFunction draw;
+    DrawFunction drawPerPixel;
+} BenchCase;
+
+static DisplayDevice display;
+static uint8_t bitmap[kBitmapWidth * kBitmapPages];
+
+static void drawSpanHorizontal(DisplayDevice *display);
+static void drawSpanHorizontalPerPixel(DisplayDevice *display);
+static void drawSpanVertical(DisplayDevice *display);
+static void drawSpanVerticalPerPixel(DisplayDevice *display);
+static void drawFill(DisplayDevice *display);
+static void drawFillPerPixel(DisplayDevice *display);
+static void drawErase(DisplayDevice *display);
+static void drawErasePerPixel(DisplayDevice *display);
+static void drawInvert(DisplayDevice *display);
+static void drawInvertPerPixel(DisplayDevice *display);
+static void drawOutline(DisplayDevice *display);
+static void drawOutlinePerPixel(DisplayDevice *display);
+static void drawDiagonal(DisplayDevice *display);
+static void drawDiagonalPerPixel(DisplayDevice *display);
+static void drawIcon(DisplayDevice *display);
+static void drawIconPerPixel(DisplayDevice *display);
+static void drawClippedIcon(DisplayDevice *display);
+static void drawClippedIconPerPixel(DisplayDevice *display);
+static void drawMeter(DisplayDevice *display);
+static void drawMeterPerPixel(DisplayDevice *display);
+
+static void fillPerPixel(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height,
+                         DisplayColor color);
+static void linePerPixel(DisplayDevice *display, int16_t x0, int16_t y0, int16_t x1, int16_t y1, DisplayColor color);
+static void bitmapPerPixel(DisplayDevice *display, int16_t x, int16_t y);
+static void setClippedPixel(DisplayDevice *display, int16_t x, int16_t y, DisplayColor color);
+
+static void drawPattern(DisplayDevice *display);
+static double measureNs(DrawFunction draw, unsigned iterations);
+static void initDevice(void);
+
+static const BenchCase cases[] = {
+    { "horizontal span", drawSpanHorizontal, drawSpanHorizontalPerPixel },
+    { "vertical span", drawSpanVertical, drawSpanVerticalPerPixel },
+    { "fill rect", drawFill, drawFillPerPixel },
+    { "erase rect", drawErase, drawErasePerPixel },
+    { "invert rect", drawInvert, drawInvertPerPixel },
+    { "rect outline", drawOutline, drawOutlinePerPixel },
+    { "diagonal line", drawDiagonal, drawDiagonalPerPixel },
+    { "bitmap", drawIcon, drawIconPerPixel },
+    { "clipped bitmap", drawClippedIcon, drawClippedIconPerPixel },
+    { "bar", drawMeter, drawMeterPerPixel },
+};
+
+int main(int argc, char **argv) {
+    unsigned iterations = (argc > 1 ? strtoul(argv[1], NULL, 10) : kDefaultIterations);
+
+    if (argc > 2 || iterations == 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    initDevice();
+
+    for (size_t idx = 0; idx < sizeof(bitmap); idx++) {
+        bitmap[idx] = (uint8_t)(idx * 37 + 11);
+    }
+
+    size_t bufferSize = display.width * display.height / 8;
+    uint8_t *expected = malloc(bufferSize);
+    unsigned failuresCount = 0;
+
+    for (size_t idx = 0; idx < sizeof(cases) / sizeof(cases[0]); idx++) {
+        const BenchCase *benchCase = &cases[idx];
+
+        drawPattern(&display);
+        benchCase->drawPerPixel(&display);
+        memcpy(expected, display.buffer, bufferSize);
+
+        drawPattern(&display);
+        benchCase->draw(&display);
+
+        if (memcmp(expected, display.buffer, bufferSize) != 0) {
+            fprintf(stderr, "%s: buffer differs from the per-pixel path\n", benchCase->name);
+            failuresCount++;
+        }
+
+        double primitiveNs = measureNs(benchCase->draw, iterations);
+        double perPixelNs = measureNs(benchCase->drawPerPixel, iterations);
+
+        printf("%-16s %9.0f ns, per pixel %9.0f ns, x%.1f\n", benchCase->name, primitiveNs, perPixelNs,
+               perPixelNs / primitiveNs);
+    }
+
+    free(expected);
+    printf("%u failures\n", failuresCount);
+
+    return failuresCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void drawSpanHorizontal(DisplayDevice *display) {
+    drawHorizontalSpan(display, -5, 13, 140, DISPLAY_COLOR_WHITE);
+}
+
+static void drawSpanHorizontalPerPixel(DisplayDevice *display) {
+    fillPerPixel(display, -5, 13, 140, 1, DISPLAY_COLOR_WHITE);
+}
+
+static void drawSpanVertical(DisplayDevice *display) {
+    drawVerticalSpan(display, 37, 3, 58, DISPLAY_COLOR_INVERSE);
+}
+
+static void drawSpanVerticalPerPixel(DisplayDevice *display) {
+    fillPerPixel(display, 37, 3, 1, 58, DISPLAY_COLOR_INVERSE);
+}
+
+static void drawFill(DisplayDevice *display) {
+    fillRect(display, 10, 5, 100, 50, DISPLAY_COLOR_WHITE);
+}
+
+static void drawFillPerPixel(DisplayDevice *display) {
+    fillPerPixel(display, 10, 5, 100, 50, DISPLAY_COLOR_WHITE);
+}
+
+static void drawErase(DisplayDevice *display) {
+    fillRect(display, 60, 30, 100, 50, DISPLAY_COLOR_BLACK);
+}
+
+static void drawErasePerPixel(DisplayDevice *display) {
+    fillPerPixel(display, 60, 30, 100, 50, DISPLAY_COLOR_BLACK);
+}
+
+static void drawInvert(DisplayDevice *display) {
+    invertRect(display, 3, 9, 120, 40);
+}
+
+static void drawInvertPerPixel(DisplayDevice *display) {
+    fillPerPixel(display, 3, 9, 120, 40, DISPLAY_COLOR_INVERSE);
+}
+
+static void drawOutline(DisplayDevice *display) {
+    drawRect(display, 2, 3, 124, 60, DISPLAY_COLOR_INVERSE);
+}
+
+// Corners are toggled once, like drawRect does
+static void drawOutlinePerPixel(DisplayDevice *display) {
+    fillPerPixel(display, 2, 3, 124, 1, DISPLAY_COLOR_INVERSE);
+    fillPerPixel(display, 2, 62, 124, 1, DISPLAY_COLOR_INVERSE);
+    fillPerPixel(display, 2, 4, 1, 58, DISPLAY_COLOR_INVERSE);
+    fillPerPixel(display, 125, 4, 1, 58, DISPLAY_COLOR_INVERSE);
+}
+
+static void drawDiagonal(DisplayDevice *display) {
+    drawLine(display, -10, 70, 140, -6, DISPLAY_COLOR_WHITE);
+}
+
+static void drawDiagonalPerPixel(DisplayDevice *display) {
+    linePerPixel(display, -10, 70, 140, -6, DISPLAY_COLOR_WHITE);
+}
+
+static void drawIcon(DisplayDevice *display) {
+    drawBitmap(display, bitmap, 5, 11, kBitmapWidth, kBitmapHeight);
+}
+
+static void drawIconPerPixel(DisplayDevice *display) {
+    bitmapPerPixel(display, 5, 11);
+}
+
+static void drawClippedIcon(DisplayDevice *display) {
+    drawBitmap(display, bitmap, 100, -3, kBitmapWidth, kBitmapHeight);
+}
+
+static void drawClippedIconPerPixel(DisplayDevice *display) {
+    bitmapPerPixel(display, 100, -3);
+}
+
+static void drawMeter(DisplayDevice *display) {
+    drawBar(display, 4, 20, 120, 12, 37, 100);
+}
+
+// Inner width 118, 37% of it is 43 columns
+static void drawMeterPerPixel(DisplayDevice *display) {
+    fillPerPixel(display, 4, 20, 120, 1, DISPLAY_COLOR_WHITE);
+    fillPerPixel(display, 4, 31, 120, 1, DISPLAY_COLOR_WHITE);
+    fillPerPixel(display, 4, 21, 1, 10, DISPLAY_COLOR_WHITE);
+    fillPerPixel(display, 123, 21, 1, 10, DISPLAY_COLOR_WHITE);
+    fillPerPixel(display, 5, 21, 43, 10, DISPLAY_COLOR_WHITE);
+    fillPerPixel(display, 48, 21, 75, 10, DISPLAY_COLOR_BLACK);
+}
+
+static void fillPerPixel(DisplayDevice *display, int16_t x, int16_t y, int16_t width, int16_t height,
+                         DisplayColor color) {
+    for (int16_t row = y; row < y + height; row++) {
+        for (int16_t col = x; col < x + width; col++) {
+            setClippedPixel(display, col, row, color);
+        }
+    }
+}
+
+// Plain Bresenham, every point is plotted
+static void linePerPixel(DisplayDevice *display, int16_t x0, int16_t y0, int16_t x1, int16_t y1, DisplayColor color) {
+    int16_t dx = abs(x1 - x0);
+    int16_t dy = -abs(y1 - y0);
+    int16_t stepX = (x0 < x1 ? 1 : -1);
+    int16_t stepY = (y0 < y1 ? 1 : -1);
+    int16_t error = dx + dy;
+
+    while (true) {
+        setClippedPixel(display, x0, y0, color);
+
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+
+        int16_t doubledError = 2 * error;
+
+        if (doubledError >= dy) {
+            error += dy;
+            x0 += stepX;
+        }
+
+        if (doubledError <= dx) {
+            error += dx;
+            y0 += stepY;
+        }
+    }
+}
+
+static void bitmapPerPixel(DisplayDevice *display, int16_t x, int16_t y) {
+    for (uint8_t row = 0; row < kBitmapHeight; row++) {
+        for (uint8_t col = 0; col < kBitmapWidth; col++) {
+            bool isSet = (bitmap[col + (row / 8) * kBitmapWidth] >> (row & 7)) & 1;
+
+            setClippedPixel(display, x + col, y + row, isSet ? DISPLAY_COLOR_WHITE : DISPLAY_COLOR_BLACK);
+        }
+    }
+}
+
+// setPixel takes unsigned coordinates, negative ones would wrap into the screen
+static void setClippedPixel(DisplayDevice *display, int16_t x, int16_t y, DisplayColor color) {
+    if (x >= 0 && y >= 0) {
+        setPixel(display, x, y, color);
+    }
+}
+
+// Checkerboard of bytes, so white, black and inverse all change something
+static void drawPattern(DisplayDevice *display) {
+    clearBuffer(display);
+
+    for (uint8_t page = 0; page < display->height / 8; page++) {
+        for (uint8_t col = 0; col < display->width; col++) {
+            applyBufferMask(display, page, col, (col + page) & 1 ? 0x5A : 0xC3, DISPLAY_COLOR_WHITE);
+        }
+    }
+}
+
+static double measureNs(DrawFunction draw, unsigned iterations) {
+    struct timespec start;
+    struct timespec end;
+
+    drawPattern(&display);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (unsigned idx = 0; idx < iterations; idx++) {
+        draw(&display);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / iterations;
+}
+
+static void initDevice(void) {
+    i2c_master_bus_config_t busConfig = {
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .i2c_port = -1,
+        .scl_io_num = GPIO_NUM_5,
+        .sda_io_num = GPIO_NUM_17,
+    };
+
+    i2c_device_config_t deviceConfig = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = 0x3c,
+        .scl_speed_hz = 400000,
+    };
+
+    static I2CBus bus;
+    static I2CDevice device;
+
+    initI2CBus(&bus, &busConfig);
+    initI2CDevice(&device, &bus, &deviceConfig);
+    initDisplay(&display, &device, DISPLAY_128_64);
+}
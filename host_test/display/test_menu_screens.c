@@ -0,0 +1,469 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bt_lib.h"
+#include "display.h"
+#include "fake_bt.h"
+#include "fake_rtos.h"
+#include "fake_ssd1306.h"
+#include "menu.h"
+#include "spectrum.h"
+#include "standby.h"
+
+// Menu screens are drawn by menu.c on the real bt_lib over the fake Bluedroid, flushed by the display flush task
+// to the emulated SSD1306 and compared with the golden images. Every frame is checked after it has been flushed
+// on top of the previous one, so the dirty windows and the scrolling are checked too.
+//
+// Usage: test_menu_screens <golden dir> [--update]
+// Golden images are plain PBM files. Mismatched screens are written to <name>.actual.pbm in the working directory.
+// Bytes on the bus, bus time and draw time are reported for every frame. Draw time is from the input event to
+// the flush request, bt_lib event dispatching included
+
+#define kPbmLineMaxPixels (64) // Plain PBM lines shouldn't be longer than 70 characters
+#define kPathMaxLen (512)
+#define kSampleRate (44100)
+#define kEirMaxLen (240)
+
+#define kHeadphonesAddress { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66 }
+#define kSpeakerAddress { 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 }
+#define kLongNameAddress { 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 }
+#define kLongName "Living Room Soundbar Pro Max 5.1 Edition" // 40 characters, two parts of the marquee
+#define kLongNameParts (2)
+#define kRenderingDeviceClass (0x240404) // Audio major class with the rendering service
+
+typedef struct {
+    const char *goldenDir;
+    bool isUpdate;
+    unsigned failuresCount;
+    struct timespec drawStart;
+} ScreenContext;
+
+typedef bool Screen[kFakeSsd1306Rows][kFakeSsd1306Columns];
+
+static DisplayDevice display;
+
+static int32_t audioDataCallback(AudioFrame *frames, int32_t framesCount);
+static void audioStateChangedCallback(AudioState state);
+
+static void boot(ScreenContext *context);
+static void startDraw(ScreenContext *context);
+static void checkScreen(ScreenContext *context, const char *name);
+static void checkMarquee(ScreenContext *context, const char *name);
+static void pressEncoder(ScreenContext *context, EncoderEvent event, unsigned times);
+static void feedTones(void);
+
+static void injectDiscoveryState(esp_bt_gap_discovery_state_t state);
+static void injectDiscoveryResult(const esp_bd_addr_t address, int8_t rssi, const char *name);
+static void injectA2dpConnection(esp_a2d_connection_state_t state);
+static void injectAvrcConnection(const esp_bd_addr_t address, bool isConnected);
+static void injectVolumeResponse(uint8_t volume);
+static void injectSinkVolume(uint8_t volume);
+
+static void captureScreen(Screen screen, uint8_t rows);
+static bool readPbm(const char *path, Screen screen, uint8_t rows);
+static bool writePbm(const char *path, Screen screen, uint8_t rows);
+static double getElapsedUs(const struct timespec *start);
+
+int main(int argc, char **argv) {
+    if (argc < 2 || (argc == 3 && strcmp(argv[2], "--update") != 0) || argc > 3) {
+        fprintf(stderr, "Usage: %s <golden dir> [--update]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ScreenContext context = {
+        .goldenDir = argv[1],
+        .isUpdate = argc == 3,
+    };
+
+    const esp_bd_addr_t headphones = kHeadphonesAddress;
+    const esp_bd_addr_t speaker = kSpeakerAddress;
+    const esp_bd_addr_t longName = kLongNameAddress;
+
+    boot(&context);
+    checkScreen(&context, "startup");
+
+    // Connection profiler takes zero timestamps as milestones that haven't been reached
+    advanceFakeTime(1000);
+    pressEncoder(&context, ENCODER_SWITCH_PRESSED, 1);
+    injectDiscoveryState(ESP_BT_GAP_DISCOVERY_STARTED);
+    checkScreen(&context, "discovery");
+
+    advanceFakeTime(1200);
+    startDraw(&context);
+    injectDiscoveryResult(headphones, -50, "Headphones");
+    injectDiscoveryResult(speaker, -70, "Speaker");
+    injectDiscoveryResult(longName, -80, kLongName);
+    injectDiscoveryState(ESP_BT_GAP_DISCOVERY_STOPPED);
+    checkScreen(&context, "device_list");
+
+    // Picked name that doesn't fit is scrolled by the controller, a part at a time. Next part is drawn after
+    // every rotation, the first one comes again after the tail
+    pressEncoder(&context, ENCODER_STEP_CW, 2);
+    checkMarquee(&context, "device_list_marquee");
+
+    for (unsigned part = 2; part <= kLongNameParts + 1; part++) {
+        char name[kPathMaxLen];
+        snprintf(name, sizeof(name), "device_list_marquee_%u", part);
+
+        startDraw(&context);
+        advanceFakeTime(getMarqueeRotationMs(&display));
+        checkMarquee(&context, part <= kLongNameParts ? name : "device_list_marquee");
+    }
+
+    pressEncoder(&context, ENCODER_STEP_CCW, 2);
+    checkScreen(&context, "device_list");
+
+    advanceFakeTime(800);
+    pressEncoder(&context, ENCODER_SWITCH_PRESSED, 1);
+    checkScreen(&context, "connecting");
+
+    advanceFakeTime(300);
+    injectA2dpConnection(ESP_A2D_CONNECTION_STATE_CONNECTING);
+    advanceFakeTime(500);
+
+    startDraw(&context);
+    injectA2dpConnection(ESP_A2D_CONNECTION_STATE_CONNECTED);
+    advanceFakeTime(100);
+    injectAvrcConnection(headphones, true);
+    checkScreen(&context, "audio_menu");
+
+    // Sink answers the initial volume, then changes it from its own buttons
+    startDraw(&context);
+    injectVolumeResponse(kDefaultAudioLevel * 127 / 100);
+    injectSinkVolume(51);
+    checkScreen(&context, "audio_menu_volume");
+
+    pressEncoder(&context, ENCODER_STEP_CW, AUDIO_MENU_TIMINGS_BUTTON);
+    pressEncoder(&context, ENCODER_SWITCH_PRESSED, 1);
+    checkScreen(&context, "connection_timings");
+
+    pressEncoder(&context, ENCODER_SWITCH_PRESSED, 1);
+    pressEncoder(&context, ENCODER_STEP_CCW, AUDIO_MENU_TIMINGS_BUTTON - AUDIO_MENU_SPECTRUM_BUTTON);
+    pressEncoder(&context, ENCODER_SWITCH_PRESSED, 1);
+    checkScreen(&context, "spectrum_empty");
+
+    startDraw(&context);
+    feedTones();
+    checkScreen(&context, "spectrum");
+
+    pressEncoder(&context, ENCODER_SWITCH_PRESSED, 1);
+    pressEncoder(&context, ENCODER_STEP_CW, AUDIO_MENU_BACK_BUTTON - AUDIO_MENU_SPECTRUM_BUTTON);
+    pressEncoder(&context, ENCODER_SWITCH_PRESSED, 1);
+    checkScreen(&context, "disconnecting");
+
+    startDraw(&context);
+    injectA2dpConnection(ESP_A2D_CONNECTION_STATE_DISCONNECTED);
+    injectAvrcConnection(headphones, false);
+    checkScreen(&context, "startup");
+
+    printf("%u failures\n", context.failuresCount);
+
+    return context.failuresCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int32_t audioDataCallback(AudioFrame *frames, int32_t framesCount) {
+    memset(frames, 0, framesCount * sizeof(AudioFrame));
+    return framesCount;
+}
+
+static void audioStateChangedCallback(AudioState state) {
+}
+
+// Same order as app_main, without the audio input and the encoder driver
+static void boot(ScreenContext *context) {
+    static BluetoothDeviceCallbacks callbacks = {
+        .audioDataCallback = audioDataCallback,
+        .deviceStateChangedCallback = handleDeviceStateChangedEvent,
+        .audioStateChangedCallback = audioStateChangedCallback,
+        .deviceDiscoveredCallback = handleDeviceDiscoveredEvent,
+        .volumeChangedCallback = volumeChangedCallback,
+    };
+
+    initBtDevice(&callbacks);
+
+    i2c_master_bus_config_t busConfig = {
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .i2c_port = -1,
+        .scl_io_num = GPIO_NUM_5,
+        .sda_io_num = GPIO_NUM_17,
+    };
+
+    i2c_device_config_t deviceConfig = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = 0x3c,
+        .scl_speed_hz = 100000,
+    };
+
+    static I2CBus bus;
+    static I2CDevice device;
+
+    initI2CBus(&bus, &busConfig);
+    initI2CDevice(&device, &bus, &deviceConfig);
+
+    startDraw(context);
+    initDisplay(&display, &device, DISPLAY_128_32);
+    initStandby(&display, GPIO_NUM_32);
+    setMenuDisplay(&display);
+    initSpectrum(spectrumFrameCallback);
+
+    startBtDevice();
+    runFakeDispatchers();
+}
+
+static void startDraw(ScreenContext *context) {
+    clock_gettime(CLOCK_MONOTONIC, &context->drawStart);
+}
+
+// Runs the flush task for the requested frame and compares the panel with the golden image
+static void checkScreen(ScreenContext *context, const char *name) {
+    double drawUs = getElapsedUs(&context->drawStart);
+
+    resetFakeSsd1306Stats();
+
+    if (!runFakeTask(display.flushTask)) {
+        fprintf(stderr, "%s: frame hasn't been requested\n", name);
+        context->failuresCount++;
+        return;
+    }
+
+    FakeSsd1306Stats busStats;
+    getFakeSsd1306Stats(&busStats);
+
+    DisplayStats displayStats;
+    getDisplayStats(&display, &displayStats);
+
+    printf("%s: %u bytes in %u transactions, bus %u us, draw %.1f us\n", name, busStats.bytesCount,
+           busStats.transactionsCount, busStats.busTimeUs, drawUs);
+
+    // Flush task counts the bytes it sends, the controller counts what it receives
+    if (displayStats.lastFlushBytes != busStats.bytesCount) {
+        fprintf(stderr, "%s: flush reported %u bytes, %u were on the bus\n", name, displayStats.lastFlushBytes,
+                busStats.bytesCount);
+        context->failuresCount++;
+    }
+
+    if (busStats.errorsCount != 0) {
+        fprintf(stderr, "%s: controller got %u malformed commands or writes\n", name, busStats.errorsCount);
+        context->failuresCount++;
+    }
+
+    uint8_t rows = getFakeSsd1306VisibleRows();
+
+    if (rows != display.height) {
+        fprintf(stderr, "%s: panel shows %u rows, display has %u\n", name, rows, display.height);
+        context->failuresCount++;
+        return;
+    }
+
+    static Screen screen;
+    static Screen golden;
+    char path[kPathMaxLen];
+
+    captureScreen(screen, rows);
+    snprintf(path, sizeof(path), "%s/%s.pbm", context->goldenDir, name);
+
+    if (context->isUpdate) {
+        if (!writePbm(path, screen, rows)) {
+            context->failuresCount++;
+        }
+        return;
+    }
+
+    if (!readPbm(path, golden, rows)) {
+        context->failuresCount++;
+        return;
+    }
+
+    unsigned mismatchesCount = 0;
+
+    for (uint8_t y = 0; y < rows; y++) {
+        for (uint8_t x = 0; x < kFakeSsd1306Columns; x++) {
+            mismatchesCount += screen[y][x] != golden[y][x];
+        }
+    }
+
+    if (mismatchesCount != 0) {
+        snprintf(path, sizeof(path), "%s.actual.pbm", name);
+        writePbm(path, screen, rows);
+
+        fprintf(stderr, "%s: %u pixels differ from the golden image, see %s\n", name, mismatchesCount, path);
+        context->failuresCount++;
+    }
+}
+
+static void checkMarquee(ScreenContext *context, const char *name) {
+    checkScreen(context, name);
+
+    if (!isFakeSsd1306Scrolling()) {
+        fprintf(stderr, "%s: controller isn't scrolling\n", name);
+        context->failuresCount++;
+    }
+}
+
+static void pressEncoder(ScreenContext *context, EncoderEvent event, unsigned times) {
+    startDraw(context);
+
+    for (unsigned idx = 0; idx < times; idx++) {
+        encoderCallback(event, NULL);
+        runFakeDispatchers();
+    }
+}
+
+// Two tones fill one analyzer block. Block is captured only a frame period after the previous one
+static void feedTones(void) {
+    static AudioFrame frames[kSpectrumFftSize];
+
+    for (uint16_t idx = 0; idx < kSpectrumFftSize; idx++) {
+        float phase = 2.0f * M_PI * idx / kSampleRate;
+        int16_t sample = lroundf(12000.0f * sinf(1000.0f * phase) + 4000.0f * sinf(6000.0f * phase));
+
+        frames[idx].channel1 = frames[idx].channel2 = (uint16_t)sample;
+    }
+
+    advanceFakeTime(kSpectrumFramePeriodUs / 1000);
+    feedSpectrumSamples(frames, kSpectrumFftSize);
+    runFakeTask(findFakeTask("SpectrumTask"));
+}
+
+static void injectDiscoveryState(esp_bt_gap_discovery_state_t state) {
+    esp_bt_gap_cb_param_t param = { .disc_st_chg.state = state };
+
+    injectGapEvent(ESP_BT_GAP_DISC_STATE_CHANGED_EVT, &param);
+    runFakeDispatchers();
+}
+
+// Name travels in the complete local name field of the extended inquiry response
+static void injectDiscoveryResult(const esp_bd_addr_t address, int8_t rssi, const char *name) {
+    uint32_t deviceClass = kRenderingDeviceClass;
+    uint8_t eir[kEirMaxLen] = {};
+    size_t nameLen = strlen(name);
+
+    eir[0] = nameLen + 1;
+    eir[1] = ESP_BT_EIR_TYPE_CMPL_LOCAL_NAME;
+    memcpy(&eir[2], name, nameLen);
+
+    esp_bt_gap_dev_prop_t properties[] = {
+        { .type = ESP_BT_GAP_DEV_PROP_COD, .len = sizeof(deviceClass), .val = &deviceClass },
+        { .type = ESP_BT_GAP_DEV_PROP_RSSI, .len = sizeof(rssi), .val = &rssi },
+        { .type = ESP_BT_GAP_DEV_PROP_EIR, .len = sizeof(eir), .val = eir },
+    };
+
+    esp_bt_gap_cb_param_t param = {};
+
+    memcpy(param.disc_res.bda, address, sizeof(esp_bd_addr_t));
+    param.disc_res.num_prop = sizeof(properties) / sizeof(properties[0]);
+    param.disc_res.prop = properties;
+
+    injectGapEvent(ESP_BT_GAP_DISC_RES_EVT, &param);
+    runFakeDispatchers();
+}
+
+static void injectA2dpConnection(esp_a2d_connection_state_t state) {
+    esp_a2d_cb_param_t param = { .conn_stat.state = state };
+
+    injectA2dpEvent(ESP_A2D_CONNECTION_STATE_EVT, &param);
+    runFakeDispatchers();
+}
+
+static void injectAvrcConnection(const esp_bd_addr_t address, bool isConnected) {
+    esp_avrc_ct_cb_param_t param = { .conn_stat.connected = isConnected };
+
+    memcpy(param.conn_stat.remote_bda, address, sizeof(esp_bd_addr_t));
+
+    injectAvrcEvent(ESP_AVRC_CT_CONNECTION_STATE_EVT, &param);
+    runFakeDispatchers();
+}
+
+static void injectVolumeResponse(uint8_t volume) {
+    esp_avrc_ct_cb_param_t param = { .set_volume_rsp.volume = volume };
+
+    injectAvrcEvent(ESP_AVRC_CT_SET_ABSOLUTE_VOLUME_RSP_EVT, &param);
+    runFakeDispatchers();
+}
+
+// Volume changed on the sink side, in AVRCP units
+static void injectSinkVolume(uint8_t volume) {
+    esp_avrc_ct_cb_param_t param = {};
+
+    param.change_ntf.event_id = ESP_AVRC_RN_VOLUME_CHANGE;
+    param.change_ntf.event_parameter.volume = volume;
+
+    injectAvrcEvent(ESP_AVRC_CT_CHANGE_NOTIFY_EVT, &param);
+    runFakeDispatchers();
+}
+
+static void captureScreen(Screen screen, uint8_t rows) {
+    for (uint8_t y = 0; y < rows; y++) {
+        for (uint8_t x = 0; x < kFakeSsd1306Columns; x++) {
+            screen[y][x] = getFakeSsd1306Pixel(x, y);
+        }
+    }
+}
+
+static bool readPbm(const char *path, Screen screen, uint8_t rows) {
+    FILE *file = fopen(path, "r");
+
+    if (!file) {
+        fprintf(stderr, "Unable to open golden image %s. Run with --update to create it\n", path);
+        return false;
+    }
+
+    unsigned width = 0;
+    unsigned height = 0;
+    bool isValid = fscanf(file, "P1 %u %u", &width, &height) == 2 && width == kFakeSsd1306Columns && height == rows;
+
+    for (uint8_t y = 0; isValid && y < rows; y++) {
+        for (uint8_t x = 0; isValid && x < kFakeSsd1306Columns; x++) {
+            int pixel = 0;
+
+            do {
+                pixel = fgetc(file);
+            } while (pixel == ' ' || pixel == '\n');
+
+            isValid = pixel == '0' || pixel == '1';
+            screen[y][x] = pixel == '1';
+        }
+    }
+
+    fclose(file);
+
+    if (!isValid) {
+        fprintf(stderr, "%s isn't a plain %ux%u PBM image\n", path, kFakeSsd1306Columns, rows);
+    }
+
+    return isValid;
+}
+
+static bool writePbm(const char *path, Screen screen, uint8_t rows) {
+    FILE *file = fopen(path, "w");
+
+    if (!file) {
+        fprintf(stderr, "Unable to write %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "P1\n%u %u\n", kFakeSsd1306Columns, rows);
+
+    for (uint8_t y = 0; y < rows; y++) {
+        for (uint8_t x = 0; x < kFakeSsd1306Columns; x++) {
+            fputc(screen[y][x] ? '1' : '0', file);
+
+            if ((x + 1) % kPbmLineMaxPixels == 0) {
+                fputc('\n', file);
+            }
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static double getElapsedUs(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
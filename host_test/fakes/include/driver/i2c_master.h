@@ -0,0 +1,60 @@
+#ifndef FAKE_DRIVER_I2C_MASTER_H_
+#define FAKE_DRIVER_I2C_MASTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "soc/gpio_num.h"
+
+// I2C master driver with the emulated SSD1306 (fake_ssd1306.h) on the bus. Every transmit is one transaction
+// for the controller, whatever the device address is
+
+typedef struct FakeI2CBus *i2c_master_bus_handle_t;
+typedef struct FakeI2CDevice *i2c_master_dev_handle_t;
+
+typedef enum {
+    I2C_CLK_SRC_DEFAULT,
+} i2c_clock_source_t;
+
+typedef enum {
+    I2C_ADDR_BIT_LEN_7,
+    I2C_ADDR_BIT_LEN_10,
+} i2c_addr_bit_len_t;
+
+typedef struct {
+    int i2c_port;
+    gpio_num_t sda_io_num;
+    gpio_num_t scl_io_num;
+    i2c_clock_source_t clk_source;
+    uint8_t glitch_ignore_cnt;
+    struct {
+        uint32_t enable_internal_pullup : 1;
+    } flags;
+} i2c_master_bus_config_t;
+
+typedef struct {
+    i2c_addr_bit_len_t dev_addr_length;
+    uint16_t device_address;
+    uint32_t scl_speed_hz;
+} i2c_device_config_t;
+
+typedef struct {
+    uint8_t *write_buffer;
+    size_t buffer_size;
+} i2c_master_transmit_multi_buffer_info_t;
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *busConfig, i2c_master_bus_handle_t *busHandle);
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t busHandle);
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t busHandle, const i2c_device_config_t *deviceConfig,
+                                    i2c_master_dev_handle_t *deviceHandle);
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t deviceHandle);
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t deviceHandle, const uint8_t *writeBuffer, size_t writeSize,
+                              int timeoutMs);
+esp_err_t i2c_master_multi_buffer_transmit(i2c_master_dev_handle_t deviceHandle,
+                                           i2c_master_transmit_multi_buffer_info_t *bufferInfo,
+                                           size_t bufferInfoCount, int timeoutMs);
+
+#endif
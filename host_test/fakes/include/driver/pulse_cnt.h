@@ -0,0 +1,9 @@
+#ifndef FAKE_DRIVER_PULSE_CNT_H_
+#define FAKE_DRIVER_PULSE_CNT_H_
+
+// Only the handles, so the encoder header can be included. The encoder itself isn't built on host
+
+typedef struct FakePcntUnit *pcnt_unit_handle_t;
+typedef struct FakePcntChannel *pcnt_channel_handle_t;
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef FAKE_DRIVER_RTC_IO_H_
+#define FAKE_DRIVER_RTC_IO_H_
+
+#include "esp_err.h"
+#include "soc/gpio_num.h"
+
+// Calls are recorded to the call log
+esp_err_t rtc_gpio_deinit(gpio_num_t port);
+esp_err_t rtc_gpio_pullup_en(gpio_num_t port);
+esp_err_t rtc_gpio_pulldown_dis(gpio_num_t port);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef FAKE_ESP_ATTR_H_
+#define FAKE_ESP_ATTR_H_
+
+// Memory placement doesn't exist on host. RTC data is an ordinary static, so it survives only within the process
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef FAKE_ESP_BT_H_
+#define FAKE_ESP_BT_H_
+
+#include "esp_bt_defs.h"
+#include "esp_err.h"
+
+typedef enum {
+    ESP_BT_MODE_IDLE = 0x00,
+    ESP_BT_MODE_BLE = 0x01,
+    ESP_BT_MODE_CLASSIC_BT = 0x02,
+    ESP_BT_MODE_BTDM = 0x03,
+} esp_bt_mode_t;
+
+typedef struct {
+    uint8_t mode;
+} esp_bt_controller_config_t;
+
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT() { .mode = ESP_BT_MODE_BTDM }
+
+typedef enum {
+    ESP_PWR_LVL_N12 = 0,
+    ESP_PWR_LVL_N9 = 1,
+    ESP_PWR_LVL_N6 = 2,
+    ESP_PWR_LVL_N3 = 3,
+    ESP_PWR_LVL_N0 = 4,
+    ESP_PWR_LVL_P3 = 5,
+    ESP_PWR_LVL_P6 = 6,
+    ESP_PWR_LVL_P9 = 7,
+} esp_power_level_t;
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *config);
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_disable(void);
+
+esp_err_t esp_bredr_tx_power_set(esp_power_level_t minLevel, esp_power_level_t maxLevel);
+esp_err_t esp_bredr_tx_power_get(esp_power_level_t *minLevel, esp_power_level_t *maxLevel);
+
+#endif
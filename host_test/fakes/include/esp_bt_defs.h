@@ -0,0 +1,31 @@
+#ifndef FAKE_ESP_BT_DEFS_H_
+#define FAKE_ESP_BT_DEFS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ESP_BD_ADDR_LEN (6)
+
+typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
+
+typedef enum {
+    ESP_BT_STATUS_SUCCESS = 0,
+    ESP_BT_STATUS_FAIL,
+    ESP_BT_STATUS_NOT_READY,
+    ESP_BT_STATUS_NOMEM,
+    ESP_BT_STATUS_BUSY,
+    ESP_BT_STATUS_DONE,
+    ESP_BT_STATUS_UNSUPPORTED,
+    ESP_BT_STATUS_PARM_INVALID,
+    ESP_BT_STATUS_UNHANDLED,
+    ESP_BT_STATUS_AUTH_FAILURE,
+    ESP_BT_STATUS_RMT_DEV_DOWN,
+    ESP_BT_STATUS_AUTH_REJECTED,
+    ESP_BT_STATUS_INVALID_STATIC_RAND_ADDR,
+    ESP_BT_STATUS_PENDING,
+    ESP_BT_STATUS_UNACCEPT_CONN_INTERVAL,
+    ESP_BT_STATUS_PARAM_OUT_OF_RANGE,
+    ESP_BT_STATUS_TIMEOUT,
+} esp_bt_status_t;
+
+#endif
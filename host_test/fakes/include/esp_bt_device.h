@@ -0,0 +1,8 @@
+#ifndef FAKE_ESP_BT_DEVICE_H_
+#define FAKE_ESP_BT_DEVICE_H_
+
+#include "esp_bt_defs.h"
+
+const uint8_t *esp_bt_dev_get_address(void);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef FAKE_ESP_BT_MAIN_H_
+#define FAKE_ESP_BT_MAIN_H_
+
+#include "esp_bt_defs.h"
+#include "esp_err.h"
+
+typedef struct {
+    bool ssp_en;
+} esp_bluedroid_config_t;
+
+#define BT_BLUEDROID_INIT_CONFIG_DEFAULT() { .ssp_en = true }
+
+esp_err_t esp_bluedroid_init_with_cfg(esp_bluedroid_config_t *config);
+esp_err_t esp_bluedroid_enable(void);
+esp_err_t esp_bluedroid_disable(void);
+
+#endif
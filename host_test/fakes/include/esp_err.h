@@ -0,0 +1,33 @@
+#ifndef FAKE_ESP_ERR_H_
+#define FAKE_ESP_ERR_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK (0)
+#define ESP_FAIL (-1)
+#define ESP_ERR_NO_MEM (0x101)
+#define ESP_ERR_INVALID_ARG (0x102)
+#define ESP_ERR_INVALID_STATE (0x103)
+#define ESP_ERR_NOT_FOUND (0x105)
+#define ESP_ERR_TIMEOUT (0x107)
+#define ESP_ERR_NVS_NOT_FOUND (0x1102)
+#define ESP_ERR_NVS_NO_FREE_PAGES (0x110d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND (0x1110)
+
+const char *esp_err_to_name(esp_err_t code);
+
+// Aborts like the firmware does, so a failed check is reported by the test as a crash
+#define ESP_ERROR_CHECK(x)                                                                         \
+    do {                                                                                           \
+        esp_err_t checkedError = (x);                                                              \
+        if (checkedError != ESP_OK) {                                                              \
+            fprintf(stderr, "ESP_ERROR_CHECK failed: %s at %s:%d\n", esp_err_to_name(checkedError), \
+                    __FILE__, __LINE__);                                                           \
+            abort();                                                                               \
+        }                                                                                          \
+    } while (0)
+
+#endif
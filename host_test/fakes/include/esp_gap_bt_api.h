@@ -0,0 +1,186 @@
+#ifndef FAKE_ESP_GAP_BT_API_H_
+#define FAKE_ESP_GAP_BT_API_H_
+
+#include "esp_bt_defs.h"
+#include "esp_err.h"
+
+#define ESP_BT_GAP_MAX_BDNAME_LEN (248)
+#define ESP_BT_GAP_AFH_CHANNELS_LEN (10)
+#define ESP_BT_GAP_TPOLL_MIN (0x0006)
+#define ESP_BT_GAP_TPOLL_DFT (0x0028)
+#define ESP_BT_GAP_TPOLL_MAX (0x1000)
+
+#define ESP_BT_COD_SRVC_RENDERING (0x20)
+#define ESP_BT_COD_SRVC_BIT_MASK (0x00ffe000)
+#define ESP_BT_COD_SRVC_BIT_OFFSET (13)
+#define ESP_BT_COD_FORMAT_TYPE_BIT_MASK (0x03)
+#define ESP_BT_COD_FORMAT_TYPE_1 (0x00)
+
+typedef uint8_t esp_bt_gap_afh_channels[ESP_BT_GAP_AFH_CHANNELS_LEN];
+typedef uint8_t esp_bt_pin_code_t[16];
+
+typedef enum {
+    ESP_BT_NON_CONNECTABLE,
+    ESP_BT_CONNECTABLE,
+} esp_bt_connection_mode_t;
+
+typedef enum {
+    ESP_BT_NON_DISCOVERABLE,
+    ESP_BT_LIMITED_DISCOVERABLE,
+    ESP_BT_GENERAL_DISCOVERABLE,
+} esp_bt_discovery_mode_t;
+
+typedef enum {
+    ESP_BT_PIN_TYPE_VARIABLE = 0,
+    ESP_BT_PIN_TYPE_FIXED = 1,
+} esp_bt_pin_type_t;
+
+typedef enum {
+    ESP_BT_INQ_MODE_GENERAL_INQUIRY,
+    ESP_BT_INQ_MODE_LIMITED_INQUIRY,
+} esp_bt_inq_mode_t;
+
+typedef enum {
+    ESP_BT_EIR_TYPE_SHORT_LOCAL_NAME = 0x08,
+    ESP_BT_EIR_TYPE_CMPL_LOCAL_NAME = 0x09,
+} esp_bt_eir_type_t;
+
+typedef enum {
+    ESP_BT_GAP_DEV_PROP_BDNAME = 1,
+    ESP_BT_GAP_DEV_PROP_COD,
+    ESP_BT_GAP_DEV_PROP_RSSI,
+    ESP_BT_GAP_DEV_PROP_EIR,
+} esp_bt_gap_dev_prop_type_t;
+
+typedef struct {
+    esp_bt_gap_dev_prop_type_t type;
+    int len;
+    void *val;
+} esp_bt_gap_dev_prop_t;
+
+typedef enum {
+    ESP_BT_GAP_DISCOVERY_STOPPED,
+    ESP_BT_GAP_DISCOVERY_STARTED,
+} esp_bt_gap_discovery_state_t;
+
+typedef enum {
+    ESP_BT_PM_MD_ACTIVE = 0x00,
+    ESP_BT_PM_MD_HOLD = 0x01,
+    ESP_BT_PM_MD_SNIFF = 0x02,
+    ESP_BT_PM_MD_PARK = 0x03,
+} esp_bt_pm_mode_t;
+
+typedef enum {
+    ESP_BT_GAP_DISC_RES_EVT = 0,
+    ESP_BT_GAP_DISC_STATE_CHANGED_EVT,
+    ESP_BT_GAP_RMT_SRVCS_EVT,
+    ESP_BT_GAP_RMT_SRVC_REC_EVT,
+    ESP_BT_GAP_AUTH_CMPL_EVT,
+    ESP_BT_GAP_PIN_REQ_EVT,
+    ESP_BT_GAP_CFM_REQ_EVT,
+    ESP_BT_GAP_KEY_NOTIF_EVT,
+    ESP_BT_GAP_KEY_REQ_EVT,
+    ESP_BT_GAP_READ_RSSI_DELTA_EVT,
+    ESP_BT_GAP_CONFIG_EIR_DATA_EVT,
+    ESP_BT_GAP_SET_AFH_CHANNELS_EVT,
+    ESP_BT_GAP_READ_REMOTE_NAME_EVT,
+    ESP_BT_GAP_MODE_CHG_EVT,
+    ESP_BT_GAP_REMOVE_BOND_DEV_COMPLETE_EVT,
+    ESP_BT_GAP_QOS_CMPL_EVT,
+    ESP_BT_GAP_ACL_CONN_CMPL_STAT_EVT,
+    ESP_BT_GAP_ACL_DISCONN_CMPL_STAT_EVT,
+    ESP_BT_GAP_SET_PAGE_TO_EVT,
+    ESP_BT_GAP_GET_PAGE_TO_EVT,
+    ESP_BT_GAP_ACL_PKT_TYPE_CHANGED_EVT,
+    ESP_BT_GAP_ENC_CHG_EVT,
+    ESP_BT_GAP_SET_MIN_ENC_KEY_SIZE_EVT,
+    ESP_BT_GAP_GET_DEV_NAME_CMPL_EVT,
+    ESP_BT_GAP_EVT_MAX,
+} esp_bt_gap_cb_event_t;
+
+// Only the params of the events handled by bt_lib are declared
+typedef union {
+    struct {
+        esp_bd_addr_t bda;
+        int num_prop;
+        esp_bt_gap_dev_prop_t *prop;
+    } disc_res;
+
+    struct {
+        esp_bt_gap_discovery_state_t state;
+    } disc_st_chg;
+
+    struct {
+        esp_bd_addr_t bda;
+        esp_bt_status_t stat;
+        uint8_t device_name[ESP_BT_GAP_MAX_BDNAME_LEN + 1];
+    } auth_cmpl;
+
+    struct {
+        esp_bd_addr_t bda;
+        bool min_16_digit;
+    } pin_req;
+
+    struct {
+        esp_bd_addr_t bda;
+        uint32_t num_val;
+    } cfm_req;
+
+    struct {
+        esp_bd_addr_t bda;
+        uint32_t passkey;
+    } key_notif;
+
+    struct {
+        esp_bd_addr_t bda;
+        esp_bt_status_t stat;
+        int8_t rssi_delta;
+    } read_rssi_delta;
+
+    struct {
+        esp_bt_status_t stat;
+    } set_afh_channels;
+
+    struct {
+        esp_bd_addr_t bda;
+        esp_bt_status_t stat;
+        uint8_t rmt_name[ESP_BT_GAP_MAX_BDNAME_LEN + 1];
+    } read_rmt_name;
+
+    struct {
+        esp_bd_addr_t bda;
+        esp_bt_pm_mode_t mode;
+    } mode_chg;
+
+    struct {
+        esp_bt_status_t stat;
+        esp_bd_addr_t bda;
+        uint32_t t_poll;
+    } qos_cmpl;
+
+    struct {
+        esp_bt_status_t status;
+        char *name;
+    } get_dev_name_cmpl;
+} esp_bt_gap_cb_param_t;
+
+typedef void (*esp_bt_gap_cb_t)(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param);
+
+bool esp_bt_gap_is_valid_cod(uint32_t cod);
+uint32_t esp_bt_gap_get_cod_srvc(uint32_t cod);
+uint8_t *esp_bt_gap_resolve_eir_data(uint8_t *eir, esp_bt_eir_type_t type, uint8_t *length);
+
+esp_err_t esp_bt_gap_register_callback(esp_bt_gap_cb_t callback);
+esp_err_t esp_bt_gap_set_device_name(const char *name);
+esp_err_t esp_bt_gap_get_device_name(void);
+esp_err_t esp_bt_gap_set_scan_mode(esp_bt_connection_mode_t connectionMode, esp_bt_discovery_mode_t discoveryMode);
+esp_err_t esp_bt_gap_start_discovery(esp_bt_inq_mode_t mode, uint8_t inquiryLength, uint8_t responsesCount);
+esp_err_t esp_bt_gap_cancel_discovery(void);
+esp_err_t esp_bt_gap_read_remote_name(esp_bd_addr_t address);
+esp_err_t esp_bt_gap_read_rssi_delta(esp_bd_addr_t address);
+esp_err_t esp_bt_gap_set_afh_channels(esp_bt_gap_afh_channels channels);
+esp_err_t esp_bt_gap_set_qos(esp_bd_addr_t address, uint32_t pollSlots);
+esp_err_t esp_bt_gap_set_pin(esp_bt_pin_type_t pinType, uint8_t pinCodeLen, esp_bt_pin_code_t pinCode);
+esp_err_t esp_bt_gap_pin_reply(esp_bd_addr_t address, bool accept, uint8_t pinCodeLen, esp_bt_pin_code_t pinCode);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef FAKE_ESP_SLEEP_H_
+#define FAKE_ESP_SLEEP_H_
+
+#include "esp_err.h"
+#include "soc/gpio_num.h"
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER,
+} esp_sleep_source_t;
+
+// Host process always starts from reset. Deep sleep is recorded to the call log and returns
+esp_sleep_source_t esp_sleep_get_wakeup_cause(void);
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t port, int level);
+void esp_deep_sleep_start(void);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef FAKE_ESP_SYSTEM_H_
+#define FAKE_ESP_SYSTEM_H_
+
+#include "esp_err.h"
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef FAKE_ESP_TIMER_H_
+#define FAKE_ESP_TIMER_H_
+
+#include <stdint.h>
+
+// Fake time in microseconds. Advanced by the test only (fake_rtos.h)
+int64_t esp_timer_get_time(void);
+
+#endif
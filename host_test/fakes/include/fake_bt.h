@@ -0,0 +1,27 @@
+#ifndef FAKE_BT_H_
+#define FAKE_BT_H_
+
+#include <stdbool.h>
+
+#include "esp_a2dp_api.h"
+#include "esp_avrc_api.h"
+#include "esp_gap_bt_api.h"
+
+// Fake Bluedroid. API calls are recorded to the call log, events are injected by the test into the registered
+// callbacks. Injected events run synchronously, like they would on the BTC task
+
+bool injectGapEvent(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param);
+bool injectA2dpEvent(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param);
+bool injectAvrcEvent(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t *param);
+
+// Asks the registered A2DP source data callback for data. Returns the filled length
+int32_t requestFakeA2dpData(uint8_t *buffer, int32_t length);
+
+// Next call of the named API function (e.g. "esp_bt_gap_read_remote_name") returns ESP_FAIL
+void failNextFakeBtCall(const char *functionName);
+
+bool isFakeBluedroidEnabled(void);
+
+const char *fakeBdaToStr(const esp_bd_addr_t address);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef FAKE_CALL_LOG_H_
+#define FAKE_CALL_LOG_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Ordered log of the fake API calls and of the callbacks received by the test, e.g.
+// "esp_a2d_source_connect 11:22:33:44:55:66" or "state CONNECTED". Tests match the entries by prefix
+
+#define kFakeCallMaxLen (96)
+#define kFakeCallLogSize (4096)
+
+void recordFakeCall(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void clearFakeCalls(void);
+
+size_t getFakeCallsCount(void);
+const char *getFakeCall(size_t index);
+int64_t getFakeCallTime(size_t index); // Fake time of the entry in microseconds
+
+// Returns index of the first entry starting with prefix at or after startIndex, or -1
+long findFakeCall(const char *prefix, size_t startIndex);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef FAKE_ESP_H_
+#define FAKE_ESP_H_
+
+#include <stdint.h>
+
+#include "esp_pm.h"
+
+// Acquire count of the PM lock with this name. Negative if there is no such lock
+int getFakePmLockCount(const char *name);
+
+// Number of nvs_set_blob calls since the start of the process
+uint32_t getFakeNvsWritesCount(void);
+
+#endif
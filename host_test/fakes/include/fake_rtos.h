@@ -0,0 +1,24 @@
+#ifndef FAKE_RTOS_H_
+#define FAKE_RTOS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+// Moves the fake clock. Timers which expire on the way are fired in order, and the dispatchers are pumped
+// after each of them, like the dispatcher tasks would run right after the timer task
+void advanceFakeTime(uint32_t milliseconds);
+
+// Runs queued dispatcher tasks until all dispatchers are empty. Returns the number of tasks run
+uint32_t runFakeDispatchers(void);
+
+uint32_t getFakeTaskNotifications(TaskHandle_t task);
+TaskHandle_t findFakeTask(const char *name);
+
+// Runs the task function until it waits for a notification which nobody has given. Returns false if the task
+// had no notifications. Locals of the task don't survive the wait, the function is started again by the next run
+bool runFakeTask(TaskHandle_t task);
+bool isFakeTimerActive(const char *name);
+
+#endif
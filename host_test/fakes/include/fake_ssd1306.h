@@ -0,0 +1,41 @@
+#ifndef FAKE_SSD1306_H_
+#define FAKE_SSD1306_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Emulated SSD1306 behind the fake I2C driver. Transactions are decoded like the chip does: control bytes select
+// commands or GDDRAM data, multibyte commands take their arguments from the following command bytes, even from
+// the next transaction, data goes to the window set by PAGEADDR and COLUMNADDR. Misuse the chip wouldn't report
+// (unknown commands, malformed control bytes, GDDRAM writes while scrolling) is counted as errors
+
+#define kFakeSsd1306Columns (128)
+#define kFakeSsd1306Pages (8)
+#define kFakeSsd1306Rows (kFakeSsd1306Pages * 8)
+
+typedef struct {
+    uint32_t transactionsCount;
+    uint32_t bytesCount;     // Without the address bytes, like DisplayStats
+    uint32_t dataBytesCount; // Written to GDDRAM
+    uint32_t busTimeUs;      // At the SCL speed of the device, address bytes included
+    uint32_t errorsCount;
+} FakeSsd1306Stats;
+
+// One I2C write transaction addressed to the controller. SCL speed is used for the bus time only
+void feedFakeSsd1306(const uint8_t *bytes, size_t len, uint32_t sclSpeedHz);
+
+void getFakeSsd1306Stats(FakeSsd1306Stats *stats);
+void resetFakeSsd1306Stats(void);
+
+// GDDRAM is page-major like the display buffer: byte [page * kFakeSsd1306Columns + col], bit 0 is the top row
+const uint8_t *getFakeSsd1306Ram(void);
+bool isFakeSsd1306Scrolling(void);
+
+// Panel as the viewer sees it. Rows are the multiplex ratio. Display power, charge pump, inversion, start line and
+// the scan directions are applied. Remapped segments and reversed COM scan show GDDRAM as is, like the module is
+// mounted in the device
+uint8_t getFakeSsd1306VisibleRows(void);
+bool getFakeSsd1306Pixel(uint8_t x, uint8_t y);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef FAKE_NVS_FLASH_H_
+#define FAKE_NVS_FLASH_H_
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef FAKE_SOC_GPIO_NUM_H_
+#define FAKE_SOC_GPIO_NUM_H_
+
+// Pads of the ESP32 used by the firmware. Nothing is routed on host
+
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_2 = 2,
+    GPIO_NUM_4 = 4,
+    GPIO_NUM_5 = 5,
+    GPIO_NUM_15 = 15,
+    GPIO_NUM_17 = 17,
+    GPIO_NUM_32 = 32,
+    GPIO_NUM_34 = 34,
+    GPIO_NUM_35 = 35,
+} gpio_num_t;
+
+#endif
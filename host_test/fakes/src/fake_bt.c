@@ -0,0 +1,380 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_a2dp_api.h"
+#include "esp_avrc_api.h"
+#include "esp_bt.h"
+#include "esp_bt_device.h"
+#include "esp_bt_main.h"
+#include "esp_gap_bt_api.h"
+#include "fake_bt.h"
+#include "fake_call_log.h"
+
+#define kEirMaxLen (240)
+#define kFunctionNameMaxLen (64)
+
+static bool isControllerEnabled = false;
+static bool isBluedroidEnabled = false;
+
+static esp_bt_gap_cb_t gapCallback = NULL;
+static esp_a2d_cb_t a2dpCallback = NULL;
+static esp_a2d_source_data_cb_t a2dpDataCallback = NULL;
+static esp_avrc_ct_cb_t avrcCallback = NULL;
+
+static esp_power_level_t minTxPower = ESP_PWR_LVL_N0;
+static esp_power_level_t maxTxPower = ESP_PWR_LVL_P3;
+
+static const esp_bd_addr_t localAddress = { 0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01 };
+
+static char failingFunction[kFunctionNameMaxLen] = "";
+
+static esp_err_t completeCall(const char *functionName);
+
+// Events are delivered only by the enabled stack, like the BTC task stops with Bluedroid
+bool injectGapEvent(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param) {
+    if (!isBluedroidEnabled || !gapCallback) {
+        return false;
+    }
+
+    gapCallback(event, param);
+    return true;
+}
+
+bool injectA2dpEvent(esp_a2d_cb_event_t event, esp_a2d_cb_param_t *param) {
+    if (!isBluedroidEnabled || !a2dpCallback) {
+        return false;
+    }
+
+    a2dpCallback(event, param);
+    return true;
+}
+
+bool injectAvrcEvent(esp_avrc_ct_cb_event_t event, esp_avrc_ct_cb_param_t *param) {
+    if (!isBluedroidEnabled || !avrcCallback) {
+        return false;
+    }
+
+    avrcCallback(event, param);
+    return true;
+}
+
+int32_t requestFakeA2dpData(uint8_t *buffer, int32_t length) {
+    if (!isBluedroidEnabled || !a2dpDataCallback) {
+        return 0;
+    }
+
+    return a2dpDataCallback(buffer, length);
+}
+
+void failNextFakeBtCall(const char *functionName) {
+    assert(strlen(functionName) < kFunctionNameMaxLen);
+    strcpy(failingFunction, functionName);
+}
+
+bool isFakeBluedroidEnabled(void) {
+    return isBluedroidEnabled;
+}
+
+// Two buffers, so both addresses of a single printf can be formatted
+const char *fakeBdaToStr(const esp_bd_addr_t address) {
+    static char buffers[2][18];
+    static size_t nextBuffer = 0;
+
+    char *buffer = buffers[nextBuffer];
+    nextBuffer = (nextBuffer + 1) % 2;
+
+    snprintf(buffer, sizeof(buffers[0]), "%02x:%02x:%02x:%02x:%02x:%02x", address[0], address[1], address[2],
+             address[3], address[4], address[5]);
+
+    return buffer;
+}
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode) {
+    return completeCall("esp_bt_controller_mem_release");
+}
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *config) {
+    assert(config);
+    return completeCall("esp_bt_controller_init");
+}
+
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode) {
+    recordFakeCall("esp_bt_controller_enable %d", mode);
+
+    if (completeCall("esp_bt_controller_enable") != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    isControllerEnabled = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_disable(void) {
+    recordFakeCall("esp_bt_controller_disable");
+
+    if (!isControllerEnabled || isBluedroidEnabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    isControllerEnabled = false;
+    return completeCall("esp_bt_controller_disable");
+}
+
+esp_err_t esp_bredr_tx_power_set(esp_power_level_t minLevel, esp_power_level_t maxLevel) {
+    recordFakeCall("esp_bredr_tx_power_set %d %d", minLevel, maxLevel);
+
+    if (minLevel > maxLevel) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (completeCall("esp_bredr_tx_power_set") != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    minTxPower = minLevel;
+    maxTxPower = maxLevel;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_bredr_tx_power_get(esp_power_level_t *minLevel, esp_power_level_t *maxLevel) {
+    assert(minLevel && maxLevel);
+
+    *minLevel = minTxPower;
+    *maxLevel = maxTxPower;
+
+    return completeCall("esp_bredr_tx_power_get");
+}
+
+esp_err_t esp_bluedroid_init_with_cfg(esp_bluedroid_config_t *config) {
+    assert(config);
+
+    if (!isControllerEnabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return completeCall("esp_bluedroid_init_with_cfg");
+}
+
+esp_err_t esp_bluedroid_enable(void) {
+    recordFakeCall("esp_bluedroid_enable");
+
+    if (completeCall("esp_bluedroid_enable") != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    isBluedroidEnabled = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_bluedroid_disable(void) {
+    recordFakeCall("esp_bluedroid_disable");
+
+    if (!isBluedroidEnabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    isBluedroidEnabled = false;
+    return completeCall("esp_bluedroid_disable");
+}
+
+const uint8_t *esp_bt_dev_get_address(void) {
+    return isBluedroidEnabled ? localAddress : NULL;
+}
+
+bool esp_bt_gap_is_valid_cod(uint32_t cod) {
+    return (cod & ESP_BT_COD_FORMAT_TYPE_BIT_MASK) == ESP_BT_COD_FORMAT_TYPE_1;
+}
+
+uint32_t esp_bt_gap_get_cod_srvc(uint32_t cod) {
+    return (cod & ESP_BT_COD_SRVC_BIT_MASK) >> ESP_BT_COD_SRVC_BIT_OFFSET;
+}
+
+// EIR is a sequence of [length][type][data] structures, where length counts the type byte too
+uint8_t *esp_bt_gap_resolve_eir_data(uint8_t *eir, esp_bt_eir_type_t type, uint8_t *length) {
+    assert(length);
+    *length = 0;
+
+    if (!eir) {
+        return NULL;
+    }
+
+    size_t offset = 0;
+
+    while (offset < kEirMaxLen && eir[offset] != 0) {
+        uint8_t fieldLen = eir[offset];
+
+        if (offset + 1 + fieldLen > kEirMaxLen) {
+            return NULL;
+        }
+
+        if (eir[offset + 1] == type) {
+            *length = fieldLen - 1;
+            return &eir[offset + 2];
+        }
+
+        offset += 1 + fieldLen;
+    }
+
+    return NULL;
+}
+
+esp_err_t esp_bt_gap_register_callback(esp_bt_gap_cb_t callback) {
+    gapCallback = callback;
+    return completeCall("esp_bt_gap_register_callback");
+}
+
+esp_err_t esp_bt_gap_set_device_name(const char *name) {
+    recordFakeCall("esp_bt_gap_set_device_name %s", name);
+    return completeCall("esp_bt_gap_set_device_name");
+}
+
+esp_err_t esp_bt_gap_get_device_name(void) {
+    return completeCall("esp_bt_gap_get_device_name");
+}
+
+esp_err_t esp_bt_gap_set_scan_mode(esp_bt_connection_mode_t connectionMode, esp_bt_discovery_mode_t discoveryMode) {
+    recordFakeCall("esp_bt_gap_set_scan_mode %d %d", connectionMode, discoveryMode);
+    return completeCall("esp_bt_gap_set_scan_mode");
+}
+
+esp_err_t esp_bt_gap_start_discovery(esp_bt_inq_mode_t mode, uint8_t inquiryLength, uint8_t responsesCount) {
+    recordFakeCall("esp_bt_gap_start_discovery %u", inquiryLength);
+    return completeCall("esp_bt_gap_start_discovery");
+}
+
+esp_err_t esp_bt_gap_cancel_discovery(void) {
+    recordFakeCall("esp_bt_gap_cancel_discovery");
+    return completeCall("esp_bt_gap_cancel_discovery");
+}
+
+esp_err_t esp_bt_gap_read_remote_name(esp_bd_addr_t address) {
+    recordFakeCall("esp_bt_gap_read_remote_name %s", fakeBdaToStr(address));
+    return completeCall("esp_bt_gap_read_remote_name");
+}
+
+esp_err_t esp_bt_gap_read_rssi_delta(esp_bd_addr_t address) {
+    recordFakeCall("esp_bt_gap_read_rssi_delta %s", fakeBdaToStr(address));
+    return completeCall("esp_bt_gap_read_rssi_delta");
+}
+
+esp_err_t esp_bt_gap_set_afh_channels(esp_bt_gap_afh_channels channels) {
+    recordFakeCall("esp_bt_gap_set_afh_channels");
+    return completeCall("esp_bt_gap_set_afh_channels");
+}
+
+esp_err_t esp_bt_gap_set_qos(esp_bd_addr_t address, uint32_t pollSlots) {
+    recordFakeCall("esp_bt_gap_set_qos %s %" PRIu32, fakeBdaToStr(address), pollSlots);
+    return completeCall("esp_bt_gap_set_qos");
+}
+
+esp_err_t esp_bt_gap_set_pin(esp_bt_pin_type_t pinType, uint8_t pinCodeLen, esp_bt_pin_code_t pinCode) {
+    return completeCall("esp_bt_gap_set_pin");
+}
+
+esp_err_t esp_bt_gap_pin_reply(esp_bd_addr_t address, bool accept, uint8_t pinCodeLen, esp_bt_pin_code_t pinCode) {
+    recordFakeCall("esp_bt_gap_pin_reply %s %d %.*s", fakeBdaToStr(address), accept, pinCodeLen, (char *)pinCode);
+    return completeCall("esp_bt_gap_pin_reply");
+}
+
+esp_err_t esp_a2d_register_callback(esp_a2d_cb_t callback) {
+    a2dpCallback = callback;
+    return completeCall("esp_a2d_register_callback");
+}
+
+esp_err_t esp_a2d_source_register_data_callback(esp_a2d_source_data_cb_t callback) {
+    a2dpDataCallback = callback;
+    return completeCall("esp_a2d_source_register_data_callback");
+}
+
+esp_err_t esp_a2d_source_init(void) {
+    return isBluedroidEnabled ? completeCall("esp_a2d_source_init") : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_a2d_source_connect(esp_bd_addr_t address) {
+    recordFakeCall("esp_a2d_source_connect %s", fakeBdaToStr(address));
+    return completeCall("esp_a2d_source_connect");
+}
+
+esp_err_t esp_a2d_source_disconnect(esp_bd_addr_t address) {
+    recordFakeCall("esp_a2d_source_disconnect %s", fakeBdaToStr(address));
+    return completeCall("esp_a2d_source_disconnect");
+}
+
+esp_err_t esp_a2d_media_ctrl(esp_a2d_media_ctrl_t command) {
+    static const char *commandNames[] = { "NONE", "CHECK_SRC_RDY", "START", "SUSPEND" };
+
+    assert(command < sizeof(commandNames) / sizeof(commandNames[0]));
+    recordFakeCall("esp_a2d_media_ctrl %s", commandNames[command]);
+
+    return completeCall("esp_a2d_media_ctrl");
+}
+
+bool esp_avrc_rn_evt_bit_mask_operation(esp_avrc_bit_mask_op_t operation, esp_avrc_rn_evt_cap_mask_t *events,
+                                        esp_avrc_rn_event_ids_t eventId) {
+    assert(events);
+
+    if (eventId >= ESP_AVRC_RN_MAX_EVT) {
+        return false;
+    }
+
+    uint16_t eventBit = 1u << eventId;
+
+    switch (operation) {
+    case ESP_AVRC_BIT_MASK_OP_TEST:
+        return (events->bits & eventBit) != 0;
+
+    case ESP_AVRC_BIT_MASK_OP_SET:
+        events->bits |= eventBit;
+        return true;
+
+    case ESP_AVRC_BIT_MASK_OP_CLEAR:
+        events->bits &= ~eventBit;
+        return true;
+    }
+
+    return false;
+}
+
+esp_err_t esp_avrc_ct_init(void) {
+    return isBluedroidEnabled ? completeCall("esp_avrc_ct_init") : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_avrc_ct_register_callback(esp_avrc_ct_cb_t callback) {
+    avrcCallback = callback;
+    return completeCall("esp_avrc_ct_register_callback");
+}
+
+esp_err_t esp_avrc_tg_set_rn_evt_cap(const esp_avrc_rn_evt_cap_mask_t *events) {
+    assert(events);
+    return completeCall("esp_avrc_tg_set_rn_evt_cap");
+}
+
+esp_err_t esp_avrc_ct_send_get_rn_capabilities_cmd(uint8_t transactionLabel) {
+    recordFakeCall("esp_avrc_ct_send_get_rn_capabilities_cmd");
+    return completeCall("esp_avrc_ct_send_get_rn_capabilities_cmd");
+}
+
+esp_err_t esp_avrc_ct_send_register_notification_cmd(uint8_t transactionLabel, uint8_t eventId, uint32_t parameter) {
+    recordFakeCall("esp_avrc_ct_send_register_notification_cmd %u", eventId);
+    return completeCall("esp_avrc_ct_send_register_notification_cmd");
+}
+
+esp_err_t esp_avrc_ct_send_set_absolute_volume_cmd(uint8_t transactionLabel, uint8_t volume) {
+    recordFakeCall("esp_avrc_ct_send_set_absolute_volume_cmd %u", volume);
+    return completeCall("esp_avrc_ct_send_set_absolute_volume_cmd");
+}
+
+// Result of the call, which fails only if the test asked for it
+static esp_err_t completeCall(const char *functionName) {
+    if (strcmp(failingFunction, functionName) != 0) {
+        return ESP_OK;
+    }
+
+    failingFunction[0] = '\0';
+    recordFakeCall("%s failed", functionName);
+
+    return ESP_FAIL;
+}
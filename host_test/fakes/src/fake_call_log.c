@@ -0,0 +1,54 @@
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "fake_call_log.h"
+
+static char calls[kFakeCallLogSize][kFakeCallMaxLen];
+static int64_t callTimes[kFakeCallLogSize];
+static size_t callsCount = 0;
+
+void recordFakeCall(const char *format, ...) {
+    // Log is cleared by long running tests (fuzzer) before it overflows
+    assert(callsCount < kFakeCallLogSize);
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(calls[callsCount], kFakeCallMaxLen, format, args);
+    va_end(args);
+
+    callTimes[callsCount] = esp_timer_get_time();
+    callsCount++;
+}
+
+void clearFakeCalls(void) {
+    callsCount = 0;
+}
+
+size_t getFakeCallsCount(void) {
+    return callsCount;
+}
+
+const char *getFakeCall(size_t index) {
+    assert(index < callsCount);
+    return calls[index];
+}
+
+int64_t getFakeCallTime(size_t index) {
+    assert(index < callsCount);
+    return callTimes[index];
+}
+
+long findFakeCall(const char *prefix, size_t startIndex) {
+    size_t prefixLen = strlen(prefix);
+
+    for (size_t callIdx = startIndex; callIdx < callsCount; callIdx++) {
+        if (strncmp(calls[callIdx], prefix, prefixLen) == 0) {
+            return callIdx;
+        }
+    }
+
+    return -1;
+}
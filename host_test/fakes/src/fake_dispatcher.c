@@ -0,0 +1,116 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dispatcher.h"
+#include "fake_rtos.h"
+
+// Same queue item and length as the firmware dispatcher, but the queue is drained by runFakeDispatchers()
+// instead of the dispatcher task
+
+#define kQueueLength (10)
+#define kFakeDispatchersMax (8)
+
+typedef struct {
+    uint32_t event;
+    void *param;
+    DispatcherTask callback;
+
+    uint8_t inlineParamLen;
+    uint8_t inlineParam[kDispatcherInlineParamSize] __attribute__((aligned(8)));
+} DispatcherMessage;
+
+static Dispatcher *dispatchers[kFakeDispatchersMax];
+static size_t dispatchersCount = 0;
+
+bool dispatchTask(Dispatcher *dispatcher, DispatcherTask callback, uint16_t event, void *param, size_t paramLen) {
+    assert(dispatcher);
+    assert(dispatcher->taskQueue && "dispatch to the uninitialized dispatcher");
+
+    DispatcherMessage message = {
+        .event = event,
+        .param = NULL,
+        .callback = callback,
+        .inlineParamLen = 0,
+    };
+
+    if (paramLen > 0 && !param) {
+        return false;
+    }
+
+    if (paramLen > 0 && paramLen <= kDispatcherInlineParamSize) {
+        message.inlineParamLen = paramLen;
+        memcpy(message.inlineParam, param, paramLen);
+    } else if (paramLen > 0) {
+        message.param = calloc(1, paramLen);
+        assert(message.param);
+        memcpy(message.param, param, paramLen);
+    }
+
+    if (xQueueSend(dispatcher->taskQueue, &message, 0) != pdTRUE) {
+        free(message.param);
+        return false;
+    }
+
+    return true;
+}
+
+void initDispatcher(Dispatcher *dispatcher) {
+    assert(dispatchersCount < kFakeDispatchersMax);
+
+    dispatcher->taskQueue = xQueueCreate(kQueueLength, sizeof(DispatcherMessage));
+    xTaskCreate(NULL, "Dispatcher", 0, dispatcher, 0, &dispatcher->taskHandle);
+
+    dispatchers[dispatchersCount++] = dispatcher;
+}
+
+void destroyDispatcher(Dispatcher *dispatcher) {
+    for (size_t dispatcherIdx = 0; dispatcherIdx < dispatchersCount; dispatcherIdx++) {
+        if (dispatchers[dispatcherIdx] == dispatcher) {
+            dispatchers[dispatcherIdx] = dispatchers[--dispatchersCount];
+            break;
+        }
+    }
+
+    if (dispatcher->taskQueue) {
+        DispatcherMessage message;
+
+        while (xQueueReceive(dispatcher->taskQueue, &message, 0) == pdTRUE) {
+            free(message.param);
+        }
+
+        vQueueDelete(dispatcher->taskQueue);
+        dispatcher->taskQueue = NULL;
+    }
+
+    dispatcher->taskHandle = NULL;
+}
+
+uint32_t runFakeDispatchers(void) {
+    uint32_t tasksCount = 0;
+    bool isAnyTaskRun = true;
+
+    // Tasks may dispatch more tasks, to the same dispatcher or to another one
+    while (isAnyTaskRun) {
+        isAnyTaskRun = false;
+
+        for (size_t dispatcherIdx = 0; dispatcherIdx < dispatchersCount; dispatcherIdx++) {
+            DispatcherMessage message;
+
+            if (xQueueReceive(dispatchers[dispatcherIdx]->taskQueue, &message, 0) != pdTRUE) {
+                continue;
+            }
+
+            if (message.callback) {
+                message.callback(message.event, message.inlineParamLen > 0 ? message.inlineParam : message.param);
+            }
+
+            free(message.param);
+
+            isAnyTaskRun = true;
+            tasksCount++;
+        }
+    }
+
+    return tasksCount;
+}
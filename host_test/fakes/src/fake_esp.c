@@ -0,0 +1,164 @@
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/rtc_io.h"
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "fake_call_log.h"
+#include "fake_esp.h"
+
+#define kFakePmLocksMax (8)
+
+struct FakePmLock {
+    const char *name;
+    esp_pm_lock_type_t type;
+    int count;
+};
+
+static struct FakePmLock pmLocks[kFakePmLocksMax];
+static size_t pmLocksCount = 0;
+
+static esp_log_level_t logLevel = ESP_LOG_ERROR;
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_FAIL:
+            return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:
+            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:
+            return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:
+            return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_NOT_FOUND:
+            return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT:
+            return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_NVS_NOT_FOUND:
+            return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_NO_FREE_PAGES:
+            return "ESP_ERR_NVS_NO_FREE_PAGES";
+        case ESP_ERR_NVS_NEW_VERSION_FOUND:
+            return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+        default:
+            return "UNKNOWN ERROR";
+    }
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    logLevel = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    static const char levelLetters[] = "NEWIDV";
+
+    if (level > logLevel) {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+
+    fprintf(stderr, "%c (%s) ", levelLetters[level], tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+
+    va_end(args);
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char *name, esp_pm_lock_handle_t *handle) {
+    assert(handle);
+
+    if (pmLocksCount == kFakePmLocksMax) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    struct FakePmLock *lock = &pmLocks[pmLocksCount++];
+
+    lock->name = name;
+    lock->type = type;
+    lock->count = 0;
+
+    *handle = lock;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+    if (!handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    handle->count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+    if (!handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (handle->count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    handle->count--;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle) {
+    if (!handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return handle->count == 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+int getFakePmLockCount(const char *name) {
+    for (size_t lockIdx = 0; lockIdx < pmLocksCount; lockIdx++) {
+        if (strcmp(pmLocks[lockIdx].name, name) == 0) {
+            return pmLocks[lockIdx].count;
+        }
+    }
+
+    return -1;
+}
+
+uint32_t esp_cpu_get_cycle_count(void) {
+    return (uint32_t)(esp_timer_get_time() * 240);
+}
+
+esp_sleep_source_t esp_sleep_get_wakeup_cause(void) {
+    return ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t port, int level) {
+    recordFakeCall("esp_sleep_enable_ext0_wakeup %d %d", port, level);
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start(void) {
+    recordFakeCall("esp_deep_sleep_start");
+}
+
+esp_err_t rtc_gpio_deinit(gpio_num_t port) {
+    recordFakeCall("rtc_gpio_deinit %d", port);
+    return ESP_OK;
+}
+
+esp_err_t rtc_gpio_pullup_en(gpio_num_t port) {
+    recordFakeCall("rtc_gpio_pullup_en %d", port);
+    return ESP_OK;
+}
+
+esp_err_t rtc_gpio_pulldown_dis(gpio_num_t port) {
+    recordFakeCall("rtc_gpio_pulldown_dis %d", port);
+    return ESP_OK;
+}
@@ -0,0 +1,116 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/i2c_master.h"
+#include "fake_call_log.h"
+#include "fake_ssd1306.h"
+
+struct FakeI2CBus {
+    size_t devicesCount;
+};
+
+struct FakeI2CDevice {
+    struct FakeI2CBus *bus;
+    uint16_t address;
+    uint32_t sclSpeedHz;
+};
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *busConfig, i2c_master_bus_handle_t *busHandle) {
+    assert(busConfig);
+    assert(busHandle);
+
+    *busHandle = calloc(1, sizeof(**busHandle));
+    assert(*busHandle);
+
+    recordFakeCall("i2c_new_master_bus");
+    return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t busHandle) {
+    if (!busHandle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (busHandle->devicesCount != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    free(busHandle);
+    recordFakeCall("i2c_del_master_bus");
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t busHandle, const i2c_device_config_t *deviceConfig,
+                                    i2c_master_dev_handle_t *deviceHandle) {
+    if (!busHandle || !deviceConfig || !deviceHandle || deviceConfig->scl_speed_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    struct FakeI2CDevice *device = calloc(1, sizeof(*device));
+    assert(device);
+
+    device->bus = busHandle;
+    device->address = deviceConfig->device_address;
+    device->sclSpeedHz = deviceConfig->scl_speed_hz;
+    busHandle->devicesCount++;
+
+    *deviceHandle = device;
+    recordFakeCall("i2c_master_bus_add_device 0x%02x", device->address);
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t deviceHandle) {
+    if (!deviceHandle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    deviceHandle->bus->devicesCount--;
+    recordFakeCall("i2c_master_bus_rm_device 0x%02x", deviceHandle->address);
+    free(deviceHandle);
+
+    return ESP_OK;
+}
+
+// Transfers aren't recorded to the call log, the controller decodes them
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t deviceHandle, const uint8_t *writeBuffer, size_t writeSize,
+                              int timeoutMs) {
+    if (!deviceHandle || !writeBuffer || writeSize == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    feedFakeSsd1306(writeBuffer, writeSize, deviceHandle->sclSpeedHz);
+    return ESP_OK;
+}
+
+// Buffers are sent back to back in one transaction, like the driver does
+esp_err_t i2c_master_multi_buffer_transmit(i2c_master_dev_handle_t deviceHandle,
+                                           i2c_master_transmit_multi_buffer_info_t *bufferInfo,
+                                           size_t bufferInfoCount, int timeoutMs) {
+    if (!deviceHandle || !bufferInfo || bufferInfoCount == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t totalSize = 0;
+
+    for (size_t idx = 0; idx < bufferInfoCount; idx++) {
+        totalSize += bufferInfo[idx].buffer_size;
+    }
+
+    uint8_t *transaction = malloc(totalSize);
+    assert(transaction);
+
+    size_t offset = 0;
+
+    for (size_t idx = 0; idx < bufferInfoCount; idx++) {
+        memcpy(transaction + offset, bufferInfo[idx].write_buffer, bufferInfo[idx].buffer_size);
+        offset += bufferInfo[idx].buffer_size;
+    }
+
+    esp_err_t result = i2c_master_transmit(deviceHandle, transaction, totalSize, timeoutMs);
+    free(transaction);
+
+    return result;
+}
@@ -0,0 +1,164 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fake_esp.h"
+#include "nvs_flash.h"
+
+#define kFakeNvsBlobsMax (16)
+#define kFakeNvsKeyMaxLen (16) // NVS keys are 15 characters at most
+#define kFakeNvsNamespacesMax (8)
+
+typedef struct {
+    nvs_handle_t namespaceId;
+    char key[kFakeNvsKeyMaxLen];
+    uint8_t *value;
+    size_t length;
+} FakeNvsBlob;
+
+static FakeNvsBlob blobs[kFakeNvsBlobsMax];
+static size_t blobsCount = 0;
+
+static char namespaces[kFakeNvsNamespacesMax][kFakeNvsKeyMaxLen];
+static size_t namespacesCount = 0;
+
+static bool isFlashInitialized = false;
+static uint32_t writesCount = 0;
+
+static FakeNvsBlob *findBlob(nvs_handle_t handle, const char *key);
+
+esp_err_t nvs_flash_init(void) {
+    isFlashInitialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    for (size_t blobIdx = 0; blobIdx < blobsCount; blobIdx++) {
+        free(blobs[blobIdx].value);
+    }
+
+    blobsCount = 0;
+    return ESP_OK;
+}
+
+// Handle is the namespace index + 1, so zero is never a valid handle
+esp_err_t nvs_open(const char *namespaceName, nvs_open_mode_t openMode, nvs_handle_t *handle) {
+    assert(namespaceName);
+    assert(handle);
+
+    if (!isFlashInitialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (strlen(namespaceName) >= kFakeNvsKeyMaxLen) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t namespaceIdx = 0; namespaceIdx < namespacesCount; namespaceIdx++) {
+        if (strcmp(namespaces[namespaceIdx], namespaceName) == 0) {
+            *handle = namespaceIdx + 1;
+            return ESP_OK;
+        }
+    }
+
+    if (openMode == NVS_READONLY) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    assert(namespacesCount < kFakeNvsNamespacesMax);
+    strcpy(namespaces[namespacesCount], namespaceName);
+    *handle = ++namespacesCount;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length) {
+    assert(length);
+
+    FakeNvsBlob *blob = findBlob(handle, key);
+
+    if (!blob) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    if (!value) {
+        *length = blob->length;
+        return ESP_OK;
+    }
+
+    if (*length < blob->length) {
+        *length = blob->length;
+        return ESP_ERR_INVALID_ARG; // ESP_ERR_NVS_INVALID_LENGTH in ESP-IDF
+    }
+
+    memcpy(value, blob->value, blob->length);
+    *length = blob->length;
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    assert(value || length == 0);
+
+    if (strlen(key) >= kFakeNvsKeyMaxLen) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    FakeNvsBlob *blob = findBlob(handle, key);
+
+    if (!blob) {
+        assert(blobsCount < kFakeNvsBlobsMax);
+
+        blob = &blobs[blobsCount++];
+        blob->namespaceId = handle;
+        strcpy(blob->key, key);
+        blob->value = NULL;
+    }
+
+    free(blob->value);
+    blob->value = malloc(length > 0 ? length : 1);
+    assert(blob->value);
+
+    memcpy(blob->value, value, length);
+    blob->length = length;
+
+    writesCount++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    FakeNvsBlob *blob = findBlob(handle, key);
+
+    if (!blob) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+
+    free(blob->value);
+    *blob = blobs[--blobsCount];
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+}
+
+uint32_t getFakeNvsWritesCount(void) {
+    return writesCount;
+}
+
+static FakeNvsBlob *findBlob(nvs_handle_t handle, const char *key) {
+    assert(key);
+
+    for (size_t blobIdx = 0; blobIdx < blobsCount; blobIdx++) {
+        if (blobs[blobIdx].namespaceId == handle && strcmp(blobs[blobIdx].key, key) == 0) {
+            return &blobs[blobIdx];
+        }
+    }
+
+    return NULL;
+}
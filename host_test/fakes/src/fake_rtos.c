@@ -0,0 +1,376 @@
+#include <assert.h>
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dispatcher.h"
+#include "esp_timer.h"
+#include "fake_rtos.h"
+
+#define kFakeTimersMax (16)
+#define kFakeTasksMax (16)
+
+struct FakeTimer {
+    const char *name;
+    TickType_t period;
+    bool isAutoReload;
+    void *timerId;
+    TimerCallbackFunction_t callback;
+
+    bool isActive;
+    int64_t expiryUs;
+};
+
+struct FakeTask {
+    const char *name;
+    TaskFunction_t function;
+    void *param;
+    uint32_t notifications;
+};
+
+struct FakeQueue {
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct FakeSemaphore {
+    bool isTaken;
+};
+
+struct FakeEventGroup {
+    EventBits_t bits;
+};
+
+static int64_t fakeTimeUs = 0;
+
+static struct FakeTimer timers[kFakeTimersMax];
+static size_t timersCount = 0;
+
+static struct FakeTask tasks[kFakeTasksMax];
+static size_t tasksCount = 0;
+
+// Task run by runFakeTask. Its wait for a notification jumps back to the runner
+static struct FakeTask *runningTask = NULL;
+static jmp_buf runningTaskWait;
+
+static int64_t ticksToUs(TickType_t ticks) {
+    return (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+int64_t esp_timer_get_time(void) {
+    return fakeTimeUs;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(fakeTimeUs / 1000 / portTICK_PERIOD_MS);
+}
+
+static struct FakeTimer *findNextExpiredTimer(int64_t untilUs) {
+    struct FakeTimer *nextTimer = NULL;
+
+    for (size_t timerIdx = 0; timerIdx < timersCount; timerIdx++) {
+        struct FakeTimer *timer = &timers[timerIdx];
+
+        if (timer->isActive && timer->expiryUs <= untilUs && (!nextTimer || timer->expiryUs < nextTimer->expiryUs)) {
+            nextTimer = timer;
+        }
+    }
+
+    return nextTimer;
+}
+
+void advanceFakeTime(uint32_t milliseconds) {
+    int64_t targetUs = fakeTimeUs + (int64_t)milliseconds * 1000;
+    struct FakeTimer *timer = NULL;
+
+    runFakeDispatchers();
+
+    while ((timer = findNextExpiredTimer(targetUs))) {
+        fakeTimeUs = timer->expiryUs;
+
+        if (timer->isAutoReload) {
+            timer->expiryUs += ticksToUs(timer->period > 0 ? timer->period : 1);
+        } else {
+            timer->isActive = false;
+        }
+
+        timer->callback(timer);
+        runFakeDispatchers();
+    }
+
+    fakeTimeUs = targetUs;
+}
+
+bool isFakeTimerActive(const char *name) {
+    for (size_t timerIdx = 0; timerIdx < timersCount; timerIdx++) {
+        if (strcmp(timers[timerIdx].name, name) == 0) {
+            return timers[timerIdx].isActive;
+        }
+    }
+
+    return false;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth, void *param,
+                       UBaseType_t priority, TaskHandle_t *task) {
+    assert(tasksCount < kFakeTasksMax);
+
+    tasks[tasksCount].name = name;
+    tasks[tasksCount].function = function;
+    tasks[tasksCount].param = param;
+    tasks[tasksCount].notifications = 0;
+
+    if (task) {
+        *task = &tasks[tasksCount];
+    }
+
+    tasksCount++;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *task, BaseType_t core) {
+    return xTaskCreate(function, name, stackDepth, param, priority, task);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+    advanceFakeTime(ticks * portTICK_PERIOD_MS);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    assert(task);
+    task->notifications++;
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *isTaskWoken) {
+    xTaskNotifyGive(task);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+    // Only the tasks run by the test can wait
+    assert(runningTask && "ulTaskNotifyTake outside of runFakeTask");
+
+    uint32_t notifications = runningTask->notifications;
+
+    if (notifications == 0) {
+        longjmp(runningTaskWait, 1);
+    }
+
+    runningTask->notifications = (clearOnExit ? 0 : notifications - 1);
+    return notifications;
+}
+
+uint32_t getFakeTaskNotifications(TaskHandle_t task) {
+    return task ? task->notifications : 0;
+}
+
+TaskHandle_t findFakeTask(const char *name) {
+    for (size_t taskIdx = 0; taskIdx < tasksCount; taskIdx++) {
+        if (strcmp(tasks[taskIdx].name, name) == 0) {
+            return &tasks[taskIdx];
+        }
+    }
+
+    return NULL;
+}
+
+bool runFakeTask(TaskHandle_t task) {
+    assert(task);
+    assert(!runningTask && "tasks can't run each other");
+
+    if (task->notifications == 0) {
+        return false;
+    }
+
+    runningTask = task;
+
+    // Task function starts from the beginning every time, its wait returns here
+    if (setjmp(runningTaskWait) == 0) {
+        task->function(task->param);
+    }
+
+    runningTask = NULL;
+    return true;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    struct FakeQueue *queue = calloc(1, sizeof(*queue));
+    assert(queue);
+
+    queue->items = calloc(length, itemSize);
+    queue->length = length;
+    queue->itemSize = itemSize;
+
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+    assert(queue);
+
+    // Nobody can free the space while the sender waits
+    if (queue->count == queue->length) {
+        return pdFAIL;
+    }
+
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->items + tail * queue->itemSize, item, queue->itemSize);
+    queue->count++;
+
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *isTaskWoken) {
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticksToWait) {
+    assert(queue);
+
+    if (queue->count == 0) {
+        return pdFAIL;
+    }
+
+    memcpy(item, queue->items + queue->head * queue->itemSize, queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+
+    return pdPASS;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    if (queue) {
+        free(queue->items);
+        free(queue);
+    }
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    struct FakeSemaphore *semaphore = calloc(1, sizeof(*semaphore));
+    assert(semaphore);
+    return semaphore;
+}
+
+// Taking a taken mutex would block forever, because its owner can't run
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    assert(semaphore);
+
+    if (semaphore->isTaken) {
+        assert(ticksToWait != portMAX_DELAY && "deadlock: mutex is already taken");
+        return pdFAIL;
+    }
+
+    semaphore->isTaken = true;
+    return pdPASS;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    assert(semaphore);
+
+    if (!semaphore->isTaken) {
+        return pdFAIL;
+    }
+
+    semaphore->isTaken = false;
+    return pdPASS;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    free(semaphore);
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t isAutoReload, void *timerId,
+                           TimerCallbackFunction_t callback) {
+    assert(timersCount < kFakeTimersMax);
+    assert(callback);
+
+    struct FakeTimer *timer = &timers[timersCount++];
+
+    timer->name = name;
+    timer->period = period;
+    timer->isAutoReload = isAutoReload;
+    timer->timerId = timerId;
+    timer->callback = callback;
+    timer->isActive = false;
+
+    return timer;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticksToWait) {
+    // NULL handle crashes the FreeRTOS timer API too
+    assert(timer);
+
+    timer->isActive = true;
+    timer->expiryUs = fakeTimeUs + ticksToUs(timer->period);
+
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticksToWait) {
+    assert(timer);
+
+    timer->isActive = false;
+    return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticksToWait) {
+    return xTimerStart(timer, ticksToWait);
+}
+
+// Dormant timer is started by the period change, like in FreeRTOS
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticksToWait) {
+    assert(timer);
+    assert(period > 0);
+
+    timer->period = period;
+    return xTimerStart(timer, ticksToWait);
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticksToWait) {
+    return xTimerStop(timer, ticksToWait);
+}
+
+BaseType_t xTimerStartFromISR(TimerHandle_t timer, BaseType_t *isTaskWoken) {
+    return xTimerStart(timer, 0);
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer) {
+    assert(timer);
+    return timer->isActive;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer) {
+    assert(timer);
+    return timer->timerId;
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    struct FakeEventGroup *group = calloc(1, sizeof(*group));
+    assert(group);
+    return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    assert(group);
+    group->bits |= bits;
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t ticksToWait) {
+    assert(group);
+
+    EventBits_t currentBits = group->bits;
+
+    if (clearOnExit) {
+        group->bits &= ~bits;
+    }
+
+    return currentBits;
+}
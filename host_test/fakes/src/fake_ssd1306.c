@@ -0,0 +1,307 @@
+#include <assert.h>
+#include <string.h>
+
+#include "fake_ssd1306.h"
+
+#define kContinuationBit (0x80)
+#define kDataBit (0x40)
+#define kCommandArgsMax (6)
+#define kI2CBitsPerByte (9) // Acknowledge bit included
+
+typedef enum {
+    ADDRESSING_HORIZONTAL,
+    ADDRESSING_VERTICAL,
+    ADDRESSING_PAGE,
+} AddressingMode;
+
+// Power-on reset state of the controller
+static struct {
+    uint8_t ram[kFakeSsd1306Pages * kFakeSsd1306Columns];
+
+    bool isOn;
+    bool isChargePumpOn;
+    bool isInverted;
+    bool isEntireOn;
+    bool isSegmentRemapped;
+    bool isComScanReversed;
+    bool isScrolling;
+    uint8_t multiplexRatio; // Visible rows - 1
+    uint8_t startLine;
+    uint8_t displayOffset;
+
+    AddressingMode addressingMode;
+    uint8_t startCol;
+    uint8_t endCol;
+    uint8_t startPage;
+    uint8_t endPage;
+    uint8_t col;
+    uint8_t page;
+
+    // Multibyte command waiting for its arguments
+    uint8_t command;
+    uint8_t argsCount;
+    uint8_t argsExpected;
+    uint8_t args[kCommandArgsMax];
+} controller = {
+    .multiplexRatio = kFakeSsd1306Rows - 1,
+    .addressingMode = ADDRESSING_PAGE,
+    .endCol = kFakeSsd1306Columns - 1,
+    .endPage = kFakeSsd1306Pages - 1,
+};
+
+static FakeSsd1306Stats stats = {};
+
+static void feedByte(bool isData, uint8_t value);
+static void writeData(uint8_t value);
+static uint8_t getArgumentsCount(uint8_t command);
+static void executeCommand(void);
+
+void feedFakeSsd1306(const uint8_t *bytes, size_t len, uint32_t sclSpeedHz) {
+    assert(bytes || len == 0);
+    assert(sclSpeedHz > 0);
+
+    stats.transactionsCount++;
+    stats.bytesCount += len;
+    stats.busTimeUs += (uint64_t)(len + 1) * kI2CBitsPerByte * 1000000 / sclSpeedHz;
+
+    size_t idx = 0;
+
+    while (idx < len) {
+        uint8_t control = bytes[idx++];
+        bool isData = control & kDataBit;
+
+        if (control & ~(kContinuationBit | kDataBit)) {
+            stats.errorsCount++;
+        }
+
+        // Continuation bit means one byte follows and then another control byte
+        if (control & kContinuationBit) {
+            if (idx == len) {
+                stats.errorsCount++;
+                break;
+            }
+
+            feedByte(isData, bytes[idx++]);
+            continue;
+        }
+
+        for (; idx < len; idx++) {
+            feedByte(isData, bytes[idx]);
+        }
+    }
+}
+
+void getFakeSsd1306Stats(FakeSsd1306Stats *outStats) {
+    assert(outStats);
+    *outStats = stats;
+}
+
+void resetFakeSsd1306Stats(void) {
+    stats = (FakeSsd1306Stats){};
+}
+
+const uint8_t *getFakeSsd1306Ram(void) {
+    return controller.ram;
+}
+
+bool isFakeSsd1306Scrolling(void) {
+    return controller.isScrolling;
+}
+
+uint8_t getFakeSsd1306VisibleRows(void) {
+    return controller.multiplexRatio + 1;
+}
+
+bool getFakeSsd1306Pixel(uint8_t x, uint8_t y) {
+    assert(x < kFakeSsd1306Columns);
+    assert(y < getFakeSsd1306VisibleRows());
+
+    // Panel stays dark without the charge pump, whatever is in GDDRAM
+    if (!controller.isOn || !controller.isChargePumpOn) {
+        return false;
+    }
+
+    if (controller.isEntireOn) {
+        return true;
+    }
+
+    uint8_t col = (controller.isSegmentRemapped ? x : kFakeSsd1306Columns - 1 - x);
+    uint8_t com = (controller.isComScanReversed ? y : controller.multiplexRatio - y);
+    uint8_t row = (com + controller.startLine + controller.displayOffset) % kFakeSsd1306Rows;
+
+    bool isSet = (controller.ram[(row / 8) * kFakeSsd1306Columns + col] >> (row & 7)) & 1;
+
+    return isSet != controller.isInverted;
+}
+
+static void feedByte(bool isData, uint8_t value) {
+    if (isData) {
+        // Data in the middle of the command arguments
+        if (controller.argsCount < controller.argsExpected) {
+            stats.errorsCount++;
+        }
+
+        writeData(value);
+        return;
+    }
+
+    if (controller.argsCount < controller.argsExpected) {
+        controller.args[controller.argsCount++] = value;
+    } else {
+        controller.command = value;
+        controller.argsCount = 0;
+        controller.argsExpected = getArgumentsCount(value);
+    }
+
+    if (controller.argsCount == controller.argsExpected) {
+        executeCommand();
+    }
+}
+
+// Pointers move inside the window like in the chip. Page addressing mode wraps the column only
+static void writeData(uint8_t value) {
+    // GDDRAM content is corrupted by the writes while scrolling
+    if (controller.isScrolling) {
+        stats.errorsCount++;
+    }
+
+    controller.ram[controller.page * kFakeSsd1306Columns + controller.col] = value;
+    stats.dataBytesCount++;
+
+    switch (controller.addressingMode) {
+    case ADDRESSING_HORIZONTAL:
+        if (controller.col < controller.endCol) {
+            controller.col++;
+        } else {
+            controller.col = controller.startCol;
+            controller.page = (controller.page < controller.endPage ? controller.page + 1 : controller.startPage);
+        }
+        break;
+    case ADDRESSING_VERTICAL:
+        if (controller.page < controller.endPage) {
+            controller.page++;
+        } else {
+            controller.page = controller.startPage;
+            controller.col = (controller.col < controller.endCol ? controller.col + 1 : controller.startCol);
+        }
+        break;
+    case ADDRESSING_PAGE:
+        controller.col = (controller.col + 1) % kFakeSsd1306Columns;
+        break;
+    }
+}
+
+static uint8_t getArgumentsCount(uint8_t command) {
+    switch (command) {
+    case 0x20: // Memory addressing mode
+    case 0x81: // Contrast
+    case 0x8D: // Charge pump
+    case 0xA8: // Multiplex ratio
+    case 0xD3: // Display offset
+    case 0xD5: // Clock divider
+    case 0xD9: // Precharge period
+    case 0xDA: // COM pins
+    case 0xDB: // VCOMH deselect level
+        return 1;
+    case 0x21: // Column address
+    case 0x22: // Page address
+    case 0xA3: // Vertical scroll area
+        return 2;
+    case 0x29: // Vertical and horizontal scroll setup
+    case 0x2A:
+        return 5;
+    case 0x26: // Horizontal scroll setup
+    case 0x27:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+static void executeCommand(void) {
+    uint8_t command = controller.command;
+    const uint8_t *args = controller.args;
+
+    switch (command) {
+    case 0x20:
+        if ((args[0] & 0x03) > ADDRESSING_PAGE) {
+            stats.errorsCount++;
+            break;
+        }
+
+        controller.addressingMode = args[0] & 0x03;
+        break;
+    case 0x21:
+        controller.startCol = controller.col = args[0] & 0x7F;
+        controller.endCol = args[1] & 0x7F;
+        break;
+    case 0x22:
+        controller.startPage = controller.page = args[0] & 0x07;
+        controller.endPage = args[1] & 0x07;
+        break;
+    case 0x8D:
+        controller.isChargePumpOn = args[0] & 0x04;
+        break;
+    case 0xA0:
+    case 0xA1:
+        controller.isSegmentRemapped = command & 0x01;
+        break;
+    case 0xA4:
+    case 0xA5:
+        controller.isEntireOn = command & 0x01;
+        break;
+    case 0xA6:
+    case 0xA7:
+        controller.isInverted = command & 0x01;
+        break;
+    case 0xA8:
+        if ((args[0] & 0x3F) < 15) {
+            stats.errorsCount++;
+            break;
+        }
+
+        controller.multiplexRatio = args[0] & 0x3F;
+        break;
+    case 0xAE:
+    case 0xAF:
+        controller.isOn = command & 0x01;
+        break;
+    case 0xC0:
+    case 0xC8:
+        controller.isComScanReversed = command & 0x08;
+        break;
+    case 0xD3:
+        controller.displayOffset = args[0] & 0x3F;
+        break;
+    case 0x2E:
+        controller.isScrolling = false;
+        break;
+    case 0x2F:
+        controller.isScrolling = true;
+        break;
+    case 0x26:
+    case 0x27:
+    case 0x29:
+    case 0x2A:
+    case 0x81:
+    case 0xA3:
+    case 0xD5:
+    case 0xD9:
+    case 0xDA:
+    case 0xDB:
+        break; // Nothing visible in the emulated panel
+    default:
+        if (command <= 0x0F) {
+            controller.col = (controller.col & 0xF0) | command; // Lower column nibble, page addressing mode
+        } else if (command <= 0x1F) {
+            controller.col = (controller.col & 0x0F) | ((command & 0x07) << 4); // Higher column nibble
+        } else if (command >= 0x40 && command <= 0x7F) {
+            controller.startLine = command & 0x3F;
+        } else if (command >= 0xB0 && command <= 0xB7) {
+            controller.page = command & 0x07; // Page start, page addressing mode
+        } else {
+            stats.errorsCount++;
+        }
+        break;
+    }
+}
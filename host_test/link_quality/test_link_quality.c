@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "link_quality.h"
+
+// Replays a trace of link quality samples through the controllers with the default configs.
+// Trace line: rssi_delta,starvations,expected_bitpool,expected_tx_level. Lines starting with '#' are comments.
+// First two columns are the "Link quality sample" lines of bt_lib debug log
+
+#define kTraceLineMaxLen (128)
+
+static bool checkBitpoolStep(const LinkQualityConfig *config, uint8_t previousBitpool, uint8_t bitpool);
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <trace.csv>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *trace = fopen(argv[1], "r");
+
+    if (!trace) {
+        fprintf(stderr, "Unable to open trace %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    LinkQualityConfig linkQualityConfig = LINK_QUALITY_DEFAULT_CONFIG();
+    TxPowerConfig txPowerConfig = TX_POWER_DEFAULT_CONFIG();
+
+    LinkQualityController linkQuality;
+    TxPowerController txPower;
+
+    initLinkQualityController(&linkQuality, &linkQualityConfig);
+    initTxPowerController(&txPower, &txPowerConfig);
+
+    char line[kTraceLineMaxLen];
+    unsigned lineNumber = 0;
+    unsigned samplesCount = 0;
+    unsigned failuresCount = 0;
+
+    while (fgets(line, sizeof(line), trace)) {
+        lineNumber++;
+
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        int rssiDelta = 0;
+        unsigned starvations = 0;
+        unsigned expectedBitpool = 0;
+        unsigned expectedTxLevel = 0;
+
+        if (sscanf(line, "%d,%u,%u,%u", &rssiDelta, &starvations, &expectedBitpool, &expectedTxLevel) != 4) {
+            fprintf(stderr, "%s:%u: malformed sample\n", argv[1], lineNumber);
+            failuresCount++;
+            continue;
+        }
+
+        uint8_t previousBitpool = linkQuality.bitpool;
+
+        updateTxPower(&txPower, rssiDelta);
+        updateLinkQuality(&linkQuality, rssiDelta, starvations);
+        samplesCount++;
+
+        if (linkQuality.bitpool != expectedBitpool || txPower.level != expectedTxLevel) {
+            fprintf(stderr, "%s:%u: bitpool %u, TX level %u, expected %u and %u\n", argv[1], lineNumber,
+                    linkQuality.bitpool, txPower.level, expectedBitpool, expectedTxLevel);
+            failuresCount++;
+        }
+
+        if (!checkBitpoolStep(&linkQualityConfig, previousBitpool, linkQuality.bitpool)) {
+            fprintf(stderr, "%s:%u: bitpool jumped from %u to %u\n", argv[1], lineNumber, previousBitpool,
+                    linkQuality.bitpool);
+            failuresCount++;
+        }
+    }
+
+    fclose(trace);
+
+    if (samplesCount == 0) {
+        fprintf(stderr, "%s: trace is empty\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: %u samples, %u failures\n", argv[1], samplesCount, failuresCount);
+
+    return failuresCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Bitpool stays in the configured range and moves by one step at most
+static bool checkBitpoolStep(const LinkQualityConfig *config, uint8_t previousBitpool, uint8_t bitpool) {
+    if (bitpool < config->minBitpool || bitpool > config->maxBitpool) {
+        return false;
+    }
+
+    int change = abs((int)bitpool - (int)previousBitpool);
+
+    return change <= config->bitpoolStep;
+}
@@ -0,0 +1,162 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spectrum_fft.h"
+
+// Feeds synthetic tones through the fixed-point spectrum and checks that the energy lands in the right band.
+// Tones are generated at the A2DP source sample rate, so the frequencies match what the analyzer sees on the device
+
+#define kSampleRate (44100)
+#define kToneAmplitude (16384)     // Half of the full scale, like a loud track
+#define kLeakageMinDistance (3)    // Bins closer to the tone get the window main lobe and the first sidelobe
+#define kLeakageMarginLog2Q2 (40)  // Bands further away are at least 60 dB below the tone
+#define kHalfAmplitudeStep (8)     // Half amplitude is a quarter of the power, 2 in log2, 8 in Q2
+#define kHalfAmplitudeTolerance (1)
+
+static const float toneFrequencies[] = { 200.0f, 440.0f, 1000.0f, 2500.0f, 5000.0f, 8000.0f, 12000.0f, 18000.0f };
+
+static SpectrumFft fft;
+
+static void generateTone(int16_t *samples, float frequency, int16_t amplitude);
+static uint8_t findBand(float frequency);
+static float getBandDistance(uint8_t band, float frequency);
+static uint8_t findLoudestBand(const uint8_t *bandPowers);
+static unsigned checkBandEdges(void);
+static unsigned checkSilence(void);
+static unsigned checkTone(float frequency);
+
+int main(int argc, char **argv) {
+    initSpectrumFft(&fft);
+
+    unsigned failuresCount = checkBandEdges() + checkSilence();
+
+    for (size_t idx = 0; idx < sizeof(toneFrequencies) / sizeof(toneFrequencies[0]); idx++) {
+        failuresCount += checkTone(toneFrequencies[idx]);
+    }
+
+    printf("%u failures\n", failuresCount);
+
+    return failuresCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Bands cover every bin except DC, without gaps and overlaps
+static unsigned checkBandEdges(void) {
+    unsigned failuresCount = 0;
+
+    if (fft.bandEdges[0] != 1 || fft.bandEdges[kSpectrumBandsCount] != kSpectrumHalfSize) {
+        fprintf(stderr, "bands cover bins %u..%u, expected 1..%u\n", fft.bandEdges[0],
+                fft.bandEdges[kSpectrumBandsCount], kSpectrumHalfSize);
+        failuresCount++;
+    }
+
+    for (uint8_t band = 0; band < kSpectrumBandsCount; band++) {
+        if (fft.bandEdges[band + 1] <= fft.bandEdges[band]) {
+            fprintf(stderr, "band %u is empty: bins %u..%u\n", band, fft.bandEdges[band], fft.bandEdges[band + 1]);
+            failuresCount++;
+        }
+    }
+
+    return failuresCount;
+}
+
+static unsigned checkSilence(void) {
+    int16_t samples[kSpectrumFftSize] = {};
+    uint8_t bandPowers[kSpectrumBandsCount];
+
+    computeSpectrumBands(&fft, samples, bandPowers);
+
+    for (uint8_t band = 0; band < kSpectrumBandsCount; band++) {
+        if (bandPowers[band] != 0) {
+            fprintf(stderr, "silence: band %u power %u\n", band, bandPowers[band]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static unsigned checkTone(float frequency) {
+    int16_t samples[kSpectrumFftSize];
+    uint8_t bandPowers[kSpectrumBandsCount];
+    uint8_t halfBandPowers[kSpectrumBandsCount];
+
+    generateTone(samples, frequency, kToneAmplitude);
+    computeSpectrumBands(&fft, samples, bandPowers);
+
+    generateTone(samples, frequency, kToneAmplitude / 2);
+    computeSpectrumBands(&fft, samples, halfBandPowers);
+
+    unsigned failuresCount = 0;
+    uint8_t expectedBand = findBand(frequency);
+    uint8_t loudestBand = findLoudestBand(bandPowers);
+    uint8_t peakPower = bandPowers[loudestBand];
+
+    printf("%.0f Hz: band %u, power %u\n", frequency, loudestBand, peakPower);
+
+    if (loudestBand != expectedBand) {
+        fprintf(stderr, "%.0f Hz: loudest band %u, expected %u\n", frequency, loudestBand, expectedBand);
+        failuresCount++;
+    }
+
+    for (uint8_t band = 0; band < kSpectrumBandsCount; band++) {
+        if (getBandDistance(band, frequency) >= kLeakageMinDistance &&
+            bandPowers[band] + kLeakageMarginLog2Q2 > peakPower) {
+            fprintf(stderr, "%.0f Hz: band %u power %u leaks, peak %u\n", frequency, band, bandPowers[band], peakPower);
+            failuresCount++;
+        }
+    }
+
+    int step = (int)peakPower - (int)halfBandPowers[loudestBand];
+
+    if (abs(step - kHalfAmplitudeStep) > kHalfAmplitudeTolerance) {
+        fprintf(stderr, "%.0f Hz: half amplitude lowers power by %d, expected %d\n", frequency, step,
+                kHalfAmplitudeStep);
+        failuresCount++;
+    }
+
+    return failuresCount;
+}
+
+static void generateTone(int16_t *samples, float frequency, int16_t amplitude) {
+    for (uint16_t idx = 0; idx < kSpectrumFftSize; idx++) {
+        samples[idx] = lroundf(amplitude * sinf(2.0f * M_PI * frequency * idx / kSampleRate));
+    }
+}
+
+// Band of the bin nearest to the frequency
+static uint8_t findBand(float frequency) {
+    long bin = lroundf(frequency * kSpectrumFftSize / kSampleRate);
+    uint8_t band = 0;
+
+    while (band + 1 < kSpectrumBandsCount && bin >= fft.bandEdges[band + 1]) {
+        band++;
+    }
+
+    return band;
+}
+
+// Distance in bins from the tone to the nearest bin of the band
+static float getBandDistance(uint8_t band, float frequency) {
+    float bin = frequency * kSpectrumFftSize / kSampleRate;
+    float firstBin = fft.bandEdges[band];
+    float lastBin = fft.bandEdges[band + 1] - 1;
+
+    if (bin < firstBin) {
+        return firstBin - bin;
+    }
+
+    return (bin > lastBin ? bin - lastBin : 0.0f);
+}
+
+static uint8_t findLoudestBand(const uint8_t *bandPowers) {
+    uint8_t loudestBand = 0;
+
+    for (uint8_t band = 1; band < kSpectrumBandsCount; band++) {
+        if (bandPowers[band] > bandPowers[loudestBand]) {
+            loudestBand = band;
+        }
+    }
+
+    return loudestBand;
+}